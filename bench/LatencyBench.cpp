@@ -0,0 +1,701 @@
+// Footswitch-to-audio latency benchmark, run on the host simulation.
+//
+//   program [--runs N] [--verbose]
+//
+// For every bank layout in LAYOUTS, each scenario boots a fresh firmware in
+// a forked child, works PIN_PLAY `runs` times at jittered moments and
+// measures on the captured I2S output how long the audio took to react:
+//
+//   cold       idle, tap Play     -> first non-silent sample
+//   crossfade  playing, tap Play  -> first sample departing from the old pad
+//   cut        the same with the crossfade setting off (declicked cut)
+//   panic      hold Play          -> output silent for good
+//
+// Times start at the edge the firmware acts on: the release of a tap (Play
+// fires on release) or the moment a hold becomes a panic. The path covered
+// is the edge interrupt, InputManager::update(), loopInput(), audioBus,
+// audioTask() and the DMA ring, on a card with SD_TIMING access costs.
+// Pads are constant DC, a different level per key, so a departure is
+// unambiguous.
+//
+// Prints p50/p90/p99/max per layout and scenario, and exits 1 when one of
+// them is over its budget in SCENARIOS or a run produced no measurement.
+//
+// A second table counts the pixel bytes each UI interaction sends to the
+// panel (INTERACTIONS), against a budget of its own.
+//
+// A third plays a pad, switches to Wi-Fi mode and uploads through the file
+// manager at full speed (UPLOADS): a new file, during which the pad must
+// play on with no underrun and no silent frame, and the playing pad
+// itself, which must fade out rather than click. Neither may remove or
+// rewrite a file the firmware still has open (sim::openFileClobbers()).
+
+#include "AudioMetrics.h"
+#include "Config.h"
+#include "PadCache.h"
+#include "Sim.h"
+
+#include <Preferences.h>
+
+#include <algorithm>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+enum ScenarioKind { COLD, CROSSFADE, CUT, PANIC };
+
+struct Scenario {
+  const char *name;
+  ScenarioKind kind;
+  uint32_t p50BudgetUs;
+  uint32_t p99BudgetUs;
+};
+
+// Budgets sit ~20% above today's figures. A playing pad has the whole DMA
+// ring (AUDIO_DMA_BUF_COUNT blocks, ~46 ms) queued ahead of any change. A
+// change that eats into these makes the pedal feel slower.
+//
+// Panic skips the ring (it is zeroed), and its p99 budget is the promise:
+// silent within one block period, however busy the audio task was.
+const uint32_t BLOCK_US =
+    (uint32_t)((uint64_t)AUDIO_BLOCK_FRAMES * 1000000 / AUDIO_SAMPLE_RATE);
+const Scenario SCENARIOS[] = {{"cold", COLD, 3000, 7000},
+                              {"crossfade", CROSSFADE, 61000, 66000},
+                              {"cut", CUT, 61000, 66000},
+                              {"panic", PANIC, 1000, BLOCK_US}};
+
+struct Layout {
+  int banks;
+  int padSeconds;
+};
+
+// The benchmark plays the last bank, whose directory is scanned last
+const Layout LAYOUTS[] = {{1, 2}, {16, 2}, {64, 2}, {64, 12}};
+
+// SPI card at ~2.5 MB/s; FatFs pays per directory entry on every open,
+// and writes stall 30 ms every 256 KB while the card erases
+const sim::SdTiming SD_TIMING = {150, 20, 400, 30000, 256};
+
+const char *const KEY_FILES[12] = {"C",  "Cs", "D",  "Ds", "E",  "F",
+                                   "Fs", "G",  "Gs", "A",  "As", "B"};
+
+const uint32_t TAP_MS = 80;
+const uint32_t PANIC_HOLD_MS = 1000; // InputManager::PANIC_DELAY_MS
+const uint32_t DETENT_MS = 20;
+const uint64_t FIRST_EVENT_US = 3000000; // Boot, scan and splash done
+const int SILENCE = 8; // |sample| at or below this is silent (-72 dBFS)
+
+int16_t padLevel(int key) { return (int16_t)(2000 + 1000 * key); }
+
+// --- Card image ---
+
+bool writePad(const fs::path &path, int key, int seconds, uint32_t mp3Size) {
+  std::ofstream out(path, std::ios::binary);
+  PcmCacheHeader hdr;
+  memcpy(hdr.magic, "PCM1", 4);
+  hdr.sampleRate = AUDIO_SAMPLE_RATE;
+  hdr.frames = (uint32_t)seconds * AUDIO_SAMPLE_RATE;
+  hdr.sourceSize = mp3Size;
+  out.write((const char *)&hdr, sizeof(hdr));
+  std::vector<int16_t> second(AUDIO_SAMPLE_RATE * 2, padLevel(key));
+  for (int s = 0; s < seconds; s++)
+    out.write((const char *)second.data(), second.size() * sizeof(int16_t));
+  return (bool)out;
+}
+
+// Banks "Bank 00".."Bank NN", each with 12 stand-in MP3s and fresh PCM
+// sidecars (so nothing is decoded). Sidecars link to one shared set.
+bool buildCard(const fs::path &root, const Layout &layout) {
+  const uint32_t MP3_SIZE = 4096;
+  std::error_code ec;
+  fs::path pool = root / "pool";
+  fs::create_directories(pool, ec);
+  for (int k = 0; k < 12; k++) {
+    if (!writePad(pool / (std::string(KEY_FILES[k]) + ".pcm"), k,
+                  layout.padSeconds, MP3_SIZE))
+      return false;
+  }
+
+  fs::path card = root / "card";
+  std::vector<char> mp3(MP3_SIZE, 0);
+  for (int b = 0; b < layout.banks; b++) {
+    char bank[16];
+    snprintf(bank, sizeof(bank), "Bank %02d", b);
+    fs::create_directories(card / bank, ec);
+    fs::create_directories(card / (PAD_CACHE_DIR + 1) / bank, ec);
+    for (int k = 0; k < 12; k++) {
+      std::string key = KEY_FILES[k];
+      std::ofstream(card / bank / (key + ".mp3"), std::ios::binary)
+          .write(mp3.data(), mp3.size());
+      fs::create_symlink(pool / (key + ".pcm"),
+                         card / (PAD_CACHE_DIR + 1) / bank / (key + ".pcm"),
+                         ec);
+      if (ec)
+        return false;
+    }
+  }
+  return true;
+}
+
+// --- Input ---
+
+void tap(uint64_t atUs, uint8_t pin, uint32_t ms = TAP_MS) {
+  sim::at(atUs, [pin] { sim::setPin(pin, LOW); });
+  sim::at(atUs + ms * 1000ULL, [pin] { sim::setPin(pin, HIGH); });
+}
+
+// One encoder detent, a full quadrature cycle, as in SimMain.cpp
+void turn(uint64_t atUs, uint8_t pinA, uint8_t pinB, int dir) {
+  uint8_t first = dir > 0 ? pinA : pinB;
+  uint8_t second = dir > 0 ? pinB : pinA;
+  uint64_t phase = DETENT_MS * 1000 / 4;
+  sim::at(atUs, [first] { sim::setPin(first, LOW); });
+  sim::at(atUs + phase, [second] { sim::setPin(second, LOW); });
+  sim::at(atUs + 2 * phase, [first] { sim::setPin(first, HIGH); });
+  sim::at(atUs + 3 * phase, [second] { sim::setPin(second, HIGH); });
+}
+
+void turnVolume(uint64_t atUs, int dir) {
+  turn(atUs, PIN_VOL_ENC_A, PIN_VOL_ENC_B, dir);
+}
+
+// --- Output analysis ---
+
+struct Probe {
+  ScenarioKind kind;
+  uint64_t atUs;  // Edge the firmware acts on
+  uint64_t endUs; // Start of the next cycle
+};
+
+bool isSilent(int16_t l, int16_t r) {
+  return abs(l) <= SILENCE && abs(r) <= SILENCE;
+}
+
+uint64_t frameUs(const sim::AudioBlock &b, size_t frame) {
+  return b.startUs + (uint64_t)frame * 1000000 / b.rate;
+}
+
+// Visit the captured frames in [fromUs, toUs) until `fn` returns false
+template <typename F> void forFrames(uint64_t fromUs, uint64_t toUs, F fn) {
+  const std::vector<sim::AudioBlock> &out = sim::audioOutput();
+  auto it = std::lower_bound(out.begin(), out.end(), fromUs,
+                             [](const sim::AudioBlock &b, uint64_t t) {
+                               return frameUs(b, b.samples.size() / 2) <= t;
+                             });
+  for (; it != out.end(); ++it) {
+    for (size_t f = 0; f < it->samples.size() / 2; f++) {
+      uint64_t t = frameUs(*it, f);
+      if (t < fromUs)
+        continue;
+      if (t >= toUs)
+        return;
+      if (!fn(t, it->samples[2 * f], it->samples[2 * f + 1]))
+        return;
+    }
+  }
+}
+
+// Latency in us, or -1 if the output never reacted
+int64_t measure(const Probe &p) {
+  int64_t result = -1;
+  if (p.kind == COLD) {
+    forFrames(p.atUs, p.endUs, [&](uint64_t t, int16_t l, int16_t r) {
+      if (isSilent(l, r))
+        return true;
+      result = (int64_t)(t - p.atUs);
+      return false;
+    });
+  } else if (p.kind == PANIC) {
+    // Silent from the frame after the last loud one
+    uint64_t lastLoud = 0;
+    bool any = false;
+    forFrames(p.atUs, p.endUs, [&](uint64_t t, int16_t l, int16_t r) {
+      if (!isSilent(l, r)) {
+        lastLoud = t;
+        any = true;
+      }
+      return true;
+    });
+    uint64_t frame = 1000000 / AUDIO_SAMPLE_RATE + 1;
+    result = any ? (int64_t)(lastLoud + frame - p.atUs) : 0;
+  } else {
+    bool haveRef = false;
+    int16_t refL = 0, refR = 0;
+    forFrames(p.atUs - 1000, p.atUs, [&](uint64_t, int16_t l, int16_t r) {
+      refL = l;
+      refR = r;
+      haveRef = true;
+      return true;
+    });
+    if (!haveRef || isSilent(refL, refR))
+      return -1; // The old pad was not playing
+    forFrames(p.atUs, p.endUs, [&](uint64_t t, int16_t l, int16_t r) {
+      if (abs(l - refL) <= SILENCE && abs(r - refR) <= SILENCE)
+        return true;
+      result = (int64_t)(t - p.atUs);
+      return false;
+    });
+  }
+  return result;
+}
+
+// --- One scenario in a fresh firmware ---
+
+// Schedules `runs` cycles of `kind` and returns what to measure
+std::vector<Probe> schedule(ScenarioKind kind, int runs) {
+  std::vector<Probe> probes;
+  uint32_t seed = 12345;
+  auto jitterUs = [&seed] {
+    seed = seed * 1103515245 + 12345;
+    return (uint64_t)((seed >> 8) % 10000); // One loop() period
+  };
+
+  uint64_t t = FIRST_EVENT_US;
+  if (kind == CROSSFADE || kind == CUT) {
+    tap(t, PIN_PLAY);
+    t += 2000000;
+  }
+
+  for (int i = 0; i < runs; i++) {
+    t += jitterUs();
+    Probe p;
+    p.kind = kind;
+    if (kind == COLD) {
+      tap(t, PIN_PLAY);
+      p.atUs = t + TAP_MS * 1000;
+      tap(t + 1500000, PIN_PLAY); // Same key again: stop
+      p.endUs = t + 1500000;
+      t += 3000000;
+    } else if (kind == PANIC) {
+      tap(t, PIN_PLAY);
+      uint64_t hold = t + 1500000;
+      tap(hold, PIN_PLAY, PANIC_HOLD_MS + 500);
+      p.atUs = hold + PANIC_HOLD_MS * 1000;
+      p.endUs = hold + (PANIC_HOLD_MS + 500) * 1000;
+      // Panic leaves the engine at volume 0: nudge the knob back to 21
+      turnVolume(p.endUs + 100000, -1);
+      turnVolume(p.endUs + 200000, +1);
+      t = p.endUs + 500000;
+    } else {
+      tap(t, PIN_NEXT);
+      uint64_t play = t + 300000;
+      tap(play, PIN_PLAY);
+      p.atUs = play + TAP_MS * 1000;
+      t = play + 2500000;
+      p.endUs = t;
+    }
+    probes.push_back(p);
+  }
+  return probes;
+}
+
+// Child side: boot, run, write one int64 per probe to `fd`
+void runChild(const fs::path &card, const Layout &layout, const Scenario &sc,
+              int runs, int fd, bool verbose) {
+  if (!verbose) {
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+  }
+  sim::setSdRoot(card.string());
+  sim::setSdTiming(SD_TIMING);
+
+  Preferences prefs;
+  prefs.begin("padium", false);
+  prefs.putBool("pcm", true);
+  prefs.putBool("xfade", sc.kind != CUT);
+  prefs.putInt("preset", layout.banks - 1);
+  prefs.end();
+
+  std::vector<Probe> probes = schedule(sc.kind, runs);
+  sim::runUntil(probes.back().endUs + 1000000);
+
+  for (const Probe &p : probes) {
+    int64_t us = measure(p);
+    if (write(fd, &us, sizeof(us)) != sizeof(us))
+      break;
+  }
+  fflush(stdout);
+  _exit(0);
+}
+
+bool runScenario(const fs::path &card, const Layout &layout,
+                 const Scenario &sc, int runs, bool verbose,
+                 std::vector<int64_t> &out) {
+  int fds[2];
+  if (pipe(fds) != 0)
+    return false;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0)
+    return false;
+  if (pid == 0) {
+    close(fds[0]);
+    runChild(card, layout, sc, runs, fds[1], verbose);
+  }
+  close(fds[1]);
+  int64_t us;
+  while (read(fds[0], &us, sizeof(us)) == sizeof(us))
+    out.push_back(us);
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// --- Display traffic ---
+
+struct Interaction {
+  const char *name;
+  void (*input)(uint64_t atUs);
+  uint32_t budgetBytes; // Pixel bytes to the panel
+};
+
+const uint32_t FULL_FRAME_BYTES = 240 * 240 * 2;
+
+// In order, each from where the one before left the UI. Budgets sit ~20%
+// above today's figures; the full-frame ones are view changes. From
+// "play" on, the level meter's segments are counted too.
+const Interaction INTERACTIONS[] = {
+    {"volume", [](uint64_t t) { turnVolume(t, -1); }, 3000},
+    {"next key", [](uint64_t t) { tap(t, PIN_NEXT); }, 3300},
+    {"play", [](uint64_t t) { tap(t, PIN_PLAY); }, 22800},
+    {"bank", [](uint64_t t) { turn(t, PIN_ENC_A, PIN_ENC_B, +1); }, 3000},
+    {"menu open", [](uint64_t t) { tap(t, PIN_ENC_BTN); }, FULL_FRAME_BYTES},
+    {"menu scroll",
+     [](uint64_t t) { turn(t, PIN_ENC_A, PIN_ENC_B, +1); }, 9300},
+    {"menu close", [](uint64_t t) { tap(t, PIN_VOL_ENC_BTN); },
+     FULL_FRAME_BYTES}};
+
+// Pads long enough that no loop seam (a step in level, so in the meter)
+// falls inside the interactions
+const Layout DISPLAY_LAYOUT = {16, 12};
+const uint64_t INTERACTION_US = 500000;
+
+// Child side: boot, then write pushes and bytes (two uint64) per
+// interaction to `fd`
+void runDisplayChild(const fs::path &card, int fd, bool verbose) {
+  if (!verbose) {
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+  }
+  sim::setSdRoot(card.string());
+  sim::setSdTiming(SD_TIMING);
+
+  // Pads that sound, so the level meter moves after "play"
+  Preferences prefs;
+  prefs.begin("padium", false);
+  prefs.putBool("pcm", true);
+  prefs.end();
+
+  uint64_t t = FIRST_EVENT_US;
+  sim::runUntil(t);
+  for (const Interaction &in : INTERACTIONS) {
+    uint64_t pushes = sim::screenPushes(), bytes = sim::screenBytes();
+    in.input(t);
+    t += INTERACTION_US;
+    sim::runUntil(t);
+    uint64_t delta[2] = {sim::screenPushes() - pushes,
+                         sim::screenBytes() - bytes};
+    if (write(fd, delta, sizeof(delta)) != sizeof(delta))
+      break;
+  }
+  fflush(stdout);
+  _exit(0);
+}
+
+bool runDisplay(const fs::path &card, bool verbose,
+                std::vector<uint64_t> &out) {
+  int fds[2];
+  if (pipe(fds) != 0)
+    return false;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0)
+    return false;
+  if (pid == 0) {
+    close(fds[0]);
+    runDisplayChild(card, fds[1], verbose);
+  }
+  close(fds[1]);
+  uint64_t v;
+  while (read(fds[0], &v, sizeof(v)) == sizeof(v))
+    out.push_back(v);
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// --- Wi-Fi upload ---
+
+const Layout UPLOAD_LAYOUT = {16, 12};
+const uint64_t UPLOAD_TIMEOUT_US = 60000000;
+// Largest step between output samples: a declick fade of the loudest pad
+// moves ~20 per frame, a cut the whole level
+const int UPLOAD_MAX_STEP = 100;
+
+struct Upload {
+  const char *name;
+  const char *filename; // Into "Bank 00", whose C plays
+  uint32_t kb;
+  bool keepsPlaying; // The pad must play on, not a frame silent
+};
+
+const Upload UPLOADS[] = {{"new file", "Upload.mp3", 4096, true},
+                          {"playing pad", "C.mp3", 256, false}};
+
+struct UploadResult {
+  uint64_t underruns;    // AudioMetrics, during the upload
+  uint64_t silentFrames; // At the DAC, during the upload
+  uint64_t uploadUs;     // Request queued -> served
+  uint32_t maxStep;      // Between output samples, from the upload on
+  uint32_t clobbers;     // sim::openFileClobbers()
+  bool written;          // On the card at its full size
+};
+
+// Child side: boot, play, upload, write an UploadResult to `fd`
+void runUploadChild(const fs::path &card, const Upload &up, int fd,
+                    bool verbose) {
+  if (!verbose) {
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+  }
+  sim::setSdRoot(card.string());
+  sim::setSdTiming(SD_TIMING);
+
+  Preferences prefs;
+  prefs.begin("padium", false);
+  prefs.putBool("pcm", true);
+  prefs.end();
+
+  // Play, then Settings -> Wi-Fi (two rows up from the top, wrapping)
+  uint64_t t = FIRST_EVENT_US;
+  tap(t, PIN_PLAY);
+  tap(t + 1000000, PIN_ENC_BTN);
+  turn(t + 1300000, PIN_ENC_A, PIN_ENC_B, -1);
+  turn(t + 1400000, PIN_ENC_A, PIN_ENC_B, -1);
+  tap(t + 1800000, PIN_ENC_BTN);
+  sim::runUntil(t + 2500000);
+
+  UploadResult r = {};
+  uint32_t underruns = audioMetrics.underruns;
+  uint64_t start = sim::nowUs();
+  sim::httpUpload("Bank 00", up.filename, (size_t)up.kb * 1024);
+  while (sim::httpBusy() && sim::nowUs() - start < UPLOAD_TIMEOUT_US)
+    sim::runFor(10000);
+  uint64_t end = sim::nowUs();
+  sim::runFor(200000); // Let the DMA play out what was queued meanwhile
+
+  r.underruns = audioMetrics.underruns - underruns;
+  r.uploadUs = sim::httpBusy() ? 0 : end - start;
+  r.clobbers = sim::openFileClobbers();
+  std::error_code ec;
+  r.written = fs::file_size(card / "Bank 00" / up.filename, ec) ==
+              (uintmax_t)up.kb * 1024;
+  bool first = true;
+  int16_t lastL = 0, lastR = 0;
+  forFrames(start, sim::nowUs(), [&](uint64_t t, int16_t l, int16_t rr) {
+    if (t < end && isSilent(l, rr))
+      r.silentFrames++;
+    if (!first) {
+      r.maxStep = std::max(r.maxStep, (uint32_t)abs(l - lastL));
+      r.maxStep = std::max(r.maxStep, (uint32_t)abs(rr - lastR));
+    }
+    first = false;
+    lastL = l;
+    lastR = rr;
+    return true;
+  });
+  if (write(fd, &r, sizeof(r)) != sizeof(r))
+    _exit(1);
+  fflush(stdout);
+  _exit(0);
+}
+
+bool runUpload(const fs::path &card, const Upload &up, bool verbose,
+               UploadResult *out) {
+  int fds[2];
+  if (pipe(fds) != 0)
+    return false;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0)
+    return false;
+  if (pid == 0) {
+    close(fds[0]);
+    runUploadChild(card, up, fds[1], verbose);
+  }
+  close(fds[1]);
+  bool got = read(fds[0], out, sizeof(*out)) == sizeof(*out);
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return got && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Nearest rank, on sorted values
+uint32_t percentile(const std::vector<uint32_t> &v, int p) {
+  size_t rank = (v.size() * p + 99) / 100;
+  return v[rank > 0 ? rank - 1 : 0];
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int runs = 40;
+  bool verbose = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--runs") && i + 1 < argc)
+      runs = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--verbose"))
+      verbose = true;
+    else {
+      fprintf(stderr, "usage: program [--runs N] [--verbose]\n");
+      return 1;
+    }
+  }
+  if (runs < 1)
+    runs = 1;
+
+  char tmpl[] = "/tmp/padium-bench-XXXXXX";
+  if (!mkdtemp(tmpl)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  fs::path work = tmpl;
+
+  printf("%-16s %-10s %5s %8s %8s %8s %8s  %s\n", "layout", "scenario",
+         "runs", "p50 ms", "p90 ms", "p99 ms", "max ms", "result");
+  bool failed = false;
+
+  for (const Layout &layout : LAYOUTS) {
+    fs::path root = work / std::to_string(&layout - LAYOUTS);
+    char label[32];
+    snprintf(label, sizeof(label), "%d banks, %ds", layout.banks,
+             layout.padSeconds);
+    if (!buildCard(root, layout)) {
+      fprintf(stderr, "Cannot build card image in %s\n", root.c_str());
+      failed = true;
+      break;
+    }
+
+    for (const Scenario &sc : SCENARIOS) {
+      std::vector<int64_t> raw;
+      bool ok = runScenario(root / "card", layout, sc, runs, verbose, raw);
+      std::vector<uint32_t> us;
+      for (int64_t v : raw) {
+        if (v >= 0)
+          us.push_back((uint32_t)v);
+      }
+      std::sort(us.begin(), us.end());
+      int missed = runs - (int)us.size();
+
+      const char *result = "ok";
+      if (!ok) {
+        result = "FAIL (simulation crashed)";
+      } else if (us.empty() || missed > 0) {
+        result = "FAIL (no reaction)";
+      } else {
+        if (percentile(us, 50) > sc.p50BudgetUs ||
+            percentile(us, 99) > sc.p99BudgetUs)
+          result = "FAIL (over budget)";
+      }
+      if (strcmp(result, "ok") != 0)
+        failed = true;
+
+      if (us.empty()) {
+        printf("%-16s %-10s %5d %8s %8s %8s %8s  %s\n", label, sc.name, 0,
+               "-", "-", "-", "-", result);
+      } else {
+        printf("%-16s %-10s %5zu %8.2f %8.2f %8.2f %8.2f  %s\n", label,
+               sc.name, us.size(), percentile(us, 50) / 1000.0,
+               percentile(us, 90) / 1000.0, percentile(us, 99) / 1000.0,
+               us.back() / 1000.0, result);
+      }
+      fflush(stdout);
+    }
+  }
+
+  if (!failed) {
+    fs::path root = work / "display";
+    std::vector<uint64_t> raw;
+    bool ok = buildCard(root, DISPLAY_LAYOUT) &&
+              runDisplay(root / "card", verbose, raw);
+    printf("\n%-16s %-12s %6s %8s %6s  %s\n", "layout", "interaction",
+           "pushes", "bytes", "frame", "result");
+    char label[32];
+    snprintf(label, sizeof(label), "%d banks", DISPLAY_LAYOUT.banks);
+    for (size_t i = 0; i < sizeof(INTERACTIONS) / sizeof(INTERACTIONS[0]);
+         i++) {
+      const Interaction &in = INTERACTIONS[i];
+      const char *result = "ok";
+      if (!ok || raw.size() < (i + 1) * 2) {
+        result = "FAIL (simulation crashed)";
+        printf("%-16s %-12s %6s %8s %6s  %s\n", label, in.name, "-", "-", "-",
+               result);
+        failed = true;
+        continue;
+      }
+      uint64_t pushes = raw[i * 2], bytes = raw[i * 2 + 1];
+      if (pushes == 0)
+        result = "FAIL (no redraw)";
+      else if (bytes > in.budgetBytes)
+        result = "FAIL (over budget)";
+      if (strcmp(result, "ok") != 0)
+        failed = true;
+      printf("%-16s %-12s %6llu %8llu %5.1f%%  %s\n", label, in.name,
+             (unsigned long long)pushes, (unsigned long long)bytes,
+             bytes * 100.0 / FULL_FRAME_BYTES, result);
+    }
+  }
+
+  if (!failed) {
+    printf("\n%-16s %-12s %8s %6s %9s %9s %5s %8s  %s\n", "layout", "upload",
+           "size", "KB/s", "underruns", "silent ms", "step", "clobbers",
+           "result");
+    char label[32];
+    snprintf(label, sizeof(label), "%d banks, %ds", UPLOAD_LAYOUT.banks,
+             UPLOAD_LAYOUT.padSeconds);
+    for (const Upload &up : UPLOADS) {
+      fs::path root = work / "upload" / std::to_string(&up - UPLOADS);
+      UploadResult r = {};
+      bool ok = buildCard(root, UPLOAD_LAYOUT) &&
+                runUpload(root / "card", up, verbose, &r);
+      const char *result = "ok";
+      if (!ok)
+        result = "FAIL (simulation crashed)";
+      else if (r.uploadUs == 0 || !r.written)
+        result = "FAIL (upload not served)";
+      else if (r.clobbers > 0)
+        result = "FAIL (file open while replaced)";
+      else if (r.underruns > 0 || (up.keepsPlaying && r.silentFrames > 0))
+        result = "FAIL (audio dropped out)";
+      else if (r.maxStep > UPLOAD_MAX_STEP)
+        result = "FAIL (click)";
+      if (strcmp(result, "ok") != 0)
+        failed = true;
+      char size[16];
+      snprintf(size, sizeof(size), "%u KB", (unsigned)up.kb);
+      printf("%-16s %-12s %8s %6.0f %9llu %9.2f %5u %8u  %s\n", label,
+             up.name, size, r.uploadUs ? up.kb * 1e6 / r.uploadUs : 0.0,
+             (unsigned long long)r.underruns,
+             r.silentFrames * 1000.0 / AUDIO_SAMPLE_RATE, (unsigned)r.maxStep,
+             (unsigned)r.clobbers, result);
+    }
+  }
+
+  std::error_code ec;
+  fs::remove_all(work, ec);
+  return failed ? 1 : 0;
+}
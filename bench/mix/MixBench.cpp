@@ -0,0 +1,150 @@
+// AudioMixer cost per 1024-frame block, on the host.
+//
+//   program [--blocks N]
+//
+// Renders N blocks of 1024 stereo frames for each case in CASES, from
+// sources that only copy a buffer, so the figure is the mixer alone: the
+// gain ramps, the Q15 summing and the saturating output loop. Prints the
+// mean and worst block in microseconds and as a share of the block's
+// playing time (23.2 ms at 44.1 kHz).
+//
+// Host timings only rank changes to the kernel against each other; the
+// ESP32 runs it several times slower. Exits 1 when a case's mean goes over
+// MAX_SHARE of real time, which no sane build of the mixer comes near.
+
+#include "AudioMixer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+const size_t BLOCK_FRAMES = 1024;
+const uint32_t SAMPLE_RATE = 44100;
+const uint32_t FADE_FRAMES = 60 * SAMPLE_RATE; // Ramping for the whole run
+const double MAX_SHARE = 0.05;
+
+// Noise from a fixed seed, looped, so the output is not constant
+class NoiseSource : public PcmSource {
+public:
+  explicit NoiseSource(uint32_t seed) : at(0) {
+    for (size_t i = 0; i < sizeof(buf) / sizeof(buf[0]); i++) {
+      seed = seed * 1664525u + 1013904223u;
+      buf[i] = (int16_t)(seed >> 17) - 16384;
+    }
+  }
+
+  size_t read(int16_t *out, size_t frames) override {
+    size_t frameCount = sizeof(buf) / sizeof(buf[0]) / 2;
+    for (size_t done = 0; done < frames;) {
+      size_t n = std::min(frames - done, frameCount - at);
+      memcpy(out + done * 2, buf + at * 2, n * 2 * sizeof(int16_t));
+      done += n;
+      at = (at + n) % frameCount;
+    }
+    return frames;
+  }
+  uint32_t sampleRate() const override { return SAMPLE_RATE; }
+  bool isOpen() const override { return true; }
+  void close() override {}
+
+private:
+  int16_t buf[4096 * 2];
+  size_t at;
+};
+
+struct Case {
+  const char *name;
+  int voices;       // Sources started, one per layer then crossfaded
+  bool crossfade;   // Voices still on their gain ramps
+  bool layerGlide;  // A layer level gliding
+  bool masterGlide; // The master gain gliding
+};
+
+const Case CASES[] = {
+    {"1 voice", 1, false, false, false},
+    {"2 layers", 2, false, false, false},
+    {"crossfade", 2, true, false, false},
+    {"2x crossfade", 4, true, false, false},
+    {"all gliding", 4, true, true, true},
+};
+
+void setup(AudioMixer &mixer, const Case &c, NoiseSource *sources) {
+  // One layer per pair of voices: a play with no fade, then (crossfade)
+  // a second play that fades over the whole run
+  PcmSource *first[AudioMixer::MAX_LAYERS] = {};
+  PcmSource *second[AudioMixer::MAX_LAYERS] = {};
+  int layers = c.crossfade ? c.voices / 2 : c.voices;
+  for (int l = 0; l < layers; l++) {
+    first[l] = &sources[l];
+    second[l] = &sources[layers + l];
+  }
+  mixer.play(first, 0);
+  if (c.crossfade) {
+    mixer.makeRoom(AudioMixer::MAX_LAYERS);
+    mixer.play(second, FADE_FRAMES);
+  }
+  if (c.layerGlide)
+    mixer.setLayerGain(0, 0.5f, FADE_FRAMES);
+  if (c.masterGlide)
+    mixer.setMasterGain(0.5f, FADE_FRAMES);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int blocks = 1000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--blocks") && i + 1 < argc)
+      blocks = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: program [--blocks N]\n");
+      return 1;
+    }
+  }
+  // Every block of a crossfade case must still be ramping
+  int maxBlocks = (int)(FADE_FRAMES / BLOCK_FRAMES);
+  blocks = std::max(1, std::min(blocks, maxBlocks));
+
+  const double blockUs = BLOCK_FRAMES * 1e6 / SAMPLE_RATE;
+  static int16_t out[BLOCK_FRAMES * 2];
+  bool failed = false;
+
+  printf("%-14s %7s %9s %9s %7s  %s\n", "case", "blocks", "mean us",
+         "max us", "share", "result");
+  for (const Case &c : CASES) {
+    static NoiseSource sources[4] = {NoiseSource(1), NoiseSource(2),
+                                     NoiseSource(3), NoiseSource(4)};
+    AudioMixer mixer;
+    setup(mixer, c, sources);
+    mixer.render(out, BLOCK_FRAMES); // Warm the caches
+
+    double total = 0, worst = 0;
+    for (int b = 0; b < blocks; b++) {
+      auto start = std::chrono::steady_clock::now();
+      mixer.render(out, BLOCK_FRAMES);
+      double us = std::chrono::duration<double, std::micro>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      total += us;
+      worst = std::max(worst, us);
+    }
+    uint16_t peak, rms;
+    mixer.takeLevels(&peak, &rms);
+
+    double mean = total / blocks;
+    const char *result = "ok";
+    if (peak == 0)
+      result = "FAIL (silent)";
+    else if (mean > blockUs * MAX_SHARE)
+      result = "FAIL (over budget)";
+    if (strcmp(result, "ok") != 0)
+      failed = true;
+    printf("%-14s %7d %9.2f %9.2f %6.2f%%  %s\n", c.name, blocks, mean,
+           worst, mean * 100 / blockUs, result);
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,259 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// The slice of the Arduino-ESP32 core the firmware uses, for the host
+// simulation. Time comes from the virtual clock in SimKernel.cpp.
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define IRAM_ATTR
+#define PROGMEM
+#define digitalPinToInterrupt(p) (p)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+using std::max;
+using std::min;
+
+#define constrain(v, lo, hi) ((v) < (lo) ? (lo) : ((v) > (hi) ? (hi) : (v)))
+
+// --- String ---
+
+class String : public std::string {
+public:
+  String() {}
+  String(const char *s) : std::string(s ? s : "") {}
+  String(const std::string &s) : std::string(s) {}
+  String(char c) : std::string(1, c) {}
+  String(int v) : std::string(std::to_string(v)) {}
+  String(unsigned int v) : std::string(std::to_string(v)) {}
+  String(long v) : std::string(std::to_string(v)) {}
+  String(unsigned long v) : std::string(std::to_string(v)) {}
+  String(long long v) : std::string(std::to_string(v)) {}
+  String(unsigned long long v) : std::string(std::to_string(v)) {}
+  String(double v, unsigned int decimals = 2) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    assign(buf);
+  }
+
+  unsigned int length() const { return (unsigned int)size(); }
+  bool isEmpty() const { return empty(); }
+  char charAt(unsigned int i) const { return i < size() ? (*this)[i] : 0; }
+
+  bool equals(const String &s) const { return *this == s; }
+  bool equalsIgnoreCase(const String &s) const {
+    return size() == s.size() &&
+           std::equal(begin(), end(), s.begin(), [](char a, char b) {
+             return tolower((unsigned char)a) == tolower((unsigned char)b);
+           });
+  }
+  bool startsWith(const String &s) const {
+    return size() >= s.size() && compare(0, s.size(), s) == 0;
+  }
+  bool endsWith(const String &s) const {
+    return size() >= s.size() && compare(size() - s.size(), s.size(), s) == 0;
+  }
+
+  int indexOf(char c, unsigned int from = 0) const {
+    size_type p = find(c, from);
+    return p == npos ? -1 : (int)p;
+  }
+  int indexOf(const String &s, unsigned int from = 0) const {
+    size_type p = find(s, from);
+    return p == npos ? -1 : (int)p;
+  }
+  int lastIndexOf(char c) const {
+    size_type p = rfind(c);
+    return p == npos ? -1 : (int)p;
+  }
+  int lastIndexOf(const String &s) const {
+    size_type p = rfind(s);
+    return p == npos ? -1 : (int)p;
+  }
+
+  String substring(unsigned int from) const {
+    return from >= size() ? String() : String(substr(from));
+  }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to)
+      std::swap(from, to);
+    if (from >= size())
+      return String();
+    return String(substr(from, to - from));
+  }
+
+  void toLowerCase() {
+    for (char &c : *this)
+      c = (char)tolower((unsigned char)c);
+  }
+  void toUpperCase() {
+    for (char &c : *this)
+      c = (char)toupper((unsigned char)c);
+  }
+  void trim() {
+    size_type a = find_first_not_of(" \t\r\n");
+    size_type b = find_last_not_of(" \t\r\n");
+    if (a == npos)
+      clear();
+    else
+      assign(substr(a, b - a + 1));
+  }
+  void replace(const String &from, const String &to) {
+    if (from.empty())
+      return;
+    size_type p = 0;
+    while ((p = find(from, p)) != npos) {
+      std::string::replace(p, from.size(), to);
+      p += to.size();
+    }
+  }
+  void remove(unsigned int index) { erase(std::min<size_t>(index, size())); }
+  void remove(unsigned int index, unsigned int count) {
+    if (index < size())
+      erase(index, count);
+  }
+  bool concat(const String &s) {
+    append(s);
+    return true;
+  }
+
+  long toInt() const { return atol(c_str()); }
+  float toFloat() const { return (float)atof(c_str()); }
+};
+
+inline String operator+(const String &a, const String &b) {
+  return String(static_cast<const std::string &>(a) +
+                static_cast<const std::string &>(b));
+}
+inline String operator+(const String &a, const char *b) {
+  return String(static_cast<const std::string &>(a) + b);
+}
+inline String operator+(const char *a, const String &b) {
+  return String(a + static_cast<const std::string &>(b));
+}
+inline String operator+(const String &a, char b) {
+  return String(static_cast<const std::string &>(a) + b);
+}
+
+// --- Print / Serial ---
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++)
+      write(buf[i]);
+    return len;
+  }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned int v) { return printf("%u", v); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(const T &v) {
+    size_t n = print(v);
+    return n + println();
+  }
+
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long) {}
+  void end() {}
+  int available();
+  int read();
+  int peek();
+  void flush() { fflush(stdout); }
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t len) override;
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// --- Time ---
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// --- GPIO ---
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t level);
+int analogRead(uint8_t pin);
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode);
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg,
+                        int mode);
+void detachInterrupt(uint8_t pin);
+
+// --- LEDC (backlight) ---
+
+double ledcSetup(uint8_t channel, double freq, uint8_t resolutionBits);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcWrite(uint8_t channel, uint32_t duty);
+
+// --- Misc ---
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+// --- ESP ---
+
+// The host has no ESP32 heap to report: both read 0
+class EspClass {
+public:
+  uint32_t getFreeHeap() { return 0; }
+  uint32_t getMaxAllocHeap() { return 0; }
+};
+
+extern EspClass ESP;
+
+#endif
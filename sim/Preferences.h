@@ -0,0 +1,98 @@
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+// NVS preferences kept in memory for the life of the simulation
+
+#include "Arduino.h"
+
+#include <map>
+#include <vector>
+
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false,
+             const char *partition = NULL) {
+    ns = &store()[name];
+    this->readOnly = readOnly;
+    return true;
+  }
+  void end() { ns = NULL; }
+  bool clear() {
+    if (!ns || readOnly)
+      return false;
+    ns->clear();
+    return true;
+  }
+  bool remove(const char *key) {
+    return ns && !readOnly && ns->erase(key) > 0;
+  }
+  bool isKey(const char *key) { return ns && ns->count(key) > 0; }
+
+  size_t putInt(const char *key, int32_t v) { return putRaw(key, &v, sizeof(v)); }
+  size_t putUInt(const char *key, uint32_t v) { return putRaw(key, &v, sizeof(v)); }
+  size_t putBool(const char *key, bool v) {
+    uint8_t b = v;
+    return putRaw(key, &b, sizeof(b));
+  }
+  size_t putString(const char *key, const String &v) {
+    return putRaw(key, v.c_str(), v.size());
+  }
+  size_t putBytes(const char *key, const void *v, size_t len) {
+    return putRaw(key, v, len);
+  }
+
+  int32_t getInt(const char *key, int32_t def = 0) { return getPod(key, def); }
+  uint32_t getUInt(const char *key, uint32_t def = 0) { return getPod(key, def); }
+  bool getBool(const char *key, bool def = false) {
+    return getPod<uint8_t>(key, def) != 0;
+  }
+  String getString(const char *key, const String &def = String()) {
+    const std::vector<uint8_t> *v = find(key);
+    return v ? String(std::string(v->begin(), v->end())) : def;
+  }
+  size_t getBytesLength(const char *key) {
+    const std::vector<uint8_t> *v = find(key);
+    return v ? v->size() : 0;
+  }
+  size_t getBytes(const char *key, void *buf, size_t maxLen) {
+    const std::vector<uint8_t> *v = find(key);
+    if (!v || v->size() > maxLen)
+      return 0;
+    memcpy(buf, v->data(), v->size());
+    return v->size();
+  }
+
+private:
+  typedef std::map<std::string, std::vector<uint8_t>> Namespace;
+  Namespace *ns = NULL;
+  bool readOnly = false;
+
+  static std::map<std::string, Namespace> &store() {
+    static std::map<std::string, Namespace> s;
+    return s;
+  }
+
+  size_t putRaw(const char *key, const void *v, size_t len) {
+    if (!ns || readOnly)
+      return 0;
+    const uint8_t *p = (const uint8_t *)v;
+    (*ns)[key] = std::vector<uint8_t>(p, p + len);
+    return len;
+  }
+  const std::vector<uint8_t> *find(const char *key) {
+    if (!ns)
+      return NULL;
+    Namespace::const_iterator it = ns->find(key);
+    return it == ns->end() ? NULL : &it->second;
+  }
+  template <typename T> T getPod(const char *key, T def) {
+    const std::vector<uint8_t> *v = find(key);
+    if (!v || v->size() != sizeof(T))
+      return def;
+    T out;
+    memcpy(&out, v->data(), sizeof(T));
+    return out;
+  }
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef SIM_SD_H
+#define SIM_SD_H
+
+// SD card backed by a host directory (sim::setSdRoot, "sd" by default).
+// Paths are card paths ("/Bank/C.mp3"); directories list in name order so
+// runs are repeatable.
+
+#include "Arduino.h"
+#include "SPI.h"
+
+#include <memory>
+#include <time.h>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+typedef enum {
+  CARD_NONE,
+  CARD_MMC,
+  CARD_SD,
+  CARD_SDHC,
+  CARD_UNKNOWN
+} sdcard_type_t;
+
+struct SimFileImpl;
+
+class File {
+public:
+  File() {}
+  explicit File(std::shared_ptr<SimFileImpl> impl) : impl(impl) {}
+
+  operator bool() const;
+  size_t read(uint8_t *buf, size_t len);
+  int read();
+  int peek();
+  int available();
+  size_t write(const uint8_t *buf, size_t len);
+  size_t write(uint8_t c) { return write(&c, 1); }
+  bool seek(uint32_t pos);
+  size_t position() const;
+  size_t size() const;
+  void flush();
+  void close();
+
+  bool isDirectory() const;
+  File openNextFile(const char *mode = FILE_READ);
+  void rewindDirectory();
+  const char *name() const;
+  const char *path() const;
+  time_t getLastWrite();
+
+private:
+  std::shared_ptr<SimFileImpl> impl;
+};
+
+class SDFS {
+public:
+  bool begin(uint8_t ssPin, SPIClass &spi, uint32_t frequency = 4000000,
+             const char *mountpoint = "/sd", uint8_t maxFiles = 5,
+             bool formatIfEmpty = false);
+  void end() {}
+  sdcard_type_t cardType();
+  uint64_t totalBytes();
+  uint64_t usedBytes();
+
+  File open(const char *path, const char *mode = FILE_READ,
+            bool create = false);
+  File open(const String &path, const char *mode = FILE_READ,
+            bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *from, const char *to);
+  bool rename(const String &from, const String &to) {
+    return rename(from.c_str(), to.c_str());
+  }
+  bool mkdir(const char *path);
+  bool mkdir(const String &path) { return mkdir(path.c_str()); }
+  bool rmdir(const char *path);
+  bool rmdir(const String &path) { return rmdir(path.c_str()); }
+
+private:
+  bool mounted = false;
+};
+
+extern SDFS SD;
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SIM_SPI_H
+#define SIM_SPI_H
+
+#include "Arduino.h"
+
+#define FSPI 1
+#define HSPI 2
+#define VSPI 3
+
+class SPIClass {
+public:
+  explicit SPIClass(uint8_t bus = HSPI) : bus(bus) {}
+  void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1,
+             int8_t ss = -1) {}
+  void end() {}
+
+private:
+  uint8_t bus;
+};
+
+extern SPIClass SPI;
+
+#endif
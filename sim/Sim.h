@@ -0,0 +1,88 @@
+#ifndef SIM_H
+#define SIM_H
+
+// Control surface of the host simulation (native environment). The
+// firmware runs unmodified: setup() and loop() in a "loopTask", the other
+// tasks as they create themselves. Everything is driven by a virtual
+// microsecond clock that only advances while every task is blocked, so
+// code runs in zero virtual time and a run is fully deterministic.
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace sim {
+
+// --- Clock & scheduler ---
+uint64_t nowUs();
+
+// Boots the firmware on the first call, then runs until the virtual clock
+// reaches `untilUs`. Returns false if every task blocked forever first.
+bool runUntil(uint64_t untilUs);
+inline bool runFor(uint64_t us) { return runUntil(nowUs() + us); }
+
+// Call `fn` at virtual time `atUs`, in interrupt context (it must not
+// block). Used by the HAL shims for DMA and by scenarios for input.
+void at(uint64_t atUs, std::function<void()> fn);
+
+// --- GPIO ---
+void setPin(uint8_t pin, int level); // Fires attached interrupts on edges
+int pinLevel(uint8_t pin);
+
+// --- Serial console ---
+void serialInput(const char *text);
+
+// --- SD card (a host directory) ---
+void setSdRoot(const std::string &dir);
+const std::string &sdRoot();
+
+// Virtual time charged to the calling task per card access (all zero by
+// default). Opening a path walks each directory on the way, paying
+// `entryUs` for every entry ahead of the one it is looking for, the way
+// FatFs scans a FAT directory. Writes also stall now and then while the
+// card erases internally: `writeStallUs` once per `writeStallKB` written.
+struct SdTiming {
+  uint32_t commandUs; // Per open, read or write
+  uint32_t entryUs;   // Per directory entry scanned by an open
+  uint32_t usPerKB;   // Data transfer
+  uint32_t writeStallUs;
+  uint32_t writeStallKB;
+};
+void setSdTiming(const SdTiming &timing);
+
+// Files removed, or opened for writing, while another handle still had
+// them open. FatFs without FF_FS_LOCK allows both, and the reader then
+// follows clusters that now belong to something else.
+uint32_t openFileClobbers();
+
+// --- I2S output ---
+struct AudioBlock {
+  uint64_t startUs; // When the first frame reached the DAC
+  uint32_t rate;
+  std::vector<int16_t> samples; // Interleaved stereo
+};
+const std::vector<AudioBlock> &audioOutput();
+void clearAudioOutput();
+bool writeWav(const std::string &path);
+
+// --- Wi-Fi file manager ---
+// Queue an upload of `bytes` bytes as `folder`/`filename`, as the file
+// manager's form sends it. Served by the firmware's next
+// WebServer::handleClient(), which only runs in Wi-Fi mode.
+void httpUpload(const std::string &folder, const std::string &filename,
+                size_t bytes);
+bool httpBusy(); // An upload is queued or being served
+
+// --- Display ---
+const uint16_t *screen(); // Last pushed frame, RGB565
+int screenWidth();
+int screenHeight();
+uint32_t screenPushes(); // Full frames and windows
+uint64_t screenBytes();   // Pixel bytes sent to the panel
+const std::vector<std::string> &screenText(); // Strings in the last push
+bool writeScreen(const std::string &ppmPath);
+
+} // namespace sim
+
+#endif
@@ -0,0 +1,169 @@
+#include "Arduino.h"
+#include "Sim.h"
+#include "WiFi.h"
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+
+void simSleepUs(uint32_t us); // SimKernel.cpp
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+EspClass ESP;
+
+// --- Print / Serial ---
+
+size_t Print::printf(const char *fmt, ...) {
+  char small[256];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(small, sizeof(small), fmt, ap);
+  va_end(ap);
+  if (n < 0)
+    return 0;
+  if ((size_t)n < sizeof(small))
+    return write((const uint8_t *)small, n);
+
+  std::string big(n + 1, '\0');
+  va_start(ap, fmt);
+  vsnprintf(&big[0], big.size(), fmt, ap);
+  va_end(ap);
+  return write((const uint8_t *)big.data(), n);
+}
+
+static std::deque<char> serialIn;
+
+size_t HardwareSerial::write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t len) {
+  return fwrite(buf, 1, len, stdout);
+}
+
+int HardwareSerial::available() { return (int)serialIn.size(); }
+
+int HardwareSerial::read() {
+  if (serialIn.empty())
+    return -1;
+  int c = (unsigned char)serialIn.front();
+  serialIn.pop_front();
+  return c;
+}
+
+int HardwareSerial::peek() {
+  return serialIn.empty() ? -1 : (unsigned char)serialIn.front();
+}
+
+// --- Time ---
+
+unsigned long millis() { return (unsigned long)(sim::nowUs() / 1000); }
+
+unsigned long micros() { return (unsigned long)sim::nowUs(); }
+
+void delay(uint32_t ms) { vTaskDelay(ms / portTICK_PERIOD_MS); }
+
+void delayMicroseconds(uint32_t us) { simSleepUs(us); }
+
+void yield() { taskYIELD(); }
+
+// --- GPIO ---
+
+struct PinState {
+  int level = HIGH; // Switches and encoders idle high (pull-ups)
+  std::function<void()> isr;
+  int isrMode = 0;
+  std::vector<std::function<void(int)>> watchers; // Peripherals, e.g. PCNT
+};
+
+static std::map<uint8_t, PinState> pins;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (mode == INPUT_PULLDOWN)
+    pins[pin].level = LOW;
+  else
+    pins[pin];
+}
+
+int digitalRead(uint8_t pin) { return pins[pin].level; }
+
+void digitalWrite(uint8_t pin, uint8_t level) { pins[pin].level = level; }
+
+int analogRead(uint8_t) { return 0; }
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode) {
+  pins[pin].isr = handler;
+  pins[pin].isrMode = mode;
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg,
+                        int mode) {
+  pins[pin].isr = [handler, arg] { handler(arg); };
+  pins[pin].isrMode = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+  pins[pin].isr = nullptr;
+  pins[pin].isrMode = 0;
+}
+
+// Calls `fn` with the new level on every edge of `pin`
+void simWatchPin(uint8_t pin, std::function<void(int)> fn) {
+  pins[pin].watchers.push_back(fn);
+}
+
+// --- LEDC ---
+
+double ledcSetup(uint8_t, double freq, uint8_t) { return freq; }
+
+void ledcAttachPin(uint8_t, uint8_t) {}
+
+void ledcWrite(uint8_t, uint32_t) {}
+
+// --- Misc ---
+
+static uint32_t rngState = 1;
+
+long random(long max) { return max > 0 ? random(0, max) : 0; }
+
+long random(long min, long max) {
+  if (max <= min)
+    return min;
+  rngState = rngState * 1103515245u + 12345u; // Deterministic across runs
+  return min + (long)((rngState >> 1) % (uint32_t)(max - min));
+}
+
+void randomSeed(unsigned long seed) { rngState = (uint32_t)seed; }
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+// --- Harness side ---
+
+namespace sim {
+
+void setPin(uint8_t pin, int level) {
+  PinState &p = pins[pin];
+  int old = p.level;
+  p.level = level ? HIGH : LOW;
+  if (old == p.level)
+    return;
+  for (auto &watch : p.watchers)
+    watch(p.level);
+  if (!p.isr)
+    return;
+  bool rising = p.level == HIGH;
+  if (p.isrMode == CHANGE || (p.isrMode == RISING && rising) ||
+      (p.isrMode == FALLING && !rising))
+    p.isr();
+}
+
+int pinLevel(uint8_t pin) { return pins[pin].level; }
+
+void serialInput(const char *text) {
+  while (*text)
+    serialIn.push_back(*text++);
+}
+
+} // namespace sim
@@ -0,0 +1,230 @@
+#include "Sim.h"
+#include "driver/i2s.h"
+#include "freertos/queue.h"
+
+#include <string.h>
+#include <vector>
+
+namespace {
+
+struct Port {
+  bool installed = false;
+  bool running = false;
+  uint32_t rate = 44100;
+  int bufCount = 0;
+  int bufFrames = 0;
+  size_t bufBytes = 0;
+  bool autoClear = false;
+  std::vector<std::vector<int16_t>> bufs;
+
+  QueueHandle_t freeBufs = NULL; // Indices of buffers the writer may fill
+  QueueHandle_t events = NULL;
+  int writeBuf = -1;
+  size_t writePos = 0;
+
+  int playing = 0;
+  uint64_t epochUs = 0;    // DMA (re)start time
+  uint64_t blocksPlayed = 0; // Since epochUs
+  uint32_t generation = 0; // Bumped to cancel the pending EOF timer
+};
+
+Port ports[I2S_NUM_MAX];
+std::vector<sim::AudioBlock> captured;
+
+uint64_t eofTime(const Port &p, uint64_t block) {
+  return p.epochUs + block * p.bufFrames * 1000000ULL / p.rate;
+}
+
+void scheduleEof(i2s_port_t num);
+
+// DMA finished `playing`: what the IDF ISR does on out_eof
+void onEof(i2s_port_t num, uint32_t generation) {
+  Port &p = ports[num];
+  if (!p.running || generation != p.generation)
+    return;
+
+  sim::AudioBlock block;
+  block.startUs = eofTime(p, p.blocksPlayed);
+  block.rate = p.rate;
+  block.samples = p.bufs[p.playing];
+  captured.push_back(block);
+  p.blocksPlayed++;
+
+  // All buffers free means nobody refilled them: recycle the oldest
+  if (xQueueIsQueueFullFromISR(p.freeBufs)) {
+    int dropped;
+    xQueueReceiveFromISR(p.freeBufs, &dropped, NULL);
+    if (p.autoClear)
+      std::fill(p.bufs[dropped].begin(), p.bufs[dropped].end(), 0);
+  }
+  xQueueSendFromISR(p.freeBufs, &p.playing, NULL);
+
+  if (p.events) {
+    i2s_event_t evt = {I2S_EVENT_TX_DONE, p.bufBytes};
+    if (xQueueIsQueueFullFromISR(p.events)) {
+      i2s_event_t dummy;
+      xQueueReceiveFromISR(p.events, &dummy, NULL);
+    }
+    xQueueSendFromISR(p.events, &evt, NULL);
+  }
+
+  p.playing = (p.playing + 1) % p.bufCount;
+  scheduleEof(num);
+}
+
+void scheduleEof(i2s_port_t num) {
+  Port &p = ports[num];
+  uint32_t gen = p.generation;
+  sim::at(eofTime(p, p.blocksPlayed + 1), [num, gen] { onEof(num, gen); });
+}
+
+} // namespace
+
+esp_err_t i2s_driver_install(i2s_port_t num, const i2s_config_t *cfg,
+                             int queueSize, void *eventQueue) {
+  Port &p = ports[num];
+  if (p.installed)
+    return ESP_ERR_INVALID_STATE;
+  p.installed = true;
+  p.rate = cfg->sample_rate;
+  p.bufCount = cfg->dma_buf_count;
+  p.bufFrames = cfg->dma_buf_len;
+  p.bufBytes = (size_t)p.bufFrames * 2 * sizeof(int16_t);
+  p.autoClear = cfg->tx_desc_auto_clear;
+  p.bufs.assign(p.bufCount, std::vector<int16_t>(p.bufFrames * 2, 0));
+  p.freeBufs = xQueueCreate(p.bufCount - 1, sizeof(int));
+  if (eventQueue && queueSize > 0) {
+    p.events = xQueueCreate(queueSize, sizeof(i2s_event_t));
+    *(QueueHandle_t *)eventQueue = p.events;
+  }
+  // The IDF driver starts the DMA at the end of install
+  return i2s_start(num);
+}
+
+esp_err_t i2s_driver_uninstall(i2s_port_t num) {
+  i2s_stop(num);
+  ports[num].installed = false;
+  return ESP_OK;
+}
+
+esp_err_t i2s_set_pin(i2s_port_t, const i2s_pin_config_t *) { return ESP_OK; }
+
+esp_err_t i2s_write(i2s_port_t num, const void *src, size_t size,
+                    size_t *written, TickType_t ticks) {
+  Port &p = ports[num];
+  const uint8_t *in = (const uint8_t *)src;
+  *written = 0;
+  while (size > 0) {
+    if (p.writeBuf < 0 || p.writePos == p.bufBytes) {
+      int b;
+      if (xQueueReceive(p.freeBufs, &b, ticks) != pdTRUE)
+        break;
+      p.writeBuf = b;
+      p.writePos = 0;
+    }
+    size_t n = p.bufBytes - p.writePos;
+    if (n > size)
+      n = size;
+    memcpy((uint8_t *)p.bufs[p.writeBuf].data() + p.writePos, in, n);
+    p.writePos += n;
+    in += n;
+    size -= n;
+    *written += n;
+  }
+  return ESP_OK;
+}
+
+esp_err_t i2s_set_clk(i2s_port_t num, uint32_t rate, uint32_t,
+                      i2s_channel_t) {
+  Port &p = ports[num];
+  bool wasRunning = p.running;
+  i2s_stop(num);
+  p.rate = rate;
+  if (wasRunning)
+    i2s_start(num);
+  return ESP_OK;
+}
+
+esp_err_t i2s_set_sample_rates(i2s_port_t num, uint32_t rate) {
+  return i2s_set_clk(num, rate, 16, I2S_CHANNEL_STEREO);
+}
+
+// Like the DMA, the buffer being played keeps what already went out
+esp_err_t i2s_zero_dma_buffer(i2s_port_t num) {
+  Port &p = ports[num];
+  size_t played = 0;
+  if (p.running) {
+    uint64_t start = eofTime(p, p.blocksPlayed);
+    uint64_t now = sim::nowUs();
+    if (now > start)
+      played = (size_t)((now - start) * p.rate / 1000000);
+    if (played > (size_t)p.bufFrames)
+      played = p.bufFrames;
+  }
+  for (int i = 0; i < p.bufCount; i++) {
+    auto &b = p.bufs[i];
+    size_t from = p.running && i == p.playing ? played * 2 : 0;
+    std::fill(b.begin() + from, b.end(), 0);
+  }
+  return ESP_OK;
+}
+
+esp_err_t i2s_start(i2s_port_t num) {
+  Port &p = ports[num];
+  if (p.running)
+    return ESP_OK;
+  p.running = true;
+  p.generation++;
+  p.playing = 0;
+  p.epochUs = sim::nowUs();
+  p.blocksPlayed = 0;
+  scheduleEof(num);
+  return ESP_OK;
+}
+
+esp_err_t i2s_stop(i2s_port_t num) {
+  Port &p = ports[num];
+  p.running = false;
+  p.generation++;
+  return ESP_OK;
+}
+
+namespace sim {
+
+const std::vector<AudioBlock> &audioOutput() { return captured; }
+
+void clearAudioOutput() { captured.clear(); }
+
+// Concatenates the capture as one 16-bit stereo WAV at the first rate
+bool writeWav(const std::string &path) {
+  FILE *f = fopen(path.c_str(), "wb");
+  if (!f)
+    return false;
+  uint32_t rate = captured.empty() ? 44100 : captured[0].rate;
+  uint32_t dataBytes = 0;
+  for (const AudioBlock &b : captured)
+    dataBytes += b.samples.size() * sizeof(int16_t);
+
+  uint8_t hdr[44];
+  auto put32 = [&hdr](int at, uint32_t v) { memcpy(hdr + at, &v, 4); };
+  auto put16 = [&hdr](int at, uint16_t v) { memcpy(hdr + at, &v, 2); };
+  memcpy(hdr, "RIFF", 4);
+  put32(4, 36 + dataBytes);
+  memcpy(hdr + 8, "WAVEfmt ", 8);
+  put32(16, 16);
+  put16(20, 1); // PCM
+  put16(22, 2);
+  put32(24, rate);
+  put32(28, rate * 4);
+  put16(32, 4);
+  put16(34, 16);
+  memcpy(hdr + 36, "data", 4);
+  put32(40, dataBytes);
+  fwrite(hdr, 1, sizeof(hdr), f);
+  for (const AudioBlock &b : captured)
+    fwrite(b.samples.data(), sizeof(int16_t), b.samples.size(), f);
+  fclose(f);
+  return true;
+}
+
+} // namespace sim
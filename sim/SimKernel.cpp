@@ -0,0 +1,661 @@
+// Virtual-time FreeRTOS kernel for the host simulation.
+//
+// Every task is a host thread, but exactly one of them runs at a time: the
+// running thread owns `big` and hands it over when it blocks. The clock
+// only moves when nothing is ready; it then jumps to the next timeout or
+// timer (DMA interrupts, scenario events), which run in "ISR context" on
+// the thread that went idle. Code therefore takes zero virtual time, and
+// latencies come out as what the design imposes (queue hops, DMA depth,
+// polling periods, tick alignment) rather than host load.
+
+#include "Sim.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+void setup();
+void loop();
+
+namespace {
+
+const uint64_t NEVER = UINT64_MAX;
+const uint64_t TICK_US = 1000000 / configTICK_RATE_HZ;
+
+struct Task;
+
+struct Queue {
+  size_t itemSize;
+  size_t length;
+  std::deque<std::vector<uint8_t>> items;
+  std::vector<Task *> receivers;
+  std::vector<Task *> senders;
+  Queue *set = nullptr; // Set this queue belongs to
+};
+
+struct Task {
+  std::string name;
+  UBaseType_t priority;
+  TaskFunction_t fn;
+  void *arg;
+  std::condition_variable cv;
+  bool ready = true;
+  bool done = false;
+  uint64_t wakeAt = NEVER;
+  bool timedOut = false;
+
+  uint32_t notifyValue = 0;
+  bool notifyPending = false;
+  bool notifyWaiting = false;
+};
+
+struct TaskExit {};
+
+std::mutex big;
+std::condition_variable mainCv;
+thread_local std::unique_lock<std::mutex> *heldLock = nullptr;
+
+std::vector<Task *> tasks;
+Task *current = nullptr;
+size_t lastPicked = 0;
+bool inIsr = false;
+
+uint64_t now = 0;
+uint64_t endAt = 0;
+bool paused = true;
+bool deadlocked = false;
+bool booted = false;
+
+std::multimap<uint64_t, std::function<void()>> timers;
+
+void fatal(const char *msg) {
+  fprintf(stderr, "[sim %.3f ms] FATAL: %s\n", now / 1000.0, msg);
+  fflush(stdout);
+  _exit(2);
+}
+
+void removeWaiter(std::vector<Task *> &list, Task *t) {
+  list.erase(std::remove(list.begin(), list.end(), t), list.end());
+}
+
+void makeReady(Task *t) {
+  t->ready = true;
+  t->wakeAt = NEVER;
+}
+
+// Highest priority ready task, round robin among equals
+Task *pickReady() {
+  Task *best = nullptr;
+  size_t bestIdx = 0;
+  size_t n = tasks.size();
+  for (size_t k = 1; k <= n; k++) {
+    size_t i = (lastPicked + k) % n;
+    Task *t = tasks[i];
+    if (t->ready && !t->done && (!best || t->priority > best->priority)) {
+      best = t;
+      bestIdx = i;
+    }
+  }
+  if (best)
+    lastPicked = bestIdx;
+  return best;
+}
+
+// Choose `current`, advancing the clock and firing timers as needed.
+// Sets `paused` (current = NULL) when the run window ends.
+void schedule() {
+  while (true) {
+    Task *next = pickReady();
+    if (next) {
+      current = next;
+      return;
+    }
+
+    uint64_t wake = NEVER;
+    for (Task *t : tasks) {
+      if (!t->done && t->wakeAt < wake)
+        wake = t->wakeAt;
+    }
+    if (!timers.empty() && timers.begin()->first < wake)
+      wake = timers.begin()->first;
+
+    if (wake == NEVER || wake > endAt) {
+      deadlocked = (wake == NEVER);
+      if (!deadlocked)
+        now = endAt;
+      current = nullptr;
+      paused = true;
+      mainCv.notify_all();
+      return;
+    }
+
+    now = wake;
+    inIsr = true;
+    while (!timers.empty() && timers.begin()->first <= now) {
+      std::function<void()> fn = timers.begin()->second;
+      timers.erase(timers.begin());
+      fn();
+    }
+    inIsr = false;
+
+    for (Task *t : tasks) {
+      if (!t->done && !t->ready && t->wakeAt <= now) {
+        t->timedOut = true;
+        makeReady(t);
+      }
+    }
+  }
+}
+
+// Give the CPU away from the calling task and wait until it is picked again
+void switchAway(Task *self) {
+  schedule();
+  if (current == self)
+    return;
+  if (current)
+    current->cv.notify_one();
+  self->cv.wait(*heldLock, [self] { return current == self && !paused; });
+}
+
+// Block the running task until woken or `deadline`. False on timeout.
+bool blockUntil(uint64_t deadline) {
+  Task *self = current;
+  self->ready = false;
+  self->timedOut = false;
+  self->wakeAt = deadline;
+  switchAway(self);
+  return !self->timedOut;
+}
+
+void yieldTask() {
+  if (!inIsr && current)
+    switchAway(current);
+}
+
+// Let a higher priority task that was just made ready run first
+void preemptIfNeeded(Task *woken) {
+  if (!inIsr && current && woken && woken->priority > current->priority)
+    yieldTask();
+}
+
+// Timeouts count whole ticks from the next tick boundary, like the tick
+// interrupt does
+uint64_t deadlineFor(TickType_t ticks) {
+  if (ticks == portMAX_DELAY)
+    return NEVER;
+  return (now / TICK_US + ticks) * TICK_US;
+}
+
+Task *wakeOne(std::vector<Task *> &list) {
+  if (list.empty())
+    return nullptr;
+  auto it = std::max_element(list.begin(), list.end(), [](Task *a, Task *b) {
+    return a->priority < b->priority;
+  });
+  Task *t = *it;
+  list.erase(it);
+  makeReady(t);
+  return t;
+}
+
+BaseType_t queueSend(Queue *q, const void *item, TickType_t ticks, bool front,
+                     bool overwrite) {
+  if (!q)
+    return pdFAIL;
+  uint64_t deadline = deadlineFor(ticks);
+  while (!overwrite && q->items.size() >= q->length) {
+    if (ticks == 0 || inIsr || !current)
+      return pdFALSE;
+    q->senders.push_back(current);
+    bool ok = blockUntil(deadline);
+    removeWaiter(q->senders, current);
+    if (!ok)
+      return pdFALSE;
+  }
+
+  std::vector<uint8_t> data(q->itemSize);
+  if (q->itemSize)
+    memcpy(data.data(), item, q->itemSize);
+  if (overwrite && !q->items.empty())
+    q->items.back() = data;
+  else if (front)
+    q->items.push_front(data);
+  else
+    q->items.push_back(data);
+
+  Task *woken = nullptr;
+  if (q->set) {
+    if (q->set->items.size() >= q->set->length)
+      fatal("queue set overflow (configASSERT in a real build)");
+    std::vector<uint8_t> handle(sizeof(void *));
+    void *self = q;
+    memcpy(handle.data(), &self, sizeof(void *));
+    q->set->items.push_back(handle);
+    woken = wakeOne(q->set->receivers);
+  }
+  Task *w = wakeOne(q->receivers);
+  if (w)
+    woken = w;
+  preemptIfNeeded(woken);
+  return pdTRUE;
+}
+
+BaseType_t queueReceive(Queue *q, void *item, TickType_t ticks, bool peek) {
+  if (!q)
+    return pdFAIL;
+  uint64_t deadline = deadlineFor(ticks);
+  while (q->items.empty()) {
+    if (ticks == 0 || inIsr || !current)
+      return pdFALSE;
+    q->receivers.push_back(current);
+    bool ok = blockUntil(deadline);
+    removeWaiter(q->receivers, current);
+    if (!ok)
+      return pdFALSE;
+  }
+  if (item && q->itemSize)
+    memcpy(item, q->items.front().data(), q->itemSize);
+  if (!peek) {
+    q->items.pop_front();
+    preemptIfNeeded(wakeOne(q->senders));
+  }
+  return pdTRUE;
+}
+
+void taskEntry(Task *t) {
+  std::unique_lock<std::mutex> lock(big);
+  heldLock = &lock;
+  t->cv.wait(lock, [t] { return current == t && !paused; });
+  try {
+    t->fn(t->arg);
+  } catch (const TaskExit &) {
+  }
+  t->done = true;
+  t->ready = false;
+  schedule();
+  if (current)
+    current->cv.notify_one();
+}
+
+void loopTaskEntry(void *) {
+  setup();
+  uint64_t lastNow = now;
+  uint32_t spins = 0;
+  while (true) {
+    loop();
+    if (now == lastNow) {
+      // The real loop task would trip the task watchdog
+      if (++spins > 1000000)
+        fatal("loop() never blocks; virtual time cannot advance");
+    } else {
+      lastNow = now;
+      spins = 0;
+    }
+  }
+}
+
+} // namespace
+
+void simAssertFailed(const char *expr, const char *file, int line) {
+  char msg[256];
+  snprintf(msg, sizeof(msg), "assert %s at %s:%d", expr, file, line);
+  fatal(msg);
+}
+
+// --- Harness API ---
+
+namespace sim {
+
+uint64_t nowUs() { return now; }
+
+void at(uint64_t atUs, std::function<void()> fn) {
+  timers.emplace(atUs < now ? now : atUs, fn);
+}
+
+bool runUntil(uint64_t untilUs) {
+  std::unique_lock<std::mutex> lock(big);
+  if (!booted) {
+    booted = true;
+    heldLock = &lock;
+    xTaskCreate(loopTaskEntry, "loopTask", 8192, nullptr, 1, nullptr);
+  }
+  endAt = untilUs;
+  paused = false;
+  deadlocked = false;
+  schedule();
+  if (current) {
+    current->cv.notify_one();
+    mainCv.wait(lock, [] { return paused; });
+  }
+  return !deadlocked;
+}
+
+} // namespace sim
+
+// --- Tasks ---
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                   uint32_t, void *arg, UBaseType_t priority,
+                                   TaskHandle_t *handle, BaseType_t) {
+  Task *t = new Task();
+  t->name = name ? name : "";
+  t->priority = priority;
+  t->fn = fn;
+  t->arg = arg;
+  tasks.push_back(t);
+  if (handle)
+    *handle = t;
+  std::thread(taskEntry, t).detach();
+  preemptIfNeeded(t);
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack,
+                       void *arg, UBaseType_t priority, TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(fn, name, stack, arg, priority, handle,
+                                 tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  Task *t = task ? (Task *)task : current;
+  if (t == current)
+    throw TaskExit();
+  t->done = true;
+  t->ready = false;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (ticks == 0)
+    yieldTask();
+  else
+    blockUntil(deadlineFor(ticks));
+}
+
+void vTaskDelayUntil(TickType_t *previousWake, TickType_t period) {
+  *previousWake += period;
+  uint64_t wake = (uint64_t)*previousWake * TICK_US;
+  if (wake > now)
+    blockUntil(wake);
+}
+
+void taskYIELD() { yieldTask(); }
+
+TickType_t xTaskGetTickCount() { return (TickType_t)(now / TICK_US); }
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return current; }
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+  Task *t = task ? (Task *)task : current;
+  return t ? t->priority : 0;
+}
+
+// --- Task notifications ---
+
+static BaseType_t notify(Task *t, uint32_t value, eNotifyAction action) {
+  if (!t)
+    return pdFAIL;
+  switch (action) {
+  case eNoAction:
+    break;
+  case eSetBits:
+    t->notifyValue |= value;
+    break;
+  case eIncrement:
+    t->notifyValue++;
+    break;
+  case eSetValueWithOverwrite:
+    t->notifyValue = value;
+    break;
+  case eSetValueWithoutOverwrite:
+    if (t->notifyPending)
+      return pdFAIL;
+    t->notifyValue = value;
+    break;
+  }
+  t->notifyPending = true;
+  if (t->notifyWaiting && !t->ready) {
+    t->notifyWaiting = false;
+    makeReady(t);
+    preemptIfNeeded(t);
+  }
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  return notify((Task *)task, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+  notify((Task *)task, 0, eIncrement);
+  if (woken)
+    *woken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  Task *self = current;
+  if (self->notifyValue == 0 && ticks != 0) {
+    self->notifyWaiting = true;
+    blockUntil(deadlineFor(ticks));
+    self->notifyWaiting = false;
+  }
+  uint32_t v = self->notifyValue;
+  if (v)
+    self->notifyValue = clearOnExit ? 0 : v - 1;
+  self->notifyPending = false;
+  return v;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value,
+                       eNotifyAction action) {
+  return notify((Task *)task, value, action);
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value,
+                              eNotifyAction action, BaseType_t *woken) {
+  if (woken)
+    *woken = pdTRUE;
+  return notify((Task *)task, value, action);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit,
+                           uint32_t *value, TickType_t ticks) {
+  Task *self = current;
+  if (!self->notifyPending) {
+    self->notifyValue &= ~clearOnEntry;
+    if (ticks != 0) {
+      self->notifyWaiting = true;
+      blockUntil(deadlineFor(ticks));
+      self->notifyWaiting = false;
+    }
+  }
+  if (value)
+    *value = self->notifyValue;
+  if (!self->notifyPending)
+    return pdFALSE;
+  self->notifyValue &= ~clearOnExit;
+  self->notifyPending = false;
+  return pdTRUE;
+}
+
+// --- Queues ---
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  Queue *q = new Queue();
+  q->length = length;
+  q->itemSize = itemSize;
+  return q;
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete (Queue *)queue; }
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks) {
+  return queueSend((Queue *)q, item, ticks, false, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void *item,
+                            TickType_t ticks) {
+  return queueSend((Queue *)q, item, ticks, false, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void *item,
+                             TickType_t ticks) {
+  return queueSend((Queue *)q, item, ticks, true, false);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t q, const void *item) {
+  return queueSend((Queue *)q, item, 0, false, true);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item,
+                             BaseType_t *woken) {
+  bool wasIsr = inIsr;
+  inIsr = true;
+  BaseType_t r = queueSend((Queue *)q, item, 0, false, false);
+  inIsr = wasIsr;
+  if (woken)
+    *woken = pdTRUE;
+  return r;
+}
+
+BaseType_t xQueueSendToFrontFromISR(QueueHandle_t q, const void *item,
+                                    BaseType_t *woken) {
+  bool wasIsr = inIsr;
+  inIsr = true;
+  BaseType_t r = queueSend((Queue *)q, item, 0, true, false);
+  inIsr = wasIsr;
+  if (woken)
+    *woken = pdTRUE;
+  return r;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+  return queueReceive((Queue *)q, item, ticks, false);
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t q, void *item,
+                                BaseType_t *woken) {
+  bool wasIsr = inIsr;
+  inIsr = true;
+  BaseType_t r = queueReceive((Queue *)q, item, 0, false);
+  inIsr = wasIsr;
+  if (woken)
+    *woken = pdFALSE;
+  return r;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t ticks) {
+  return queueReceive((Queue *)q, item, ticks, true);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  Queue *q = (Queue *)queue;
+  q->items.clear();
+  preemptIfNeeded(wakeOne(q->senders));
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+  return ((Queue *)q)->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+  Queue *q = (Queue *)queue;
+  return q->length - q->items.size();
+}
+
+BaseType_t xQueueIsQueueFullFromISR(QueueHandle_t queue) {
+  Queue *q = (Queue *)queue;
+  return q->items.size() >= q->length ? pdTRUE : pdFALSE;
+}
+
+// --- Queue sets ---
+
+QueueSetHandle_t xQueueCreateSet(UBaseType_t length) {
+  return xQueueCreate(length, sizeof(void *));
+}
+
+BaseType_t xQueueAddToSet(QueueSetMemberHandle_t member, QueueSetHandle_t set) {
+  Queue *q = (Queue *)member;
+  if (q->set || !q->items.empty())
+    return pdFAIL;
+  q->set = (Queue *)set;
+  return pdPASS;
+}
+
+BaseType_t xQueueRemoveFromSet(QueueSetMemberHandle_t member,
+                               QueueSetHandle_t set) {
+  Queue *q = (Queue *)member;
+  if (q->set != (Queue *)set || !q->items.empty())
+    return pdFAIL;
+  q->set = nullptr;
+  return pdPASS;
+}
+
+QueueSetMemberHandle_t xQueueSelectFromSet(QueueSetHandle_t set,
+                                           TickType_t ticks) {
+  void *member = nullptr;
+  if (queueReceive((Queue *)set, &member, ticks, false) != pdTRUE)
+    return nullptr;
+  return member;
+}
+
+// --- Semaphores ---
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  Queue *q = (Queue *)xQueueCreate(1, 0);
+  q->items.emplace_back();
+  return q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() { return xQueueCreate(1, 0); }
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max,
+                                           UBaseType_t initial) {
+  Queue *q = (Queue *)xQueueCreate(max, 0);
+  for (UBaseType_t i = 0; i < initial; i++)
+    q->items.emplace_back();
+  return q;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) { vQueueDelete(sem); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+  return queueReceive((Queue *)sem, nullptr, ticks, false);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  return queueSend((Queue *)sem, nullptr, 0, false, false);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken) {
+  return xQueueSendFromISR(sem, nullptr, woken);
+}
+
+BaseType_t xSemaphoreTakeFromISR(SemaphoreHandle_t sem, BaseType_t *woken) {
+  return xQueueReceiveFromISR(sem, nullptr, woken);
+}
+
+// --- Time ---
+
+int64_t esp_timer_get_time() { return (int64_t)now; }
+
+// Blocking for microseconds without tick alignment (delayMicroseconds)
+void simSleepUs(uint32_t us) {
+  if (us == 0 || inIsr || !current)
+    return;
+  blockUntil(now + us);
+}
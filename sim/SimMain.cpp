@@ -0,0 +1,211 @@
+// Entry point of the native build: boots the firmware against the sim HAL,
+// replays an optional input script and saves what came out.
+//
+//   program [--sd DIR] [--time MS] [--script FILE] [--wav FILE]
+//           [--screen FILE]
+//
+// Script lines, times in virtual milliseconds since boot ('#' comments):
+//   1500 press PLAY          tap a switch (PLAY NEXT PREV NAV_BTN VOL_BTN)
+//   1500 hold PLAY 1200      hold it for 1200 ms
+//   2000 turn VOL 3          encoder detents (VOL NAV), negative = down
+//   2500 pin 33 0            drive a GPIO directly
+//   3000 serial m            type on the serial console
+//   3500 screen menu.ppm     save the panel as it is then
+//   4000 upload Pads C.mp3 512  POST a 512 KB file to a bank (Wi-Fi mode)
+
+#include "Config.h"
+#include "Sim.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t TAP_MS = 80;
+const uint32_t DETENT_MS = 20; // One encoder detent, all four edges
+
+struct Encoder {
+  const char *name;
+  uint8_t a, b;
+};
+
+const Encoder ENCODERS[] = {{"VOL", PIN_VOL_ENC_A, PIN_VOL_ENC_B},
+                            {"NAV", PIN_ENC_A, PIN_ENC_B}};
+
+int buttonPin(const std::string &name) {
+  if (name == "PLAY")
+    return PIN_PLAY;
+  if (name == "NEXT")
+    return PIN_NEXT;
+  if (name == "PREV")
+    return PIN_PREV;
+  if (name == "NAV_BTN")
+    return PIN_ENC_BTN;
+  if (name == "VOL_BTN")
+    return PIN_VOL_ENC_BTN;
+  return -1;
+}
+
+const Encoder *encoder(const std::string &name) {
+  for (const Encoder &e : ENCODERS) {
+    if (name == e.name)
+      return &e;
+  }
+  return NULL;
+}
+
+void holdButton(uint64_t atUs, uint8_t pin, uint32_t ms) {
+  sim::at(atUs, [pin] { sim::setPin(pin, LOW); });
+  sim::at(atUs + ms * 1000ULL, [pin] { sim::setPin(pin, HIGH); });
+}
+
+// One detent: A falls with B high (up) or low (down), then both return
+// One detent is a full quadrature cycle from rest (both phases high):
+// clockwise A falls first, counter-clockwise B does
+void turnEncoder(uint64_t atUs, const Encoder *e, int steps) {
+  int n = steps > 0 ? steps : -steps;
+  uint8_t first = steps > 0 ? e->a : e->b;
+  uint8_t second = steps > 0 ? e->b : e->a;
+  for (int i = 0; i < n; i++) {
+    uint64_t t = atUs + (uint64_t)i * DETENT_MS * 1000;
+    uint64_t phase = DETENT_MS * 1000 / 4;
+    sim::at(t, [first] { sim::setPin(first, LOW); });
+    sim::at(t + phase, [second] { sim::setPin(second, LOW); });
+    sim::at(t + 2 * phase, [first] { sim::setPin(first, HIGH); });
+    sim::at(t + 3 * phase, [second] { sim::setPin(second, HIGH); });
+  }
+}
+
+bool loadScript(const char *path) {
+  std::ifstream in(path);
+  if (!in) {
+    fprintf(stderr, "Cannot open script %s\n", path);
+    return false;
+  }
+  std::string line;
+  int lineNo = 0;
+  while (std::getline(in, line)) {
+    lineNo++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos)
+      line.erase(hash);
+    std::istringstream ss(line);
+    uint64_t ms;
+    std::string action;
+    if (!(ss >> ms >> action))
+      continue;
+    uint64_t atUs = ms * 1000;
+
+    std::string arg;
+    ss >> arg;
+    bool ok = true;
+    if (action == "press" || action == "hold") {
+      uint32_t holdMs = TAP_MS;
+      if (action == "hold")
+        ok = (bool)(ss >> holdMs);
+      int pin = buttonPin(arg);
+      ok = ok && pin >= 0;
+      if (ok)
+        holdButton(atUs, (uint8_t)pin, holdMs);
+    } else if (action == "turn") {
+      int steps = 0;
+      const Encoder *e = encoder(arg);
+      ok = e && (ss >> steps);
+      if (ok)
+        turnEncoder(atUs, e, steps);
+    } else if (action == "pin") {
+      int level = 0;
+      ok = (bool)(ss >> level);
+      uint8_t pin = (uint8_t)atoi(arg.c_str());
+      if (ok)
+        sim::at(atUs, [pin, level] { sim::setPin(pin, level); });
+    } else if (action == "serial") {
+      std::string rest;
+      std::getline(ss, rest);
+      std::string text = arg + rest;
+      sim::at(atUs, [text] { sim::serialInput(text.c_str()); });
+    } else if (action == "screen") {
+      std::string file = arg;
+      sim::at(atUs, [file] { sim::writeScreen(file); });
+    } else if (action == "upload") {
+      std::string file;
+      size_t kb = 0;
+      ok = (bool)(ss >> file >> kb);
+      std::string folder = arg;
+      if (ok)
+        sim::at(atUs, [folder, file, kb] {
+          sim::httpUpload(folder, file, kb * 1024);
+        });
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "%s:%d: cannot parse '%s'\n", path, lineNo,
+              line.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+void usage() {
+  fprintf(stderr, "usage: program [--sd DIR] [--time MS] [--script FILE] "
+                  "[--wav FILE] [--screen FILE]\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  uint64_t runMs = 10000;
+  const char *script = NULL;
+  std::string wavPath = "sim_out.wav";
+  std::string screenPath = "sim_screen.ppm";
+
+  for (int i = 1; i < argc; i++) {
+    bool more = i + 1 < argc;
+    if (!strcmp(argv[i], "--sd") && more)
+      sim::setSdRoot(argv[++i]);
+    else if (!strcmp(argv[i], "--time") && more)
+      runMs = strtoull(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "--script") && more)
+      script = argv[++i];
+    else if (!strcmp(argv[i], "--wav") && more)
+      wavPath = argv[++i];
+    else if (!strcmp(argv[i], "--screen") && more)
+      screenPath = argv[++i];
+    else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (script && !loadScript(script))
+    return 1;
+
+  bool alive = sim::runUntil(runMs * 1000);
+
+  size_t audible = 0;
+  for (const sim::AudioBlock &b : sim::audioOutput()) {
+    for (int16_t s : b.samples) {
+      if (s != 0) {
+        audible++;
+        break;
+      }
+    }
+  }
+  printf("\n[sim] %.3f s virtual, %zu I2S buffers (%zu audible), %u screen "
+         "pushes (%.1f KB)%s\n",
+         sim::nowUs() / 1e6, sim::audioOutput().size(), audible,
+         sim::screenPushes(), sim::screenBytes() / 1024.0,
+         alive ? "" : ", all tasks blocked");
+  sim::writeWav(wavPath);
+  sim::writeScreen(screenPath);
+  fflush(stdout);
+
+  // Task threads are parked inside the firmware; skip static destructors
+  _exit(0);
+}
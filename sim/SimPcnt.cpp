@@ -0,0 +1,120 @@
+#include "driver/pcnt.h"
+#include "Arduino.h"
+#include "Sim.h"
+
+#include <functional>
+
+void simWatchPin(uint8_t pin, std::function<void(int)> fn); // SimArduino.cpp
+
+namespace {
+
+struct Channel {
+  bool configured = false;
+  int pulsePin;
+  int ctrlPin;
+  pcnt_ctrl_mode_t lctrl, hctrl;
+  pcnt_count_mode_t pos, neg;
+};
+
+struct Unit {
+  Channel channels[PCNT_CHANNEL_MAX];
+  int16_t count = 0;
+  int16_t hLim = 0, lLim = 0;
+  bool paused = false;
+};
+
+Unit units[PCNT_UNIT_MAX];
+
+void onEdge(pcnt_unit_t u, pcnt_channel_t c, int level) {
+  Unit &unit = units[u];
+  const Channel &ch = unit.channels[c];
+  if (unit.paused)
+    return;
+  pcnt_count_mode_t mode = level == HIGH ? ch.pos : ch.neg;
+  if (ch.ctrlPin != PCNT_PIN_NOT_USED) {
+    pcnt_ctrl_mode_t ctrl =
+        sim::pinLevel((uint8_t)ch.ctrlPin) == HIGH ? ch.hctrl : ch.lctrl;
+    if (ctrl == PCNT_MODE_DISABLE)
+      return;
+    if (ctrl == PCNT_MODE_REVERSE && mode != PCNT_COUNT_DIS)
+      mode = mode == PCNT_COUNT_INC ? PCNT_COUNT_DEC : PCNT_COUNT_INC;
+  }
+  if (mode == PCNT_COUNT_INC)
+    unit.count++;
+  else if (mode == PCNT_COUNT_DEC)
+    unit.count--;
+  // As the hardware: reaching a limit resets the counter
+  if ((unit.hLim && unit.count >= unit.hLim) ||
+      (unit.lLim && unit.count <= unit.lLim))
+    unit.count = 0;
+}
+
+bool validUnit(pcnt_unit_t u) { return u >= PCNT_UNIT_0 && u < PCNT_UNIT_MAX; }
+
+} // namespace
+
+esp_err_t pcnt_unit_config(const pcnt_config_t *cfg) {
+  if (!cfg || !validUnit(cfg->unit) || cfg->channel < PCNT_CHANNEL_0 ||
+      cfg->channel >= PCNT_CHANNEL_MAX)
+    return ESP_ERR_INVALID_ARG;
+  Unit &unit = units[cfg->unit];
+  Channel &ch = unit.channels[cfg->channel];
+  bool watched = ch.configured;
+  ch.configured = true;
+  ch.pulsePin = cfg->pulse_gpio_num;
+  ch.ctrlPin = cfg->ctrl_gpio_num;
+  ch.lctrl = cfg->lctrl_mode;
+  ch.hctrl = cfg->hctrl_mode;
+  ch.pos = cfg->pos_mode;
+  ch.neg = cfg->neg_mode;
+  unit.hLim = cfg->counter_h_lim;
+  unit.lLim = cfg->counter_l_lim;
+  unit.count = 0;
+  if (!watched && ch.pulsePin != PCNT_PIN_NOT_USED) {
+    pcnt_unit_t u = cfg->unit;
+    pcnt_channel_t c = cfg->channel;
+    simWatchPin((uint8_t)ch.pulsePin,
+                [u, c](int level) { onEdge(u, c, level); });
+  }
+  return ESP_OK;
+}
+
+esp_err_t pcnt_set_filter_value(pcnt_unit_t u, uint16_t value) {
+  return validUnit(u) && value < 1024 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_filter_enable(pcnt_unit_t u) {
+  return validUnit(u) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_filter_disable(pcnt_unit_t u) {
+  return validUnit(u) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t u) {
+  if (!validUnit(u))
+    return ESP_ERR_INVALID_ARG;
+  units[u].paused = true;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t u) {
+  if (!validUnit(u))
+    return ESP_ERR_INVALID_ARG;
+  units[u].paused = false;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t u) {
+  if (!validUnit(u))
+    return ESP_ERR_INVALID_ARG;
+  units[u].count = 0;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t u, int16_t *count) {
+  if (!validUnit(u) || !count)
+    return ESP_ERR_INVALID_ARG;
+  *count = units[u].count;
+  return ESP_OK;
+}
@@ -0,0 +1,322 @@
+#include "SD.h"
+#include "Sim.h"
+
+#include <filesystem>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+SDFS SD;
+SPIClass SPI;
+
+static std::string rootDir = "sd";
+static sim::SdTiming timing = {0, 0, 0, 0, 0};
+static uint64_t bytesWritten = 0; // Since the last write stall
+static uint32_t clobbers = 0;     // sim::openFileClobbers()
+
+void simSleepUs(uint32_t us); // SimKernel.cpp
+
+struct SimFileImpl {
+  std::string cardPath;
+  std::string base;
+  FILE *fp = nullptr;
+  bool dir = false;
+  std::vector<std::string> entries; // Directory listing, sorted
+  size_t nextEntry = 0;
+};
+
+// Every file opened, to find the handles still open on a path
+static std::vector<std::weak_ptr<SimFileImpl>> openFiles;
+
+static bool isOpen(const std::string &cardPath) {
+  for (auto it = openFiles.begin(); it != openFiles.end();) {
+    std::shared_ptr<SimFileImpl> f = it->lock();
+    if (!f || !f->fp) {
+      it = openFiles.erase(it);
+      continue;
+    }
+    if (f->cardPath == cardPath)
+      return true;
+    ++it;
+  }
+  return false;
+}
+
+static std::string cardPathOf(const char *path) {
+  std::string p = path ? path : "";
+  if (p.empty() || p[0] != '/')
+    p = "/" + p;
+  if (p.size() > 1 && p.back() == '/')
+    p.pop_back();
+  return p;
+}
+
+static std::string hostPath(const char *cardPath) {
+  std::string p = cardPath ? cardPath : "";
+  if (p.empty() || p[0] != '/')
+    p = "/" + p;
+  return rootDir + p;
+}
+
+static void chargeTransfer(size_t bytes) {
+  simSleepUs(timing.commandUs +
+             (uint32_t)(((uint64_t)bytes * timing.usPerKB + 1023) / 1024));
+}
+
+// Entries scanned to reach `cardPath`: for each component, its position in
+// the name-ordered listing of its parent, plus itself
+static uint32_t entriesScanned(const std::string &cardPath) {
+  uint32_t scanned = 0;
+  std::string dir = rootDir;
+  size_t pos = 0;
+  while (pos < cardPath.size()) {
+    size_t slash = cardPath.find('/', pos);
+    if (slash == std::string::npos)
+      slash = cardPath.size();
+    std::string name = cardPath.substr(pos, slash - pos);
+    pos = slash + 1;
+    if (name.empty())
+      continue;
+    std::error_code ec;
+    for (const auto &e : fs::directory_iterator(dir, ec)) {
+      if (e.path().filename().string() <= name)
+        scanned++;
+    }
+    dir += "/" + name;
+  }
+  return scanned;
+}
+
+static std::string baseName(const std::string &cardPath) {
+  size_t slash = cardPath.find_last_of('/');
+  return slash == std::string::npos ? cardPath : cardPath.substr(slash + 1);
+}
+
+// --- File ---
+
+File::operator bool() const {
+  return impl && (impl->dir || impl->fp);
+}
+
+size_t File::read(uint8_t *buf, size_t len) {
+  if (!impl || !impl->fp)
+    return 0;
+  size_t n = fread(buf, 1, len, impl->fp);
+  chargeTransfer(n);
+  return n;
+}
+
+// Served from the stdio buffer on the ESP32 too: no card access
+int File::read() {
+  if (!impl || !impl->fp)
+    return -1;
+  int c = fgetc(impl->fp);
+  return c == EOF ? -1 : c;
+}
+
+int File::peek() {
+  if (!impl || !impl->fp)
+    return -1;
+  int c = fgetc(impl->fp);
+  if (c != EOF)
+    ungetc(c, impl->fp);
+  return c == EOF ? -1 : c;
+}
+
+int File::available() {
+  if (!impl || !impl->fp)
+    return 0;
+  return (int)(size() - position());
+}
+
+size_t File::write(const uint8_t *buf, size_t len) {
+  if (!impl || !impl->fp)
+    return 0;
+  size_t n = fwrite(buf, 1, len, impl->fp);
+  chargeTransfer(n);
+  bytesWritten += n;
+  if (timing.writeStallKB && bytesWritten >= timing.writeStallKB * 1024ULL) {
+    bytesWritten %= timing.writeStallKB * 1024ULL;
+    simSleepUs(timing.writeStallUs);
+  }
+  return n;
+}
+
+bool File::seek(uint32_t pos) {
+  if (!impl || !impl->fp)
+    return false;
+  return fseek(impl->fp, pos, SEEK_SET) == 0;
+}
+
+size_t File::position() const {
+  if (!impl || !impl->fp)
+    return 0;
+  long p = ftell(impl->fp);
+  return p < 0 ? 0 : (size_t)p;
+}
+
+size_t File::size() const {
+  if (!impl || !impl->fp)
+    return 0;
+  fflush(impl->fp);
+  struct stat st;
+  if (fstat(fileno(impl->fp), &st) != 0)
+    return 0;
+  return (size_t)st.st_size;
+}
+
+void File::flush() {
+  if (impl && impl->fp)
+    fflush(impl->fp);
+}
+
+void File::close() {
+  if (impl && impl->fp) {
+    fclose(impl->fp);
+    impl->fp = nullptr;
+  }
+  impl.reset();
+}
+
+bool File::isDirectory() const { return impl && impl->dir; }
+
+File File::openNextFile(const char *mode) {
+  if (!impl || !impl->dir || impl->nextEntry >= impl->entries.size())
+    return File();
+  std::string child = impl->cardPath;
+  if (child.empty() || child.back() != '/')
+    child += "/";
+  child += impl->entries[impl->nextEntry++];
+  return SD.open(child.c_str(), mode);
+}
+
+void File::rewindDirectory() {
+  if (impl)
+    impl->nextEntry = 0;
+}
+
+const char *File::name() const { return impl ? impl->base.c_str() : ""; }
+
+const char *File::path() const { return impl ? impl->cardPath.c_str() : ""; }
+
+time_t File::getLastWrite() {
+  struct stat st;
+  if (!impl || stat(hostPath(impl->cardPath.c_str()).c_str(), &st) != 0)
+    return 0;
+  return st.st_mtime;
+}
+
+// --- SDFS ---
+
+bool SDFS::begin(uint8_t, SPIClass &, uint32_t, const char *, uint8_t, bool) {
+  std::error_code ec;
+  mounted = fs::is_directory(rootDir, ec);
+  return mounted;
+}
+
+sdcard_type_t SDFS::cardType() { return mounted ? CARD_SDHC : CARD_NONE; }
+
+uint64_t SDFS::totalBytes() {
+  std::error_code ec;
+  fs::space_info s = fs::space(rootDir, ec);
+  return ec ? 0 : s.capacity;
+}
+
+// What the card's files take up in 32 KB clusters, like FAT on an SDHC
+// card: the host volume's own usage would change under other programs
+uint64_t SDFS::usedBytes() {
+  const uint64_t cluster = 32 * 1024;
+  uint64_t used = 0;
+  std::error_code ec;
+  for (auto it = fs::recursive_directory_iterator(rootDir, ec);
+       !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    if (it->is_regular_file(ec))
+      used += (it->file_size(ec) + cluster - 1) / cluster * cluster;
+  }
+  return used;
+}
+
+File SDFS::open(const char *path, const char *mode, bool create) {
+  if (!mounted)
+    return File();
+  std::string host = hostPath(path);
+  auto impl = std::make_shared<SimFileImpl>();
+  impl->cardPath = path;
+  if (impl->cardPath.size() > 1 && impl->cardPath.back() == '/')
+    impl->cardPath.pop_back();
+  impl->base = baseName(impl->cardPath);
+  if (timing.commandUs || timing.entryUs)
+    simSleepUs(timing.commandUs +
+               timing.entryUs * entriesScanned(impl->cardPath));
+
+  std::error_code ec;
+  if (fs::is_directory(host, ec)) {
+    impl->dir = true;
+    for (const auto &e : fs::directory_iterator(host, ec))
+      impl->entries.push_back(e.path().filename().string());
+    std::sort(impl->entries.begin(), impl->entries.end());
+    return File(impl);
+  }
+
+  const char *fmode = "rb";
+  if (mode && mode[0] == 'w')
+    fmode = "w+b";
+  else if (mode && mode[0] == 'a')
+    fmode = "a+b";
+  if (create && fmode[0] == 'r' && !fs::exists(host, ec))
+    fmode = "w+b";
+  if (fmode[0] != 'r' && isOpen(cardPathOf(path)))
+    clobbers++;
+  impl->fp = fopen(host.c_str(), fmode);
+  if (!impl->fp)
+    return File();
+  openFiles.push_back(impl);
+  return File(impl);
+}
+
+bool SDFS::exists(const char *path) {
+  std::error_code ec;
+  return mounted && fs::exists(hostPath(path), ec);
+}
+
+bool SDFS::remove(const char *path) {
+  std::error_code ec;
+  std::string host = hostPath(path);
+  if (!mounted || !fs::is_regular_file(host, ec))
+    return false;
+  if (isOpen(cardPathOf(path)))
+    clobbers++;
+  return fs::remove(host, ec);
+}
+
+bool SDFS::rename(const char *from, const char *to) {
+  std::error_code ec;
+  if (!mounted || fs::exists(hostPath(to), ec))
+    return false; // FatFs refuses to overwrite
+  fs::rename(hostPath(from), hostPath(to), ec);
+  return !ec;
+}
+
+bool SDFS::mkdir(const char *path) {
+  std::error_code ec;
+  return mounted && fs::create_directory(hostPath(path), ec);
+}
+
+bool SDFS::rmdir(const char *path) {
+  std::error_code ec;
+  std::string host = hostPath(path);
+  return mounted && fs::is_directory(host, ec) && fs::is_empty(host, ec) &&
+         fs::remove(host, ec);
+}
+
+namespace sim {
+
+void setSdRoot(const std::string &dir) { rootDir = dir; }
+
+const std::string &sdRoot() { return rootDir; }
+
+void setSdTiming(const SdTiming &t) { timing = t; }
+
+uint32_t openFileClobbers() { return clobbers; }
+
+} // namespace sim
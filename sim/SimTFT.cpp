@@ -0,0 +1,320 @@
+#include "Sim.h"
+#include "TFT_eSPI.h"
+
+void simSleepUs(uint32_t us); // SimKernel.cpp
+
+static const int PANEL_W = 240;
+static const int PANEL_H = 240;
+static const uint32_t SPI_HZ = 27000000; // SPI_FREQUENCY in platformio.ini
+
+static std::vector<uint16_t> panel(PANEL_W *PANEL_H, 0);
+static std::vector<std::string> panelText;
+static uint32_t pushes = 0;
+static uint64_t pushedBytes = 0; // RGB565 pixels sent over SPI
+static uint64_t dmaDoneUs = 0;   // When the bus is free again
+static const std::vector<std::string> *drawnText = &panelText; // Last sprite
+
+static uint32_t transferUs(uint64_t bytes) {
+  return (uint32_t)(bytes * 8 * 1000000 / SPI_HZ);
+}
+
+// --- TFT_eSPI ---
+
+TFT_eSPI::TFT_eSPI(int16_t w, int16_t h) : w(w), h(h) {}
+
+void TFT_eSPI::init(uint8_t) {}
+
+void TFT_eSPI::pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h,
+                            uint16_t const *data, uint16_t *) {
+  dmaWait();
+  uint64_t sent = 0;
+  for (int32_t row = 0; row < h; row++) {
+    int32_t py = y + row;
+    for (int32_t col = 0; col < w && py >= 0 && py < PANEL_H; col++) {
+      int32_t px = x + col;
+      if (px >= 0 && px < PANEL_W) {
+        panel[(size_t)py * PANEL_W + px] = data[(size_t)row * w + col];
+        sent++;
+      }
+    }
+  }
+  panelText = *drawnText; // The pixels come from the last sprite drawn
+  pushes++;
+  pushedBytes += sent * 2;
+  dmaDoneUs = sim::nowUs() + transferUs(sent * 2);
+}
+
+bool TFT_eSPI::dmaBusy() { return sim::nowUs() < dmaDoneUs; }
+
+void TFT_eSPI::dmaWait() {
+  if (dmaBusy())
+    simSleepUs((uint32_t)(dmaDoneUs - sim::nowUs()));
+}
+
+void TFT_eSPI::fillScreen(uint32_t color) {
+  dmaWait();
+  std::fill(panel.begin(), panel.end(), (uint16_t)color);
+  panelText.clear();
+  pushes++;
+  pushedBytes += (uint64_t)PANEL_W * PANEL_H * 2;
+  simSleepUs(transferUs((uint64_t)PANEL_W * PANEL_H * 2));
+}
+
+// --- TFT_eSprite ---
+
+TFT_eSprite::TFT_eSprite(TFT_eSPI *) : TFT_eSPI(0, 0) {}
+
+void *TFT_eSprite::createSprite(int16_t width, int16_t height, uint8_t) {
+  w = width;
+  h = height;
+  fb.assign((size_t)w * h, 0);
+  resetViewport();
+  return fb.data();
+}
+
+void TFT_eSprite::deleteSprite() {
+  fb.clear();
+  w = h = 0;
+  resetViewport();
+}
+
+void TFT_eSprite::setViewport(int32_t x, int32_t y, int32_t vw, int32_t vh,
+                              bool vpDatum) {
+  xDatum = vpDatum ? x : 0;
+  yDatum = vpDatum ? y : 0;
+  clipX0 = std::max<int32_t>(x, 0);
+  clipY0 = std::max<int32_t>(y, 0);
+  clipX1 = std::max(clipX0, std::min<int32_t>(x + vw, w));
+  clipY1 = std::max(clipY0, std::min<int32_t>(y + vh, h));
+}
+
+void TFT_eSprite::resetViewport() { setViewport(0, 0, w, h, false); }
+
+void TFT_eSprite::fillSprite(uint32_t color) {
+  fillRect(clipX0 - xDatum, clipY0 - yDatum, clipX1 - clipX0, clipY1 - clipY0,
+           color);
+  texts.clear();
+  drawnText = &texts;
+}
+
+void TFT_eSprite::drawPixel(int32_t x, int32_t y, uint32_t color) {
+  x += xDatum;
+  y += yDatum;
+  if (x >= clipX0 && y >= clipY0 && x < clipX1 && y < clipY1)
+    fb[(size_t)y * w + x] = (uint16_t)color;
+}
+
+void TFT_eSprite::fillRect(int32_t x, int32_t y, int32_t rw, int32_t rh,
+                           uint32_t color) {
+  x += xDatum;
+  y += yDatum;
+  int32_t x0 = std::max(x, clipX0), y0 = std::max(y, clipY0);
+  int32_t x1 = std::min(x + rw, clipX1), y1 = std::min(y + rh, clipY1);
+  if (x0 >= x1)
+    return;
+  for (int32_t yy = y0; yy < y1; yy++)
+    std::fill(&fb[(size_t)yy * w + x0], &fb[(size_t)yy * w + x1],
+              (uint16_t)color);
+}
+
+void TFT_eSprite::drawRect(int32_t x, int32_t y, int32_t rw, int32_t rh,
+                           uint32_t color) {
+  drawFastHLine(x, y, rw, color);
+  drawFastHLine(x, y + rh - 1, rw, color);
+  drawFastVLine(x, y, rh, color);
+  drawFastVLine(x + rw - 1, y, rh, color);
+}
+
+void TFT_eSprite::drawFastHLine(int32_t x, int32_t y, int32_t len,
+                                uint32_t color) {
+  fillRect(x, y, len, 1, color);
+}
+
+void TFT_eSprite::drawFastVLine(int32_t x, int32_t y, int32_t len,
+                                uint32_t color) {
+  fillRect(x, y, 1, len, color);
+}
+
+void TFT_eSprite::drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                           uint32_t color) {
+  int32_t dx = abs(x1 - x0), dy = -abs(y1 - y0);
+  int32_t sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+  int32_t err = dx + dy;
+  while (true) {
+    drawPixel(x0, y0, color);
+    if (x0 == x1 && y0 == y1)
+      break;
+    int32_t e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+void TFT_eSprite::fillCircle(int32_t cx, int32_t cy, int32_t r,
+                             uint32_t color) {
+  for (int32_t dy = -r; dy <= r; dy++) {
+    int32_t half = (int32_t)sqrt((double)(r * r - dy * dy));
+    drawFastHLine(cx - half, cy + dy, 2 * half + 1, color);
+  }
+}
+
+void TFT_eSprite::drawCircle(int32_t cx, int32_t cy, int32_t r,
+                             uint32_t color) {
+  for (int32_t dy = -r; dy <= r; dy++) {
+    int32_t half = (int32_t)sqrt((double)(r * r - dy * dy));
+    drawPixel(cx - half, cy + dy, color);
+    drawPixel(cx + half, cy + dy, color);
+  }
+}
+
+void TFT_eSprite::drawArc(int32_t cx, int32_t cy, int32_t r, int32_t ir,
+                          uint32_t startAngle, uint32_t endAngle,
+                          uint32_t fg, uint32_t, bool) {
+  for (int32_t dy = -r; dy <= r; dy++) {
+    for (int32_t dx = -r; dx <= r; dx++) {
+      int32_t d2 = dx * dx + dy * dy;
+      if (d2 > r * r || d2 < ir * ir)
+        continue;
+      double a = atan2((double)-dx, (double)dy) * 180.0 / M_PI;
+      if (a < 0)
+        a += 360.0;
+      if (a >= startAngle && a <= endAngle)
+        drawPixel(cx + dx, cy + dy, fg);
+    }
+  }
+}
+
+// Approximate cell sizes of the TFT_eSPI fonts
+void TFT_eSprite::charCell(uint8_t f, int16_t *cw, int16_t *ch) {
+  switch (f) {
+  case 2:
+    *cw = 8;
+    *ch = 16;
+    break;
+  case 4:
+    *cw = 14;
+    *ch = 26;
+    break;
+  case 6:
+    *cw = 24;
+    *ch = 48;
+    break;
+  case 7:
+    *cw = 32;
+    *ch = 48;
+    break;
+  case 8:
+    *cw = 55;
+    *ch = 75;
+    break;
+  default:
+    *cw = 6;
+    *ch = 8;
+    break;
+  }
+  *cw *= textSize;
+  *ch *= textSize;
+}
+
+int16_t TFT_eSprite::textWidth(const char *s, uint8_t f) {
+  int16_t cw, ch;
+  charCell(f, &cw, &ch);
+  return (int16_t)(strlen(s) * cw);
+}
+
+int16_t TFT_eSprite::fontHeight(int16_t f) {
+  int16_t cw, ch;
+  charCell((uint8_t)f, &cw, &ch);
+  return ch;
+}
+
+int16_t TFT_eSprite::drawString(const char *s, int32_t x, int32_t y,
+                                uint8_t f) {
+  int16_t cw, ch;
+  charCell(f, &cw, &ch);
+  int32_t tw = (int32_t)strlen(s) * cw;
+
+  // Datum: 0-2 top, 3-5 middle, 6-8 bottom; left, centre, right
+  int32_t col = datum % 3, row = datum / 3;
+  int32_t left = x - (col == 1 ? tw / 2 : col == 2 ? tw : 0);
+  int32_t top = y - (row == 1 ? ch / 2 : row == 2 ? ch : 0);
+
+  for (size_t i = 0; s[i]; i++) {
+    if (s[i] != ' ')
+      fillRect(left + (int32_t)i * cw + 1, top + 1, cw - 2, ch - 2, textFg);
+  }
+  if (left + xDatum < clipX1 && left + tw + xDatum > clipX0 &&
+      top + yDatum < clipY1 && top + ch + yDatum > clipY0) {
+    texts.push_back(s);
+    drawnText = &texts;
+  }
+  return (int16_t)tw;
+}
+
+void TFT_eSprite::pushSprite(int32_t x, int32_t y) {
+  pushSprite(x, y, 0, 0, w, h);
+}
+
+bool TFT_eSprite::pushSprite(int32_t x, int32_t y, int32_t sx, int32_t sy,
+                             int32_t sw, int32_t sh) {
+  if (sx < 0 || sy < 0 || sw <= 0 || sh <= 0 || sx + sw > w || sy + sh > h)
+    return false;
+  dmaWait();
+  uint64_t sent = 0;
+  for (int32_t row = 0; row < sh; row++) {
+    int32_t py = y + row;
+    if (py < 0 || py >= PANEL_H)
+      continue;
+    for (int32_t col = 0; col < sw; col++) {
+      int32_t px = x + col;
+      if (px >= 0 && px < PANEL_W) {
+        panel[(size_t)py * PANEL_W + px] =
+            fb[(size_t)(sy + row) * w + sx + col];
+        sent++;
+      }
+    }
+  }
+  panelText = texts;
+  pushes++;
+  pushedBytes += sent * 2;
+  simSleepUs(transferUs(sent * 2)); // Blocking transfer
+  return true;
+}
+
+// --- Harness side ---
+
+namespace sim {
+
+const uint16_t *screen() { return panel.data(); }
+
+int screenWidth() { return PANEL_W; }
+
+int screenHeight() { return PANEL_H; }
+
+uint32_t screenPushes() { return pushes; }
+
+uint64_t screenBytes() { return pushedBytes; }
+
+const std::vector<std::string> &screenText() { return panelText; }
+
+bool writeScreen(const std::string &ppmPath) {
+  FILE *f = fopen(ppmPath.c_str(), "wb");
+  if (!f)
+    return false;
+  fprintf(f, "P6\n%d %d\n255\n", PANEL_W, PANEL_H);
+  for (uint16_t c : panel) {
+    uint8_t rgb[3] = {(uint8_t)((c >> 8) & 0xF8), (uint8_t)((c >> 3) & 0xFC),
+                      (uint8_t)((c << 3) & 0xF8)};
+    fwrite(rgb, 1, 3, f);
+  }
+  fclose(f);
+  return true;
+}
+
+} // namespace sim
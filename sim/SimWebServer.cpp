@@ -0,0 +1,73 @@
+#include "Sim.h"
+#include "WebServer.h"
+
+namespace {
+
+struct PendingUpload {
+  std::string folder;
+  std::string filename;
+  size_t bytes;
+};
+
+std::vector<PendingUpload> pending;
+bool serving = false;
+
+} // namespace
+
+// Serves one queued upload the way the ESP32 server does: the whole
+// request within this call, the body handed to the upload handler in
+// HTTP_UPLOAD_BUFLEN pieces. The data arrives as fast as the handler
+// takes it, the worst case for the audio task.
+void WebServer::handleClient() {
+  if (!running || pending.empty())
+    return;
+  auto route = routes.find("/upload");
+  if (route == routes.end() || !route->second.upload)
+    return;
+
+  PendingUpload req = pending.front();
+  pending.erase(pending.begin());
+  serving = true;
+  args.clear();
+  args["folder"] = req.folder;
+  args["size"] = std::to_string(req.bytes);
+
+  current.filename = req.filename;
+  current.name = "upload";
+  current.totalSize = 0;
+  current.currentSize = 0;
+  current.status = UPLOAD_FILE_START;
+  route->second.upload();
+
+  size_t sent = 0;
+  while (sent < req.bytes) {
+    size_t n = req.bytes - sent;
+    if (n > HTTP_UPLOAD_BUFLEN)
+      n = HTTP_UPLOAD_BUFLEN;
+    for (size_t i = 0; i < n; i++)
+      current.buf[i] = (uint8_t)(sent + i);
+    current.currentSize = n;
+    current.status = UPLOAD_FILE_WRITE;
+    route->second.upload();
+    sent += n;
+    current.totalSize = sent;
+  }
+  current.currentSize = 0;
+  current.status = UPLOAD_FILE_END;
+  route->second.upload();
+  if (route->second.fn)
+    route->second.fn();
+  args.clear();
+  serving = false;
+}
+
+namespace sim {
+
+void httpUpload(const std::string &folder, const std::string &filename,
+                size_t bytes) {
+  pending.push_back({folder, filename, bytes});
+}
+
+bool httpBusy() { return serving || !pending.empty(); }
+
+} // namespace sim
@@ -0,0 +1,163 @@
+#ifndef SIM_TFT_ESPI_H
+#define SIM_TFT_ESPI_H
+
+// TFT_eSPI for the host simulation: sprites are plain RGB565 framebuffers
+// and the panel is one more (sim::screen()). Text is drawn as one solid
+// cell per character at the real font's approximate size, which is enough
+// to check layout; the strings themselves are kept in sim::screenText().
+
+#include "Arduino.h"
+
+#include <vector>
+
+#define TFT_BLACK 0x0000
+#define TFT_NAVY 0x000F
+#define TFT_DARKGREEN 0x03E0
+#define TFT_DARKCYAN 0x03EF
+#define TFT_MAROON 0x7800
+#define TFT_PURPLE 0x780F
+#define TFT_OLIVE 0x7BE0
+#define TFT_LIGHTGREY 0xD69A
+#define TFT_DARKGREY 0x7BEF
+#define TFT_BLUE 0x001F
+#define TFT_GREEN 0x07E0
+#define TFT_CYAN 0x07FF
+#define TFT_RED 0xF800
+#define TFT_MAGENTA 0xF81F
+#define TFT_YELLOW 0xFFE0
+#define TFT_WHITE 0xFFFF
+#define TFT_ORANGE 0xFDA0
+#define TFT_PINK 0xFE19
+#define TFT_SKYBLUE 0x867D
+#define TFT_SILVER 0xC618
+#define TFT_TRANSPARENT 0x0120
+
+#define TL_DATUM 0
+#define TC_DATUM 1
+#define TR_DATUM 2
+#define ML_DATUM 3
+#define CL_DATUM 3
+#define MC_DATUM 4
+#define CC_DATUM 4
+#define MR_DATUM 5
+#define CR_DATUM 5
+#define BL_DATUM 6
+#define BC_DATUM 7
+#define BR_DATUM 8
+
+class TFT_eSPI {
+public:
+  TFT_eSPI(int16_t w = 240, int16_t h = 240);
+  virtual ~TFT_eSPI() {}
+
+  void init(uint8_t tc = 0);
+  void begin(uint8_t tc = 0) { init(tc); }
+  void setRotation(uint8_t r) {}
+  void fillScreen(uint32_t color);
+  void setSwapBytes(bool swap) {}
+
+  // DMA: the pixels reach the panel at once, but the bus stays busy for
+  // the time they take at SPI_FREQUENCY. A transfer waits for the one
+  // before it, and dmaWait() blocks the calling task until the bus is free.
+  bool initDMA(bool ctrlCs = false) { return true; }
+  void startWrite() {}
+  void endWrite() {}
+  void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h,
+                    uint16_t const *data, uint16_t *buffer = nullptr);
+  bool dmaBusy();
+  void dmaWait();
+
+  virtual int16_t width() const { return w; }
+  virtual int16_t height() const { return h; }
+
+  // As TFT_eSPI blends: alpha 0 (bgc) to 255 (fgc)
+  uint16_t alphaBlend(uint8_t alpha, uint16_t fgc, uint16_t bgc) {
+    uint32_t rxb = bgc & 0xF81F;
+    rxb += ((fgc & 0xF81F) - rxb) * (alpha >> 2) >> 6;
+    uint32_t xgx = bgc & 0x07E0;
+    xgx += ((fgc & 0x07E0) - xgx) * alpha >> 8;
+    return (rxb & 0xF81F) | (xgx & 0x07E0);
+  }
+
+protected:
+  int16_t w, h;
+};
+
+class TFT_eSprite : public TFT_eSPI {
+public:
+  explicit TFT_eSprite(TFT_eSPI *tft);
+
+  void *createSprite(int16_t w, int16_t h, uint8_t frames = 1);
+  void deleteSprite();
+  bool created() const { return !fb.empty(); }
+  void *getPointer() { return fb.data(); }
+  void setColorDepth(int8_t bits) {}
+
+  // As TFT_eSPI: drawing is clipped to the window x,y,w,h (sprite
+  // coordinates) and, with vpDatum, offset by x,y. A window off the sprite
+  // draws nothing.
+  void setViewport(int32_t x, int32_t y, int32_t w, int32_t h,
+                   bool vpDatum = true);
+  void resetViewport();
+
+  void fillSprite(uint32_t color); // The viewport only
+  void drawPixel(int32_t x, int32_t y, uint32_t color);
+  void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+  void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+  void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color);
+  void drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color);
+  void drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                uint32_t color);
+  void fillCircle(int32_t x, int32_t y, int32_t r, uint32_t color);
+  void drawCircle(int32_t x, int32_t y, int32_t r, uint32_t color);
+  // Ring between radii ir and r from startAngle to endAngle (degrees, 0 at
+  // 6 o'clock, clockwise). Not anti-aliased here.
+  void drawArc(int32_t x, int32_t y, int32_t r, int32_t ir,
+               uint32_t startAngle, uint32_t endAngle, uint32_t fg_color,
+               uint32_t bg_color, bool smoothArc = true);
+
+  void setTextColor(uint16_t fg) { textFg = fg; }
+  void setTextColor(uint16_t fg, uint16_t bg, bool fill = false) {
+    textFg = fg;
+  }
+  void setTextDatum(uint8_t d) { datum = d; }
+  void setTextFont(uint8_t f) { font = f; }
+  void setTextSize(uint8_t s) { textSize = s ? s : 1; }
+  int16_t textWidth(const char *s, uint8_t f);
+  int16_t textWidth(const char *s) { return textWidth(s, font); }
+  int16_t fontHeight(int16_t f);
+  int16_t fontHeight() { return fontHeight(font); }
+
+  int16_t drawString(const char *s, int32_t x, int32_t y, uint8_t f);
+  int16_t drawString(const char *s, int32_t x, int32_t y) {
+    return drawString(s, x, y, font);
+  }
+  int16_t drawString(const String &s, int32_t x, int32_t y, uint8_t f) {
+    return drawString(s.c_str(), x, y, f);
+  }
+  int16_t drawString(const String &s, int32_t x, int32_t y) {
+    return drawString(s.c_str(), x, y, font);
+  }
+
+  void pushSprite(int32_t x, int32_t y);
+  // Window sx,sy,sw,sh of the sprite to the panel at x,y
+  bool pushSprite(int32_t x, int32_t y, int32_t sx, int32_t sy, int32_t sw,
+                  int32_t sh);
+
+  int16_t width() const override { return w; }
+  int16_t height() const override { return h; }
+
+private:
+  std::vector<uint16_t> fb;
+  std::vector<std::string> texts; // Drawn at least partly in the viewport
+  int32_t xDatum = 0, yDatum = 0;
+  int32_t clipX0 = 0, clipY0 = 0, clipX1 = 0, clipY1 = 0;
+  uint16_t textFg = TFT_WHITE;
+  uint8_t datum = TL_DATUM;
+  uint8_t font = 1;
+  uint8_t textSize = 1;
+
+  void charCell(uint8_t f, int16_t *cw, int16_t *ch);
+};
+
+#endif
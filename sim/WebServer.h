@@ -0,0 +1,74 @@
+#ifndef SIM_WEB_SERVER_H
+#define SIM_WEB_SERVER_H
+
+// Routes are registered and served from handleClient(), but the only
+// request that ever arrives is an upload queued by sim::httpUpload():
+// there is no network in the sim. Responses go nowhere.
+
+#include "Arduino.h"
+
+#include <functional>
+#include <map>
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST, HTTP_PUT, HTTP_DELETE };
+enum HTTPUploadStatus {
+  UPLOAD_FILE_START,
+  UPLOAD_FILE_WRITE,
+  UPLOAD_FILE_END,
+  UPLOAD_FILE_ABORTED
+};
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define HTTP_UPLOAD_BUFLEN 1436
+
+struct HTTPUpload {
+  HTTPUploadStatus status;
+  String filename;
+  String name;
+  String type;
+  size_t totalSize;
+  size_t currentSize;
+  uint8_t buf[HTTP_UPLOAD_BUFLEN];
+};
+
+class WebServer {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit WebServer(int port = 80) {}
+  void on(const char *uri, HTTPMethod method, THandlerFunction fn) {
+    routes[uri] = {fn, nullptr};
+  }
+  void on(const char *uri, HTTPMethod method, THandlerFunction fn,
+          THandlerFunction upload) {
+    routes[uri] = {fn, upload};
+  }
+  void begin() { running = true; }
+  void stop() { running = false; }
+  void handleClient(); // SimWebServer.cpp
+
+  void setContentLength(size_t len) {}
+  void send(int code, const char *type = NULL, const String &body = String()) {}
+  void sendHeader(const String &name, const String &value,
+                  bool first = false) {}
+  void sendContent(const String &content) {}
+
+  bool hasArg(const String &name) { return args.count(name) > 0; }
+  String arg(const String &name) {
+    auto it = args.find(name);
+    return it == args.end() ? String() : it->second;
+  }
+  HTTPUpload &upload() { return current; }
+
+private:
+  struct Route {
+    THandlerFunction fn;
+    THandlerFunction upload;
+  };
+  std::map<std::string, Route> routes;
+  std::map<std::string, String> args; // Of the request being served
+  bool running = false;
+  HTTPUpload current;
+};
+
+#endif
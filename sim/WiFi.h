@@ -0,0 +1,27 @@
+#ifndef SIM_WIFI_H
+#define SIM_WIFI_H
+
+// Wi-Fi is not simulated: the AP "starts" and nothing ever connects
+
+#include "Arduino.h"
+
+#define WIFI_OFF 0
+#define WIFI_STA 1
+#define WIFI_AP 2
+#define WIFI_AP_STA 3
+
+class IPAddress {
+public:
+  String toString() const { return "192.168.4.1"; }
+};
+
+class WiFiClass {
+public:
+  bool softAP(const char *ssid, const char *pass = NULL) { return true; }
+  IPAddress softAPIP() { return IPAddress(); }
+  bool mode(int m) { return true; }
+};
+
+extern WiFiClass WiFi;
+
+#endif
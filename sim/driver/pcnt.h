@@ -0,0 +1,76 @@
+#ifndef SIM_DRIVER_PCNT_H
+#define SIM_DRIVER_PCNT_H
+
+// Legacy ESP-IDF pulse counter driver for the host simulation. Each unit
+// counts edges of its channels' pulse pins as the IDF 4.x hardware does,
+// steered by the level of each channel's control pin, and wraps to 0 at
+// its limits. Pin edges from sim::setPin() are clean, so the glitch
+// filter is accepted but has nothing to remove.
+
+#include <stdint.h>
+
+#ifndef ESP_OK
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#endif
+
+#define PCNT_PIN_NOT_USED (-1)
+
+typedef enum {
+  PCNT_UNIT_0,
+  PCNT_UNIT_1,
+  PCNT_UNIT_2,
+  PCNT_UNIT_3,
+  PCNT_UNIT_4,
+  PCNT_UNIT_5,
+  PCNT_UNIT_6,
+  PCNT_UNIT_7,
+  PCNT_UNIT_MAX,
+} pcnt_unit_t;
+
+typedef enum {
+  PCNT_CHANNEL_0,
+  PCNT_CHANNEL_1,
+  PCNT_CHANNEL_MAX
+} pcnt_channel_t;
+
+// Edge action
+typedef enum {
+  PCNT_COUNT_DIS,
+  PCNT_COUNT_INC,
+  PCNT_COUNT_DEC,
+} pcnt_count_mode_t;
+
+// What the control pin's level does to the edge action
+typedef enum {
+  PCNT_MODE_KEEP,
+  PCNT_MODE_REVERSE,
+  PCNT_MODE_DISABLE,
+} pcnt_ctrl_mode_t;
+
+typedef struct {
+  int pulse_gpio_num;
+  int ctrl_gpio_num;
+  pcnt_ctrl_mode_t lctrl_mode;
+  pcnt_ctrl_mode_t hctrl_mode;
+  pcnt_count_mode_t pos_mode;
+  pcnt_count_mode_t neg_mode;
+  int16_t counter_h_lim;
+  int16_t counter_l_lim;
+  pcnt_unit_t unit;
+  pcnt_channel_t channel;
+} pcnt_config_t;
+
+esp_err_t pcnt_unit_config(const pcnt_config_t *config);
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t value);
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit);
+esp_err_t pcnt_filter_disable(pcnt_unit_t unit);
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit);
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit);
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit);
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t *count);
+
+#endif
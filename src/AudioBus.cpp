@@ -0,0 +1,116 @@
+#include "AudioBus.h"
+
+AudioBus audioBus;
+
+AudioBus::AudioBus()
+    : bell(NULL), panicPending(false), transportHead(0), transportCount(0),
+      dropped(0), coalesced(0), flushed(0) {
+  mux = portMUX_INITIALIZER_UNLOCKED;
+  for (int i = 0; i < PARAM_SLOTS; i++)
+    paramPending[i] = false;
+}
+
+void AudioBus::begin() { bell = xSemaphoreCreateBinary(); }
+
+int AudioBus::paramSlot(const AudioCommand &cmd) {
+  int layer = cmd.layer >= 0 && cmd.layer < AudioMixer::MAX_LAYERS
+                  ? cmd.layer
+                  : 0;
+  switch (cmd.type) {
+  case CMD_SET_VOLUME:
+    return 0;
+  case CMD_SET_PCM_CACHE:
+    return 1;
+  case CMD_SET_LOOP:
+    return 2;
+  case CMD_PREFETCH:
+    return PREFETCH_SLOT;
+  case CMD_RELEASE_PATH:
+    return 4;
+  case CMD_SET_LAYER_BANK:
+    return LAYER_SLOTS + layer * 3;
+  case CMD_SET_LAYER_GAIN:
+    return LAYER_SLOTS + layer * 3 + 1;
+  case CMD_SET_LAYER_MUTE:
+    return LAYER_SLOTS + layer * 3 + 2;
+  default:
+    return -1;
+  }
+}
+
+void AudioBus::send(const AudioCommand &cmd) {
+  portENTER_CRITICAL(&mux);
+  if (cmd.type == CMD_PANIC) {
+    panicPending = true;
+    panicCmd = cmd;
+    flushed += transportCount;
+    transportCount = 0;
+    if (paramPending[PREFETCH_SLOT]) {
+      flushed++;
+      paramPending[PREFETCH_SLOT] = false;
+    }
+  } else {
+    int slot = paramSlot(cmd);
+    if (slot >= 0) {
+      if (paramPending[slot])
+        coalesced++;
+      params[slot] = cmd;
+      paramPending[slot] = true;
+    } else {
+      if (transportCount == AUDIO_TRANSPORT_QUEUE_LEN) {
+        transportHead = (transportHead + 1) % AUDIO_TRANSPORT_QUEUE_LEN;
+        transportCount--;
+        dropped++;
+      }
+      int at = (transportHead + transportCount) % AUDIO_TRANSPORT_QUEUE_LEN;
+      transport[at] = cmd;
+      transportCount++;
+    }
+  }
+  portEXIT_CRITICAL(&mux);
+  if (bell)
+    xSemaphoreGive(bell); // Already given: the task is due to look anyway
+}
+
+bool AudioBus::receive(AudioCommand *cmd) {
+  bool found = true;
+  portENTER_CRITICAL(&mux);
+  if (panicPending) {
+    *cmd = panicCmd;
+    panicPending = false;
+  } else if (transportCount > 0) {
+    *cmd = transport[transportHead];
+    transportHead = (transportHead + 1) % AUDIO_TRANSPORT_QUEUE_LEN;
+    transportCount--;
+  } else {
+    found = false;
+    for (int i = 0; i < PARAM_SLOTS && !found; i++) {
+      if (paramPending[i]) {
+        *cmd = params[i];
+        paramPending[i] = false;
+        found = true;
+      }
+    }
+  }
+  portEXIT_CRITICAL(&mux);
+  return found;
+}
+
+bool AudioBus::pending() const {
+  portENTER_CRITICAL(&mux);
+  bool any = panicPending || transportCount > 0;
+  for (int i = 0; i < PARAM_SLOTS && !any; i++)
+    any = paramPending[i];
+  portEXIT_CRITICAL(&mux);
+  return any;
+}
+
+void AudioBus::collect(uint32_t *droppedOut, uint32_t *coalescedOut,
+                       uint32_t *flushedOut) {
+  portENTER_CRITICAL(&mux);
+  *droppedOut += dropped;
+  *coalescedOut += coalesced;
+  *flushedOut += flushed;
+  dropped = coalesced = flushed = 0;
+  portEXIT_CRITICAL(&mux);
+}
@@ -0,0 +1,99 @@
+#ifndef AUDIO_BUS_H
+#define AUDIO_BUS_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "AudioMixer.h"
+#include "Config.h"
+#include "PadIndex.h"
+
+// Commands for the audio task
+enum AudioCommandType {
+  CMD_PLAY,
+  CMD_STOP,
+  CMD_CROSSFADE,
+  CMD_SET_VOLUME,
+  CMD_SET_PCM_CACHE, // value: 1 = prefer pre-decoded sidecars
+  CMD_PREFETCH,      // Open and buffer the queued next pad ahead of Play
+  CMD_SET_LOOP,      // value: 1 = pads loop (takes effect on the next Play)
+  CMD_SET_LAYER_BANK, // layer >= 1: bank, PAD_NO_BANK = off
+  CMD_SET_LAYER_GAIN, // layer: value = level 0-100 %
+  CMD_SET_LAYER_MUTE, // layer: value 1 = muted
+  CMD_RELEASE_PATH,   // value 1: let go of a path, 0: done (audioReleasePath)
+  CMD_PANIC           // Volume to 0 and stop, ahead of everything else
+};
+
+// Every field starts defined, so a sender only sets the ones its command
+// uses and the bus can read layer for any of them.
+struct AudioCommand {
+  AudioCommandType type = CMD_STOP;
+  BankHandle bank = PAD_NO_BANK; // Play/Crossfade/Prefetch pad, or layer's bank
+  int8_t key = 0;        // Play/Crossfade/Prefetch: 0-11 from C
+  int8_t layer = 0;      // Layer index for the CMD_SET_LAYER_* commands
+  int32_t value = 0;     // Volume (0-21) or other parameters
+  uint32_t issuedUs = 0; // micros() when sent, for press-to-sound latency
+};
+
+// Commands from the UI to the audio task, in three classes, highest first:
+//
+//   panic      CMD_PANIC; flushes the transport commands still waiting
+//   transport  play, stop, crossfade; in the order sent
+//   parameter  the rest; only the latest of each is kept
+//
+// A parameter is a value, not an event, so a burst of volume turns takes
+// one slot and can never crowd out a Stop. Prefetch is one too: only the
+// pad the scroll stopped on is worth reading ahead, and a panic drops it.
+// So is a release: its one caller waits for it. Transport has a fixed ring;
+// when it is full the oldest command gives way to the newest, which is
+// what the player asked for last. Everything lost or replaced is counted.
+//
+// Any task may send. Only the audio task receives: it sleeps on
+// audioWakeSet, which holds the bus's doorbell, a binary semaphore given
+// on every send.
+class AudioBus {
+public:
+  AudioBus();
+
+  void begin(); // Creates the doorbell: add doorbell() to the wake set
+  SemaphoreHandle_t doorbell() const { return bell; }
+
+  void send(const AudioCommand &cmd);
+
+  // Audio task: the most urgent waiting command. False if none.
+  bool receive(AudioCommand *cmd);
+  bool pending() const; // Anything left to receive
+  int transportDepth() const { return transportCount; }
+
+  // Audio task: add the counts since the last call and zero them
+  void collect(uint32_t *dropped, uint32_t *coalesced, uint32_t *flushed);
+
+private:
+  // Volume, PCM cache, loop, prefetch, release, then bank, gain and mute
+  // of each layer
+  static const int PREFETCH_SLOT = 3;
+  static const int LAYER_SLOTS = 5;
+  static const int PARAM_SLOTS = LAYER_SLOTS + 3 * AudioMixer::MAX_LAYERS;
+  static int paramSlot(const AudioCommand &cmd); // -1 if not a parameter
+
+  mutable portMUX_TYPE mux;
+  SemaphoreHandle_t bell;
+
+  bool panicPending;
+  AudioCommand panicCmd;
+
+  AudioCommand transport[AUDIO_TRANSPORT_QUEUE_LEN]; // Ring
+  int transportHead; // Oldest
+  int transportCount;
+
+  AudioCommand params[PARAM_SLOTS];
+  bool paramPending[PARAM_SLOTS];
+
+  uint32_t dropped;   // Transport commands pushed out of a full ring
+  uint32_t coalesced; // Parameters replaced before the task took them
+  uint32_t flushed;   // Transport commands and prefetch cancelled by a panic
+};
+
+extern AudioBus audioBus;
+
+#endif
@@ -0,0 +1,111 @@
+#include "AudioMetrics.h"
+#include "Config.h"
+
+AudioMetrics audioMetrics;
+
+uint32_t MetricHistogram::percentile(int p) const {
+  if (count == 0)
+    return 0;
+  uint32_t target = (uint32_t)(((uint64_t)count * p + 99) / 100);
+  uint32_t seen = 0;
+  for (int b = 0; b < METRIC_BUCKETS; b++) {
+    seen += buckets[b];
+    if (seen >= target)
+      return b == METRIC_BUCKETS - 1 ? maxValue : (1u << b) - 1;
+  }
+  return maxValue;
+}
+
+void AudioMetrics::clear() {
+  underruns = droppedEvents = dmaErrors = blocks = commands = 0;
+  clippedSamples = meterDrops = 0;
+  busDrops = busCoalesced = busFlushed = panics = 0;
+  memset(&renderUs, 0, sizeof(renderUs));
+  memset(&voiceUs, 0, sizeof(voiceUs));
+  memset(&decodeUs, 0, sizeof(decodeUs));
+  memset(&sdWaitUs, 0, sizeof(sdWaitUs));
+  memset(&sdReadUs, 0, sizeof(sdReadUs));
+  memset(&openUs, 0, sizeof(openUs));
+  memset(&queueDepth, 0, sizeof(queueDepth));
+  memset(&playLatencyUs, 0, sizeof(playLatencyUs));
+  memset(&meterUs, 0, sizeof(meterUs));
+  memset(&panicUs, 0, sizeof(panicUs));
+  resetRequested = false;
+}
+
+void AudioMetrics::begin() { owner = xTaskGetCurrentTaskHandle(); }
+
+void AudioMetrics::service() {
+  if (resetRequested) {
+    TaskHandle_t keep = owner;
+    clear();
+    owner = keep;
+  }
+}
+
+static void appendHistogram(String &out, const char *name,
+                            const MetricHistogram &h) {
+  char line[160];
+  snprintf(line, sizeof(line),
+           "%s count=%lu p50=%lu p90=%lu p99=%lu max=%lu\n", name,
+           (unsigned long)h.count, (unsigned long)h.percentile(50),
+           (unsigned long)h.percentile(90), (unsigned long)h.percentile(99),
+           (unsigned long)h.maxValue);
+  out += line;
+
+  // Raw buckets, named by their upper bound
+  out += name;
+  out += "_buckets";
+  for (int b = 0; b < METRIC_BUCKETS; b++) {
+    snprintf(line, sizeof(line), " %lu", (unsigned long)h.buckets[b]);
+    out += line;
+  }
+  out += "\n";
+}
+
+String AudioMetrics::report() const {
+  String out;
+  out.reserve(2048);
+  char line[96];
+  snprintf(line, sizeof(line),
+           "underruns %lu\ndropped_events %lu\ndma_errors %lu\n",
+           (unsigned long)underruns, (unsigned long)droppedEvents,
+           (unsigned long)dmaErrors);
+  out += line;
+  snprintf(line, sizeof(line),
+           "blocks %lu\ncommands %lu\nclipped_samples %lu\n",
+           (unsigned long)blocks, (unsigned long)commands,
+           (unsigned long)clippedSamples);
+  out += line;
+  appendHistogram(out, "render_us", renderUs);
+  appendHistogram(out, "voice_us", voiceUs);
+
+  // Voices one block period can carry at the p99 per-voice cost: two per
+  // layer are busy during a crossfade
+  uint32_t blockUs = (uint32_t)((uint64_t)AUDIO_BLOCK_FRAMES * 1000000 /
+                                AUDIO_SAMPLE_RATE);
+  uint32_t perVoice = voiceUs.percentile(99);
+  if (perVoice == 0)
+    perVoice = 1; // Below timer resolution
+  snprintf(line, sizeof(line), "voice_capacity %lu\n",
+           (unsigned long)(voiceUs.count ? blockUs / perVoice : 0));
+  out += line;
+  appendHistogram(out, "decode_us", decodeUs);
+  appendHistogram(out, "sd_wait_us", sdWaitUs);
+  appendHistogram(out, "sd_read_us", sdReadUs);
+  appendHistogram(out, "open_us", openUs);
+  appendHistogram(out, "queue_depth", queueDepth);
+  snprintf(line, sizeof(line),
+           "bus_drops %lu\nbus_coalesced %lu\nbus_flushed %lu\n",
+           (unsigned long)busDrops, (unsigned long)busCoalesced,
+           (unsigned long)busFlushed);
+  out += line;
+  appendHistogram(out, "play_latency_us", playLatencyUs);
+  snprintf(line, sizeof(line), "meter_drops %lu\n", (unsigned long)meterDrops);
+  out += line;
+  appendHistogram(out, "meter_us", meterUs);
+  snprintf(line, sizeof(line), "panics %lu\n", (unsigned long)panics);
+  out += line;
+  appendHistogram(out, "panic_us", panicUs);
+  return out;
+}
@@ -0,0 +1,81 @@
+#ifndef AUDIO_METRICS_H
+#define AUDIO_METRICS_H
+
+#include <Arduino.h>
+
+// Fixed log2 buckets: [0], [1], [2-3], [4-7] ... [16384+]
+#define METRIC_BUCKETS 16
+
+// Histogram of microsecond timings (or any small count). Recording is a
+// clz and two increments, so it stays on in release builds.
+struct MetricHistogram {
+  uint32_t buckets[METRIC_BUCKETS];
+  uint32_t count;
+  uint32_t maxValue;
+
+  void record(uint32_t v) {
+    int b = v ? 32 - __builtin_clz(v) : 0;
+    if (b >= METRIC_BUCKETS)
+      b = METRIC_BUCKETS - 1;
+    buckets[b]++;
+    count++;
+    if (v > maxValue)
+      maxValue = v;
+  }
+
+  // Upper bound of the bucket holding the p-th percentile (0-100)
+  uint32_t percentile(int p) const;
+};
+
+// Counters of the audio path. Only the audio task records (single writer,
+// no locks); readers on the other core take a racy but harmless snapshot.
+// Shared code (PadReader, Mp3Source) also runs in the PCM cache builder,
+// so it records only when isAudioTask() is true.
+class AudioMetrics {
+public:
+  AudioMetrics() : owner(NULL) { clear(); }
+
+  void begin(); // Called by the audio task itself
+  bool isAudioTask() const {
+    return owner && xTaskGetCurrentTaskHandle() == owner;
+  }
+
+  // Safe from any task; the audio task clears on its next wake-up
+  void requestReset() { resetRequested = true; }
+  void service();
+
+  String report() const; // Plain text, one metric per line
+
+  uint32_t underruns;     // DMA played a buffer we had not filled
+  uint32_t droppedEvents; // I2S events lost while the task was stalled
+  uint32_t dmaErrors;
+  uint32_t blocks;
+  uint32_t commands;
+  uint32_t clippedSamples; // Saturated at the mixer output
+  uint32_t meterDrops;     // Block levels the display did not take in time
+  uint32_t busDrops;       // Transport commands pushed out of a full ring
+  uint32_t busCoalesced;   // Parameters replaced by a newer value unread
+  uint32_t busFlushed;     // Transport commands cancelled by a panic
+  uint32_t panics;
+
+  MetricHistogram renderUs;      // Mixing one block, decode + SD included
+  MetricHistogram voiceUs;       // renderUs per voice mixed in the block
+  MetricHistogram decodeUs;      // One MP3 frame
+  MetricHistogram sdWaitUs;      // Waiting for the card (sdScheduler)
+  MetricHistogram sdReadUs;      // One file.read()
+  MetricHistogram openUs;        // Opening a pad file -> its first byte read
+  MetricHistogram queueDepth;    // Commands waiting, sampled per command
+  MetricHistogram playLatencyUs; // Command sent -> first sample at the DAC
+  MetricHistogram meterUs;       // Publishing one block's level
+  MetricHistogram panicUs;       // audioPanic() -> DMA ring zeroed
+
+private:
+  TaskHandle_t owner;
+  volatile bool resetRequested;
+
+  void clear();
+};
+
+extern AudioMetrics audioMetrics;
+
+#endif
@@ -0,0 +1,213 @@
+#include "AudioMixer.h"
+#include <math.h>
+#include <string.h>
+
+static const int Q15_SHIFT = 15;
+static const float Q15_ONE = 32768.0f;
+
+static inline int32_t toQ15(float g) { return (int32_t)(g * Q15_ONE + 0.5f); }
+
+AudioMixer::AudioMixer()
+    : clipped(0), levelPeak(0), levelSumSq(0), levelSamples(0) {
+  master.set(1.0f);
+  for (int l = 0; l < MAX_LAYERS; l++)
+    layers[l].set(1.0f);
+  for (int i = 0; i < MAX_VOICES; i++) {
+    voices[i].source = nullptr;
+    voices[i].layer = 0;
+    voices[i].active = false;
+  }
+}
+
+void AudioMixer::release(Voice &v) {
+  if (v.source)
+    v.source->close();
+  v.source = nullptr;
+  v.active = false;
+}
+
+void AudioMixer::play(PcmSource *const sources[MAX_LAYERS],
+                      uint32_t fadeFrames, GainCurve curve) {
+  for (int i = 0; i < MAX_VOICES; i++) {
+    Voice &v = voices[i];
+    if (!v.active)
+      continue;
+    if (fadeFrames == 0)
+      release(v);
+    else
+      v.gain.rampTo(0.0f, fadeFrames, curve);
+  }
+
+  int next = 0;
+  for (int l = 0; l < MAX_LAYERS; l++) {
+    if (!sources[l])
+      continue;
+    while (next < MAX_VOICES && voices[next].active)
+      next++;
+    if (next == MAX_VOICES) {
+      sources[l]->close(); // Caller skipped makeRoom()
+      continue;
+    }
+    Voice &slot = voices[next];
+    slot.source = sources[l];
+    slot.layer = l;
+    slot.active = true;
+    slot.gain.set(0.0f);
+    slot.gain.rampTo(1.0f, fadeFrames, curve);
+  }
+}
+
+void AudioMixer::stop(uint32_t fadeFrames, GainCurve curve) {
+  for (int i = 0; i < MAX_VOICES; i++) {
+    Voice &v = voices[i];
+    if (!v.active)
+      continue;
+    if (fadeFrames == 0)
+      release(v);
+    else
+      v.gain.rampTo(0.0f, fadeFrames, curve);
+  }
+}
+
+void AudioMixer::stopReading(const char *path, uint32_t fadeFrames) {
+  for (int i = 0; i < MAX_VOICES; i++) {
+    Voice &v = voices[i];
+    if (!v.active || !v.source->reads(path))
+      continue;
+    if (fadeFrames == 0)
+      release(v);
+    else
+      v.gain.rampTo(0.0f, fadeFrames, CURVE_LINEAR);
+  }
+}
+
+bool AudioMixer::isReading(const char *path) const {
+  for (int i = 0; i < MAX_VOICES; i++) {
+    if (voices[i].active && voices[i].source->reads(path))
+      return true;
+  }
+  return false;
+}
+
+void AudioMixer::makeRoom(int slots) {
+  // Every slot busy means a new transition during a crossfade: the
+  // outgoing voices are already on their way down, so cutting them is the
+  // least audible.
+  while (MAX_VOICES - activeVoices() < slots) {
+    Voice *quietest = nullptr;
+    for (int i = 0; i < MAX_VOICES; i++) {
+      Voice &v = voices[i];
+      if (v.active && (!quietest || v.gain.gain() < quietest->gain.gain()))
+        quietest = &v;
+    }
+    release(*quietest);
+  }
+}
+
+bool AudioMixer::isIdle() const { return activeVoices() == 0; }
+
+int AudioMixer::activeVoices() const {
+  int n = 0;
+  for (int i = 0; i < MAX_VOICES; i++) {
+    if (voices[i].active)
+      n++;
+  }
+  return n;
+}
+
+size_t AudioMixer::mixVoice(Voice &v, size_t frames) {
+  size_t got = 0;
+  while (got < frames) {
+    size_t n = v.source->read(voiceBuf + got * 2, frames - got);
+    if (n == 0)
+      break;
+    got += n;
+  }
+
+  GainRamp &layer = layers[v.layer];
+  if (!v.gain.isRamping() && !layer.isRamping()) {
+    // Steady state: constant gain for the whole block
+    int32_t g = toQ15(v.gain.gain() * layer.gain());
+    if (g == 0)
+      return got;
+    for (size_t i = 0; i < got * 2; i++)
+      mixBuf[i] += (voiceBuf[i] * g) >> Q15_SHIFT;
+  } else {
+    // The layer ramp is shared by this layer's voices: step a copy
+    GainRamp layerRamp = layer;
+    for (size_t i = 0; i < got; i++) {
+      int32_t g = toQ15(v.gain.next() * layerRamp.next());
+      mixBuf[i * 2] += (voiceBuf[i * 2] * g) >> Q15_SHIFT;
+      mixBuf[i * 2 + 1] += (voiceBuf[i * 2 + 1] * g) >> Q15_SHIFT;
+    }
+  }
+  return got;
+}
+
+void AudioMixer::renderBlock(int16_t *out, size_t frames) {
+  memset(mixBuf, 0, frames * 2 * sizeof(int32_t));
+
+  for (int i = 0; i < MAX_VOICES; i++) {
+    Voice &v = voices[i];
+    if (!v.active)
+      continue;
+    size_t got = mixVoice(v, frames);
+    // End of file, or faded all the way out
+    if (got < frames || (!v.gain.isRamping() && v.gain.position() <= 0.0f))
+      release(v);
+  }
+
+  // Advance the layer ramps once per frame, whoever used them
+  for (int l = 0; l < MAX_LAYERS; l++) {
+    for (size_t i = 0; i < frames && layers[l].isRamping(); i++)
+      layers[l].next();
+  }
+
+  // The bus holds up to MAX_VOICES full-scale voices (18 bits), so the
+  // master multiply goes through 64 bits before saturating to 16.
+  bool ramping = master.isRamping();
+  int32_t g = toQ15(master.position());
+  uint32_t peak = levelPeak;
+  uint64_t sumSq = levelSumSq;
+  for (size_t i = 0; i < frames; i++) {
+    if (ramping)
+      g = toQ15(master.next());
+    for (int ch = 0; ch < 2; ch++) {
+      int32_t s = (int32_t)(((int64_t)mixBuf[i * 2 + ch] * g) >> Q15_SHIFT);
+      if (s > 32767) {
+        s = 32767;
+        clipped++;
+      } else if (s < -32768) {
+        s = -32768;
+        clipped++;
+      }
+      out[i * 2 + ch] = (int16_t)s;
+      uint32_t a = (uint32_t)(s < 0 ? -s : s);
+      if (a > peak)
+        peak = a;
+      sumSq += a * a;
+    }
+  }
+  levelPeak = peak;
+  levelSumSq = sumSq;
+  levelSamples += frames * 2;
+}
+
+void AudioMixer::takeLevels(uint16_t *peak, uint16_t *rms) {
+  *peak = (uint16_t)(levelPeak > 32767 ? 32767 : levelPeak);
+  *rms = levelSamples
+             ? (uint16_t)sqrtf((float)(levelSumSq / levelSamples))
+             : 0;
+  levelPeak = 0;
+  levelSumSq = 0;
+  levelSamples = 0;
+}
+
+void AudioMixer::render(int16_t *out, size_t frames) {
+  while (frames > 0) {
+    size_t n = frames > MAX_BLOCK_FRAMES ? MAX_BLOCK_FRAMES : frames;
+    renderBlock(out, n);
+    out += n * 2;
+    frames -= n;
+  }
+}
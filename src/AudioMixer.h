@@ -0,0 +1,99 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include "GainRamp.h"
+#include "PcmSource.h"
+
+// Sums overlapping voices into one stereo stream.
+// Voices belong to layers (one bank each, played in the same key). Every
+// voice carries its own GainRamp, evaluated per sample on the sample
+// clock, so a crossfade is a true overlap: with CURVE_EQUAL_POWER the
+// outgoing voices follow cos() while the incoming ones follow sin() and
+// the summed power stays constant - no dip to silence between keys. On
+// top of that each layer has a level (with mute as level 0) that glides
+// independently of transitions.
+//
+// The summing kernel is fixed point: Q15 gains, an int32 bus with room
+// for every voice at full scale, one saturation at the output.
+//
+// Plain C++ (no Arduino/FreeRTOS) so it can be compiled and profiled on the
+// host. Not thread-safe: only the audio task may call into it.
+class AudioMixer {
+public:
+  static const int MAX_LAYERS = 2;
+  static const int MAX_VOICES = 2 * MAX_LAYERS; // Incoming + outgoing each
+  static const size_t MAX_BLOCK_FRAMES = 256;
+
+  AudioMixer();
+
+  // Start one source per layer (NULL = layer silent), fading them in over
+  // `fadeFrames` while every playing voice fades out over the same span.
+  // fadeFrames == 0 is an instant switch. Call makeRoom(MAX_LAYERS) first.
+  void play(PcmSource *const sources[MAX_LAYERS], uint32_t fadeFrames,
+            GainCurve curve = CURVE_EQUAL_POWER);
+
+  // Fade every voice to silence, closing their sources when done.
+  void stop(uint32_t fadeFrames, GainCurve curve = CURVE_LOG);
+
+  // Fade out every voice whose source reads `path` (PcmSource::reads),
+  // closing it when done, and whether any still does
+  void stopReading(const char *path, uint32_t fadeFrames);
+  bool isReading(const char *path) const;
+
+  // Free `slots` voice slots for new sources by dropping the quietest
+  // voices. Returns immediately if enough slots are already free.
+  void makeRoom(int slots);
+
+  // Glide the output gain to `gain` (0..1) over `smoothFrames`
+  void setMasterGain(float gain, uint32_t smoothFrames = 0) {
+    master.rampToIn(gain, smoothFrames, CURVE_LINEAR);
+  }
+
+  // Glide one layer's level to `gain` (0..1) over `smoothFrames`
+  void setLayerGain(int layer, float gain, uint32_t smoothFrames = 0) {
+    layers[layer].rampToIn(gain, smoothFrames, CURVE_LINEAR);
+  }
+
+  // Always writes `frames` stereo frames (silence when idle).
+  void render(int16_t *out, size_t frames);
+
+  bool isIdle() const;
+  int activeVoices() const;
+
+  // Output samples clamped since the last call
+  uint32_t takeClipped() {
+    uint32_t n = clipped;
+    clipped = 0;
+    return n;
+  }
+
+  // Peak and RMS (0-32767) of the output since the last call, gathered in
+  // the output loop as it saturates
+  void takeLevels(uint16_t *peak, uint16_t *rms);
+
+private:
+  struct Voice {
+    PcmSource *source;
+    GainRamp gain;
+    int layer;
+    bool active;
+  };
+
+  Voice voices[MAX_VOICES];
+  GainRamp layers[MAX_LAYERS]; // Position is the gain itself (linear)
+  GainRamp master;             // Same
+  uint32_t clipped;
+  uint32_t levelPeak;
+  uint64_t levelSumSq;
+  uint32_t levelSamples;
+
+  // Scratch buffers for one block
+  int16_t voiceBuf[MAX_BLOCK_FRAMES * 2];
+  int32_t mixBuf[MAX_BLOCK_FRAMES * 2];
+
+  void renderBlock(int16_t *out, size_t frames);
+  size_t mixVoice(Voice &v, size_t frames);
+  void release(Voice &v);
+};
+
+#endif
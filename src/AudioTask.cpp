@@ -1,172 +1,742 @@
 #include "AudioTask.h"
-#include "Audio.h"
+#include "AudioMetrics.h"
+#include "AudioMixer.h"
+#include "LevelRing.h"
+#include "LoopSource.h"
+#include "Mp3Source.h"
+#include "PadCache.h"
+#include "PadPaths.h"
+#include "PadReader.h"
+#include "PcmFileSource.h"
+#include "ResampleSource.h"
+#include "SdScheduler.h"
 #include <SD.h>
 #include <SPI.h>
+#include <atomic>
+#include <driver/i2s.h>
+#include <new>
 
-Audio audio;
+#define I2S_PORT I2S_NUM_0
 
-// Queue and Mutex handles
-QueueHandle_t audioQueue;
-SemaphoreHandle_t sdCardMutex;
+// Wake-up handle
+QueueSetHandle_t audioWakeSet;
+static QueueHandle_t i2sEvents; // TX_DONE per DMA buffer played
+LevelRing levelRing;            // Block levels for the display's meter
+
+// Engine: incoming and outgoing voices of every layer summed by the mixer.
+// Each voice slot can be fed by an MP3 decoder or, when cached, by a
+// pre-decoded PCM sidecar. The pools (MAX_VOICES of each kind) and the
+// prefetch come from audioAllocate(). Slot i's MP3 and PCM voices share
+// read-ahead buffer i, so only one of the two is open at a time.
+static AudioMixer mixer;
+static Mp3Source *mp3Voices;
+static PcmFileSource *pcmVoices;
+static LoopSource *loopVoices;     // Wrap either kind
+static ResampleSource *tunedVoices; // Root recordings
+static PadPrefetch *prefetch;
+static uint8_t *readAhead; // MAX_VOICES x SD_TRANSFER_BYTES
+static int16_t outBlock[AUDIO_BLOCK_FRAMES * 2];
+static size_t outPending = 0; // Bytes of outBlock not yet taken by I2S
+static int dmaQueued = 0; // Mixed blocks queued to I2S, less TX_DONEs taken
 
 // State Variables
-AudioState currentState = AUDIO_IDLE;
-int settingsVolume = 21; // The user-defined max volume
-int fadeDurationMs = 1000;
+static int settingsVolume = 21; // The user-defined max volume
+static uint32_t outputRate = AUDIO_SAMPLE_RATE;
+static bool usePcmCache = false;
+static bool loopPads = true;
 
-// Variables for Fading Logic
-unsigned long fadeStartTime = 0;
-char nextFilename[64];
+// Layers: layer 0 plays the pad named by each Play/Crossfade, the others
+// the same key from their own bank folder ("" = layer off). A bank change
+// takes effect on the next Play; level and mute glide right away.
+static BankHandle layerBanks[AudioMixer::MAX_LAYERS];
+static int layerLevels[AudioMixer::MAX_LAYERS]; // 0-100 %
+static bool layerMuted[AudioMixer::MAX_LAYERS];
 
-void audioTask(void *parameter) {
-  // SD Card is already initialized in main.cpp
-  if (SD.cardType() == CARD_NONE) {
-    Serial.println("SD Not Ready!");
-    vTaskDelete(NULL);
+// Root-recording voice each layer is playing now, so a cut to another key
+// can retune it in place instead of opening anything
+static ResampleSource *layerTuned[AudioMixer::MAX_LAYERS];
+static char layerTunedPath[AudioMixer::MAX_LAYERS][64];
+
+// micros() of a pending audioPanic(), 0 = none. Set by any task, taken
+// by the audio task alone.
+static std::atomic<uint32_t> panicIssuedUs(0);
+
+// What the file manager is removing or rewriting (audioReleasePath): the
+// path, its sidecar folder and its sidecar, "" = none. Voices reading any
+// of them fade out, and nothing under them is opened until it is done.
+static char releaseRequest[64]; // Written by the caller before it sends
+static char releasePaths[3][96];
+static bool releaseAckDue = false; // Given once the voices have let go
+static SemaphoreHandle_t releaseAck;
+
+// Press-to-sound latency of the last Play/Crossfade, reported once the
+// first block containing the new voice has been queued to I2S.
+static bool latencyPending = false;
+static const char *latencyKind = "cold"; // How the new sound started
+static uint32_t latencyIssuedUs = 0;
+
+// Same 0-21 loudness steps the old ESP32-audioI2S volume control used,
+// so existing volume settings sound the same.
+static const uint8_t volumeTable[22] = {0,  1,  2,  3,  4,  6,  8,  10,
+                                        12, 14, 17, 20, 23, 27, 30, 34,
+                                        38, 43, 48, 52, 58, 64};
+
+static float volumeToGain(int vol) {
+  if (vol < 0)
+    vol = 0;
+  if (vol > 21)
+    vol = 21;
+  return volumeTable[vol] / 64.0f;
+}
+
+static uint32_t msToFrames(int ms) {
+  if (ms <= 0)
+    return 0;
+  return (uint32_t)((uint64_t)ms * outputRate / 1000);
+}
+
+static bool layerHeard(int layer) {
+  return !layerMuted[layer] && layerLevels[layer] > 0 &&
+         (layer == 0 || layerBanks[layer] != PAD_NO_BANK);
+}
+
+// Layers are uncorrelated, so they add in power: scaling the bus by
+// 1/sqrt(layers heard) keeps the loudness of a single layer and leaves
+// headroom for the peaks of the sum.
+static float layerHeadroom() {
+  int heard = 0;
+  for (int l = 0; l < AudioMixer::MAX_LAYERS; l++) {
+    if (layerHeard(l))
+      heard++;
+  }
+  return heard > 1 ? 1.0f / sqrtf((float)heard) : 1.0f;
+}
+
+static void applyMasterGain(uint32_t smoothFrames) {
+  mixer.setMasterGain(volumeToGain(settingsVolume) * layerHeadroom(),
+                      smoothFrames);
+}
+
+// Glide on the sample clock so knob turns do not zipper
+static uint32_t gainSmoothFrames() {
+  return mixer.isIdle() ? 0 : msToFrames(AUDIO_VOLUME_SMOOTH_MS);
+}
+
+static void applyLayerGain(int layer) {
+  float g = layerMuted[layer] ? 0.0f : layerLevels[layer] / 100.0f;
+  mixer.setLayerGain(layer, g, gainSmoothFrames());
+  applyMasterGain(gainSmoothFrames());
+}
+
+// File and transposition of `cmd`'s pad on `layer`: `*semitones` is set
+// for a root recording and left at NO_TRANSPOSE for a key file. Returns
+// false if the layer is off.
+static const int NO_TRANSPOSE = -100;
+
+static bool layerPad(int layer, const AudioCommand &cmd, PadLocation *pad,
+                     int *semitones) {
+  BankHandle bank = layer == 0 ? cmd.bank : layerBanks[layer];
+  if (bank == PAD_NO_BANK)
+    return false;
+  padIndex.locate(bank, cmd.key, pad);
+  *semitones = pad->rootKey >= 0 ? transposeSemitones(cmd.key, pad->rootKey)
+                                 : NO_TRANSPOSE;
+  return true;
+}
+
+static void initI2S() {
+  i2s_config_t cfg = {};
+  cfg.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX);
+  cfg.sample_rate = AUDIO_SAMPLE_RATE;
+  cfg.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+  cfg.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
+  cfg.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+  cfg.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+  cfg.dma_buf_count = AUDIO_DMA_BUF_COUNT;
+  cfg.dma_buf_len = AUDIO_BLOCK_FRAMES;
+  cfg.use_apll = false;
+  cfg.tx_desc_auto_clear = true; // Output silence on underrun
+  cfg.fixed_mclk = 0;
+
+  i2s_pin_config_t pins = {};
+  pins.mck_io_num = I2S_PIN_NO_CHANGE;
+  pins.bck_io_num = I2S_BCLK;
+  pins.ws_io_num = I2S_LRCK;
+  pins.data_out_num = I2S_DOUT;
+  pins.data_in_num = I2S_PIN_NO_CHANGE;
+
+  i2s_driver_install(I2S_PORT, &cfg, AUDIO_EVENT_QUEUE_LEN, &i2sEvents);
+  i2s_set_pin(I2S_PORT, &pins);
+
+  // The event queue can only join the set while empty, so hold the DMA
+  // until it is in.
+  i2s_stop(I2S_PORT);
+  xQueueAddToSet(i2sEvents, audioWakeSet);
+  i2s_zero_dma_buffer(I2S_PORT);
+  i2s_start(I2S_PORT);
+}
+
+// Silence now rather than after the ring: a fade rendered from here on
+// would only be heard once the AUDIO_DMA_BUF_COUNT blocks queued ahead of
+// it had played, so zero the ring the DMA is reading and the gain first,
+// and only then drop the voices, whose files close under the SD lock. What
+// is left of the buffer playing is cut short. True if a panic was pending.
+static bool hardMute() {
+  uint32_t issued = panicIssuedUs.exchange(0);
+  if (issued == 0)
+    return false;
+  i2s_zero_dma_buffer(I2S_PORT);
+  outPending = 0;
+  settingsVolume = 0;
+  applyMasterGain(0);
+  uint32_t us = micros() - issued;
+  audioMetrics.panics++;
+  audioMetrics.panicUs.record(us);
+
+  latencyPending = false;
+  mixer.stop(0);
+  for (int l = 0; l < AudioMixer::MAX_LAYERS; l++)
+    layerTuned[l] = NULL;
+  return true;
+}
+
+bool audioAllocate() {
+  mp3Voices = new (std::nothrow) Mp3Source[AudioMixer::MAX_VOICES];
+  pcmVoices = new (std::nothrow) PcmFileSource[AudioMixer::MAX_VOICES];
+  loopVoices = new (std::nothrow) LoopSource[AudioMixer::MAX_VOICES];
+  tunedVoices = new (std::nothrow) ResampleSource[AudioMixer::MAX_VOICES];
+  prefetch = new (std::nothrow) PadPrefetch;
+  readAhead = new (std::nothrow)
+      uint8_t[AudioMixer::MAX_VOICES * SD_TRANSFER_BYTES];
+  if (!mp3Voices || !pcmVoices || !loopVoices || !tunedVoices || !prefetch ||
+      !readAhead)
+    return false;
+
+  // The decoders too, so a short heap shows at boot, not on a later Play
+  for (int i = 0; i < AudioMixer::MAX_VOICES; i++) {
+    if (!mp3Voices[i].allocate())
+      return false;
+    mp3Voices[i].setReadAhead(readAhead + i * SD_TRANSFER_BYTES);
+    pcmVoices[i].setReadAhead(readAhead + i * SD_TRANSFER_BYTES);
   }
+  return true;
+}
 
-  // Initialize Audio
-  audio.setPinout(I2S_BCLK, I2S_LRCK, I2S_DOUT);
-  audio.setVolume(settingsVolume);
+void audioPanic() {
+  uint32_t now = micros();
+  panicIssuedUs.store(now ? now : 1);
+  AudioCommand cmd;
+  cmd.type = CMD_PANIC;
+  audioBus.send(cmd); // Rings the doorbell
+}
 
+bool audioReleasePath(const char *path) {
+  if (!releaseAck)
+    return true; // No audio task: nothing is open
+  // Longer than any pad path, and no folder that long can hold a pad
+  if (strlen(path) >= sizeof(releaseRequest))
+    return true;
+  strcpy(releaseRequest, path);
+  xSemaphoreTake(releaseAck, 0); // An answer that came too late last time
   AudioCommand cmd;
+  cmd.type = CMD_RELEASE_PATH;
+  cmd.value = 1;
+  audioBus.send(cmd);
+  return xSemaphoreTake(releaseAck, pdMS_TO_TICKS(AUDIO_RELEASE_TIMEOUT_MS)) ==
+         pdTRUE;
+}
 
-  while (true) {
-    // 1. Always process Audio Events
-    audio.loop();
-
-    // 2. Check Queue for Commands (Non-blocking check)
-    if (xQueueReceive(audioQueue, &cmd, 0) == pdTRUE) {
-      switch (cmd.type) {
-      case CMD_PLAY:
-        if (xSemaphoreTake(sdCardMutex, portMAX_DELAY)) {
-          audio.connecttoFS(SD, cmd.filename);
-          // When starting fresh, jump to volume or fade in?
-          // Simplified: Jump to volume, State PLAYING
-          audio.setVolume(settingsVolume);
-          currentState = AUDIO_PLAYING;
-          xSemaphoreGive(sdCardMutex);
-        }
-        break;
-
-      case CMD_STOP:
-        // Soft Stop: Trigger fade out then stop
-        fadeStartTime = millis();
-        fadeDurationMs = 500; // Fast fade out
-        currentState = AUDIO_STOPPING;
-        break;
-
-      case CMD_SET_VOLUME:
-        settingsVolume = cmd.value;
-        // If we are just playing, update immediately.
-        // If fading, the fade logic will pick it up as target.
-        if (currentState == AUDIO_PLAYING) {
-          audio.setVolume(settingsVolume);
-        }
-        break;
-
-      case CMD_CROSSFADE:
-        if (currentState == AUDIO_PLAYING || currentState == AUDIO_FADING_IN) {
-          // Start Fading OUT
-          strncpy(nextFilename, cmd.filename, sizeof(nextFilename) - 1);
-          nextFilename[sizeof(nextFilename) - 1] = '\0'; // Ensure Null Term
-
-          fadeStartTime = millis();
-          if (cmd.value > 0)
-            fadeDurationMs = cmd.value;
-          currentState = AUDIO_FADING_OUT;
-        } else {
-          // If idle, just play
-          if (xSemaphoreTake(sdCardMutex, portMAX_DELAY)) {
-            audio.connecttoFS(SD, cmd.filename);
-            audio.setVolume(settingsVolume);
-            currentState = AUDIO_PLAYING;
-            xSemaphoreGive(sdCardMutex);
-          }
-        }
-        break;
-      }
+void audioReleaseDone() {
+  AudioCommand cmd;
+  cmd.type = CMD_RELEASE_PATH;
+  cmd.value = 0;
+  audioBus.send(cmd);
+}
+
+static bool underRelease(const char *path) {
+  for (const char *p : releasePaths) {
+    if (p[0] && pathIsUnder(path, p))
+      return true;
+  }
+  return false;
+}
+
+static bool readsReleased(const PcmSource *src) {
+  for (const char *p : releasePaths) {
+    if (p[0] && src->reads(p))
+      return true;
+  }
+  return false;
+}
+
+// Answer audioReleasePath() once no voice reads the path any more
+static void checkRelease() {
+  if (!releaseAckDue)
+    return;
+  for (const char *p : releasePaths) {
+    if (p[0] && mixer.isReading(p))
+      return;
+  }
+  releaseAckDue = false;
+  xSemaphoreGive(releaseAck);
+}
+
+static void startRelease(const char *path) {
+  snprintf(releasePaths[0], sizeof(releasePaths[0]), "%s", path);
+  snprintf(releasePaths[1], sizeof(releasePaths[1]), PAD_CACHE_DIR "%s",
+           path);
+  if (!PadCache::cachePathFor(path, releasePaths[2], sizeof(releasePaths[2])))
+    releasePaths[2][0] = '\0';
+  for (const char *p : releasePaths) {
+    if (!p[0])
+      continue;
+    mixer.stopReading(p, msToFrames(AUDIO_DECLICK_MS));
+    prefetch->drop(p);
+  }
+  for (int l = 0; l < AudioMixer::MAX_LAYERS; l++) {
+    if (layerTuned[l] && readsReleased(layerTuned[l]))
+      layerTuned[l] = NULL; // Fading out: a Play must start fresh
+  }
+  releaseAckDue = true;
+  checkRelease();
+}
+
+// Mixed blocks still ahead of the speaker. TX_DONEs waiting in the queue
+// are for blocks already played: after a stall several can be waiting
+// while the ring is refilled, so they are counted off here too.
+static int blocksAhead() {
+  int ahead = dmaQueued - (int)uxQueueMessagesWaiting(i2sEvents);
+  return ahead > 0 ? ahead : 0;
+}
+
+// Top up the free DMA buffers, one mixed block at a time. Called once per
+// TX_DONE (normally one buffer free, so one block) and right after a start
+// from idle (every buffer free). A block I2S cannot take yet is kept and
+// goes out first on the next call, so nothing rendered is dropped.
+static void feedI2S() {
+  for (int i = 0; i <= AUDIO_DMA_BUF_COUNT; i++) {
+    if (hardMute())
+      return;
+    if (outPending == 0) {
+      int voices = mixer.activeVoices();
+      if (voices == 0)
+        return;
+      uint32_t t0 = micros();
+      mixer.render(outBlock, AUDIO_BLOCK_FRAMES);
+      uint32_t dt = micros() - t0;
+      audioMetrics.renderUs.record(dt);
+      audioMetrics.voiceUs.record(dt / voices);
+      audioMetrics.clippedSamples += mixer.takeClipped();
+      audioMetrics.blocks++;
+
+      // Level meter feed: never waits, drops the reading if the display
+      // has fallen behind
+      uint32_t m0 = micros();
+      LevelReading level;
+      mixer.takeLevels(&level.peak, &level.rms);
+      if (!levelRing.push(level))
+        audioMetrics.meterDrops++;
+      audioMetrics.meterUs.record(micros() - m0);
+      outPending = sizeof(outBlock);
     }
 
-    // 3. State Machine Logic
-    unsigned long now = millis();
-
-    switch (currentState) {
-    case AUDIO_STOPPING: {
-      // ... (No Change needed here usually, but keeping context check)
-      unsigned long elapsed = now - fadeStartTime;
-      if (elapsed >= fadeDurationMs) {
-        audio.setVolume(0);
-        audio.stopSong();
-        currentState = AUDIO_IDLE;
-      } else {
-        float progress = (float)elapsed / fadeDurationMs;
-        int newVol = settingsVolume * (1.0f - progress);
-        if (newVol < 0)
-          newVol = 0;
-        audio.setVolume(newVol);
-      }
-      break;
+    size_t written = 0;
+    i2s_write(I2S_PORT, (uint8_t *)outBlock + sizeof(outBlock) - outPending,
+              outPending, &written, 0);
+    outPending -= written;
+    if (outPending > 0)
+      return; // DMA full
+    if (blocksAhead() < AUDIO_DMA_BUF_COUNT)
+      dmaQueued++;
+
+    if (latencyPending) {
+      // The block just queued is heard once the ones ahead of it played
+      latencyPending = false;
+      int ahead = blocksAhead();
+      uint32_t aheadUs = (uint32_t)((uint64_t)(ahead > 0 ? ahead - 1 : 0) *
+                                    AUDIO_BLOCK_FRAMES * 1000000 / outputRate);
+      uint32_t latency = micros() - latencyIssuedUs + aheadUs;
+      audioMetrics.playLatencyUs.record(latency);
+      Serial.printf("Play latency: %lu us (%s)\n", (unsigned long)latency,
+                    latencyKind);
     }
+  }
+}
 
-    case AUDIO_FADING_OUT: {
-      unsigned long elapsed = now - fadeStartTime;
-      if (elapsed >= fadeDurationMs / 2) {
-
-        // FADE OUT COMPLETE
-        audio.setVolume(0);
-
-        // Load Next Song - CRITICAL MUTEX FIX
-        // Wait Indefinitely (or very long) to ensure we don't drop the
-        // transition
-        if (xSemaphoreTake(sdCardMutex, portMAX_DELAY)) {
-          audio.connecttoFS(SD, nextFilename);
-          xSemaphoreGive(sdCardMutex);
-
-          // Start Fading IN
-          currentState = AUDIO_FADING_IN;
-          fadeStartTime = now;
-        } else {
-          // Should only happen if max delay expires (approx 49 days)
-          // or system failure. Go to Idle.
-          currentState = AUDIO_IDLE;
-        }
-      } else {
-        // ... (Fade logic)
-        float progress = (float)elapsed / (fadeDurationMs / 2.0f);
-        int newVol = settingsVolume * (1.0f - progress);
-        if (newVol < 0)
-          newVol = 0;
-        audio.setVolume(newVol);
-      }
-      break;
+// Tell the card scheduler how much audio the DMA ring holds, so file
+// manager and cache work only takes the card when the ring can wait
+static void publishReserve() {
+  sdScheduler.setAudioQueued(mixer.isIdle() && outPending == 0 ? -1
+                                                                : blocksAhead());
+}
+
+// Free voice slot of each kind. The mixer keeps at most MAX_VOICES -
+// MAX_LAYERS voices after makeRoom(MAX_LAYERS), so every layer finds one.
+// A slot is free when neither of its file voices is open (shared
+// read-ahead).
+static bool slotFree(int i) {
+  return !mp3Voices[i].isOpen() && !pcmVoices[i].isOpen();
+}
+
+static Mp3Source *freeMp3Voice() {
+  for (int i = 0; i < AudioMixer::MAX_VOICES; i++) {
+    if (slotFree(i))
+      return &mp3Voices[i];
+  }
+  return NULL;
+}
+
+static PcmFileSource *freePcmVoice() {
+  for (int i = 0; i < AudioMixer::MAX_VOICES; i++) {
+    if (slotFree(i))
+      return &pcmVoices[i];
+  }
+  return NULL;
+}
+
+static ResampleSource *freeTunedVoice() {
+  for (int i = 0; i < AudioMixer::MAX_VOICES; i++) {
+    if (!tunedVoices[i].isOpen())
+      return &tunedVoices[i];
+  }
+  return NULL;
+}
+
+static LoopSource *freeLoopVoice() {
+  for (int i = 0; i < AudioMixer::MAX_VOICES; i++) {
+    if (!loopVoices[i].isOpen())
+      return &loopVoices[i];
+  }
+  return NULL;
+}
+
+// Loop points of `pad`: from the prefetch if it has the pad, else from
+// its .loop sidecar. Without one the whole file loops.
+static void findLoopPoints(const PadLocation &pad, uint32_t *start,
+                           uint32_t *end) {
+  *start = 0;
+  *end = 0;
+  if (prefetch->matches(pad.path)) {
+    if (prefetch->hasLoop()) {
+      *start = prefetch->loopStart();
+      *end = prefetch->loopEnd();
     }
+    return;
+  }
+  if (pad.hasLoopFile) {
+    sdScheduler.lock();
+    readLoopPoints(pad.path, start, end);
+    sdScheduler.unlock();
+  }
+}
+
+// Open `pad` on a free voice: from the prefetched RAM head if it is the
+// queued pad, else preferring its PCM sidecar when the cache is enabled.
+// WAV pads are PCM already and stream as they are. Returns NULL on failure.
+static PcmSource *openVoice(const PadLocation &pad, bool *prefetched) {
+  const char *path = pad.path;
+  *prefetched = false;
+  if (underRelease(path))
+    return NULL; // The file manager is replacing it
 
-    case AUDIO_FADING_IN: {
-      unsigned long elapsed = now - fadeStartTime;
-      if (elapsed >= fadeDurationMs / 2) {
-        // FADE IN COMPLETE
-        audio.setVolume(settingsVolume);
-        currentState = AUDIO_PLAYING;
-      } else {
-        // Map elapsed [0 to Duration/2] -> [0 to settingsVolume]
-        float progress = (float)elapsed / (fadeDurationMs / 2.0f);
-        int newVol = settingsVolume * progress;
-        if (newVol > settingsVolume)
-          newVol = settingsVolume;
-        audio.setVolume(newVol);
+  if (prefetch->matches(path)) {
+    if (prefetch->isPcm()) {
+      PcmFileSource *src = freePcmVoice();
+      if (src && src->open(*prefetch)) {
+        *prefetched = true;
+        return src;
+      }
+    } else {
+      Mp3Source *src = freeMp3Voice();
+      if (src && src->open(*prefetch)) {
+        *prefetched = true;
+        return src;
       }
-      break;
     }
+  }
+
+  PadLocation checked = pad; // The open may correct it from the file
+  if (pad.format == PAD_WAV) {
+    PcmFileSource *src = freePcmVoice();
+    if (src && src->open(&checked))
+      return src;
+    return NULL;
+  }
+
+  if (usePcmCache) {
+    char cachePath[96];
+    PcmFileSource *src = freePcmVoice();
+    if (src && PadCache::cachePathFor(path, cachePath, sizeof(cachePath))) {
+      sdScheduler.lock();
+      uint32_t mp3Size = PadCache::sourceSize(path);
+      sdScheduler.unlock();
+      if (mp3Size > 0 && src->open(cachePath, mp3Size))
+        return src;
+    }
+    // Not built yet, or built from an older MP3: fall back to decoding
+  }
+
+  Mp3Source *src = freeMp3Voice();
+  if (src && src->open(&checked))
+    return src;
+  return NULL;
+}
+
+// Open `pad` on a free voice, wrapped in a LoopSource when pads loop and
+// in a ResampleSource (returned in `*tuned`) when it is a root recording
+static PcmSource *openPad(const PadLocation &pad, int semitones,
+                          bool *prefetched, ResampleSource **tuned) {
+  *tuned = NULL;
+  uint32_t loopStart = 0, loopEnd = 0;
+  if (loopPads)
+    findLoopPoints(pad, &loopStart, &loopEnd);
+
+  PcmSource *src = openVoice(pad, prefetched);
+  if (!src)
+    return NULL;
+
+  if (loopPads) {
+    LoopSource *loop = freeLoopVoice();
+    if (loop) {
+      loop->begin(src, loopStart, loopEnd);
+      src = loop;
+    }
+  }
+  if (semitones != NO_TRANSPOSE) {
+    *tuned = freeTunedVoice();
+    if (*tuned) {
+      (*tuned)->begin(src, semitones);
+      src = *tuned;
+    }
+  }
+  return src;
+}
+
+// A cut between keys of the same root recordings: glide the pitch of the
+// playing voices instead of starting new ones. Only when every layer is
+// such a voice, since a new voice on one layer would fade the rest out.
+static bool retune(const AudioCommand &cmd) {
+  int semitones[AudioMixer::MAX_LAYERS];
+  for (int l = 0; l < AudioMixer::MAX_LAYERS; l++) {
+    PadLocation pad;
+    bool on = layerPad(l, cmd, &pad, &semitones[l]);
+    bool tuned = layerTuned[l] && layerTuned[l]->isOpen();
+    if (on != tuned)
+      return false;
+    if (on && (semitones[l] == NO_TRANSPOSE ||
+               strcmp(pad.path, layerTunedPath[l]) != 0))
+      return false;
+  }
+  for (int l = 0; l < AudioMixer::MAX_LAYERS; l++) {
+    if (layerTuned[l])
+      layerTuned[l]->setPitch(semitones[l], msToFrames(AUDIO_RETUNE_MS));
+  }
+  return true;
+}
+
+// Start the pad of `cmd` on every layer, all overlapping what plays now
+// for `fadeMs`, so a key change moves the layers in one transition
+static void startVoice(const AudioCommand &cmd, int fadeMs, GainCurve curve) {
+  bool cut = fadeMs <= AUDIO_DECLICK_MS;
+  if (cut && !mixer.isIdle() && retune(cmd)) {
+    latencyPending = true;
+    latencyKind = "retuned";
+    latencyIssuedUs = cmd.issuedUs;
+    return;
+  }
+
+  mixer.makeRoom(AudioMixer::MAX_LAYERS);
+
+  PcmSource *sources[AudioMixer::MAX_LAYERS] = {};
+  PcmSource *first = NULL;
+  bool firstPrefetched = false;
+  for (int l = 0; l < AudioMixer::MAX_LAYERS; l++) {
+    PadLocation pad;
+    int semitones;
+    layerTuned[l] = NULL;
+    if (!layerPad(l, cmd, &pad, &semitones))
+      continue;
+    bool prefetched;
+    sources[l] = openPad(pad, semitones, &prefetched, &layerTuned[l]);
+    if (layerTuned[l])
+      snprintf(layerTunedPath[l], sizeof(layerTunedPath[l]), "%s", pad.path);
+    if (sources[l] && !first) {
+      first = sources[l];
+      firstPrefetched = prefetched;
+    }
+  }
+  if (!first)
+    return;
+
+  latencyPending = true;
+  latencyKind = firstPrefetched ? "prefetched" : "cold";
+  latencyIssuedUs = cmd.issuedUs;
+
+  bool wasIdle = mixer.isIdle();
+  // Nothing audible to mismatch: follow the new file's rate
+  if (wasIdle && first->sampleRate() != outputRate) {
+    outputRate = first->sampleRate();
+    i2s_set_sample_rates(I2S_PORT, outputRate);
+  }
+  for (int l = 0; l < AudioMixer::MAX_LAYERS; l++) {
+    if (sources[l] && sources[l]->sampleRate() != outputRate)
+      Serial.printf("Rate mismatch on layer %d (%u Hz)\n", l + 1,
+                    sources[l]->sampleRate());
+  }
+  mixer.play(sources, wasIdle ? 0 : msToFrames(fadeMs), curve);
+}
+
+static void handleCommand(const AudioCommand &cmd) {
+  switch (cmd.type) {
+  case CMD_PLAY:
+    // Hard cut, with just enough overlap to avoid a click
+    startVoice(cmd, AUDIO_DECLICK_MS, CURVE_LINEAR);
+    break;
+
+  case CMD_STOP:
+    // Soft Stop: fade out (even in dB) then release the voices
+    mixer.stop(msToFrames(AUDIO_STOP_FADE_MS), CURVE_LOG);
+    for (int l = 0; l < AudioMixer::MAX_LAYERS; l++)
+      layerTuned[l] = NULL; // Fading out: a Play must start fresh
+    break;
+
+  case CMD_SET_VOLUME:
+    settingsVolume = cmd.value;
+    applyMasterGain(gainSmoothFrames());
+    break;
+
+  case CMD_CROSSFADE:
+    // Overlapping crossfade; from idle this is a plain start
+    if (cmd.value > 0)
+      startVoice(cmd, cmd.value, CURVE_EQUAL_POWER);
+    else
+      startVoice(cmd, AUDIO_DECLICK_MS, CURVE_LINEAR);
+    break;
 
-    case AUDIO_PLAYING:
-    case AUDIO_IDLE:
-    default:
-      break;
+  case CMD_SET_PCM_CACHE:
+    usePcmCache = cmd.value != 0;
+    break;
+
+  case CMD_PREFETCH: {
+    PadLocation pad;
+    padIndex.locate(cmd.bank, cmd.key, &pad);
+    if (!underRelease(pad.path))
+      prefetch->request(pad, usePcmCache);
+    break;
+  }
+
+  case CMD_SET_LOOP:
+    loopPads = cmd.value != 0;
+    break;
+
+  case CMD_SET_LAYER_BANK:
+    if (cmd.layer > 0 && cmd.layer < AudioMixer::MAX_LAYERS) {
+      layerBanks[cmd.layer] = cmd.bank;
+      applyMasterGain(gainSmoothFrames()); // Headroom follows the layers
     }
+    break;
+
+  case CMD_SET_LAYER_GAIN:
+  case CMD_SET_LAYER_MUTE:
+    if (cmd.layer >= 0 && cmd.layer < AudioMixer::MAX_LAYERS) {
+      if (cmd.type == CMD_SET_LAYER_GAIN)
+        layerLevels[cmd.layer] = constrain(cmd.value, 0, 100);
+      else
+        layerMuted[cmd.layer] = cmd.value != 0;
+      applyLayerGain(cmd.layer);
+    }
+    break;
+
+  case CMD_RELEASE_PATH:
+    if (cmd.value) {
+      startRelease(releaseRequest);
+    } else {
+      for (char *p : releasePaths)
+        p[0] = '\0';
+    }
+    break;
+
+  case CMD_PANIC:
+    settingsVolume = 0;
+    applyMasterGain(gainSmoothFrames());
+    mixer.stop(msToFrames(AUDIO_STOP_FADE_MS), CURVE_LOG);
+    for (int l = 0; l < AudioMixer::MAX_LAYERS; l++)
+      layerTuned[l] = NULL;
+    break;
+  }
+}
+
+void audioTask(void *parameter) {
+  // SD Card is already initialized in main.cpp
+  if (SD.cardType() == CARD_NONE) {
+    Serial.println("SD Not Ready!");
+    vTaskDelete(NULL);
+  }
 
-    // Yield slightly to prevent Watchdog (but keep it small for audio
-    // responsiveness)
-    vTaskDelay(1);
+  audioMetrics.begin();
+  releaseAck = xSemaphoreCreateBinary();
+  sdScheduler.setAudioTask(xTaskGetCurrentTaskHandle());
+  initI2S();
+  for (int l = 0; l < AudioMixer::MAX_LAYERS; l++) {
+    layerBanks[l] = PAD_NO_BANK;
+    layerLevels[l] = 100;
+    layerMuted[l] = false;
+  }
+  applyMasterGain(0);
+
+  AudioCommand cmd;
+  i2s_event_t evt;
+
+  // Sleep until a command arrives or the DMA finishes a buffer. Work per
+  // wake-up is every command waiting on the bus (a transport ring and a
+  // slot per parameter), or one block plus one prefetch chunk.
+  while (true) {
+    QueueSetMemberHandle_t ready =
+        xQueueSelectFromSet(audioWakeSet, portMAX_DELAY);
+    hardMute(); // Whatever woke the task
+
+    if (ready == audioBus.doorbell()) {
+      // A send during the drain below rings again, so the doorbell can be
+      // stale: its commands went with the last drain and there is none
+      xSemaphoreTake(audioBus.doorbell(), 0);
+      bool wasIdle = mixer.isIdle();
+      bool handled = false;
+      while (audioBus.receive(&cmd)) {
+        audioMetrics.commands++;
+        audioMetrics.queueDepth.record(audioBus.transportDepth() + 1);
+        handleCommand(cmd);
+        hardMute(); // A panic sent meanwhile goes ahead of the rest
+        handled = true;
+      }
+      if (!handled)
+        continue;
+      audioBus.collect(&audioMetrics.busDrops, &audioMetrics.busCoalesced,
+                       &audioMetrics.busFlushed);
+      // From idle, fill the DMA now instead of waiting up to a buffer
+      if (wasIdle && !mixer.isIdle())
+        feedI2S();
+      publishReserve();
+    } else if (ready == i2sEvents) {
+      // May be empty if the driver dropped the event (stale set entry)
+      if (xQueueReceive(i2sEvents, &evt, 0) != pdTRUE) {
+        audioMetrics.droppedEvents++;
+        continue;
+      }
+      if (evt.type == I2S_EVENT_TX_DONE) {
+        // A buffer finished: ours, or silence if none was queued
+        if (dmaQueued > 0)
+          dmaQueued--;
+        else if (!mixer.isIdle() || outPending > 0)
+          audioMetrics.underruns++;
+        feedI2S();
+        checkRelease();
+        publishReserve();
+        audioMetrics.service();
+        // Keep reading ahead the queued next pad, one chunk per buffer
+        prefetch->service();
+      } else if (evt.type == I2S_EVENT_DMA_ERROR) {
+        audioMetrics.dmaErrors++;
+      }
+    }
   }
 }
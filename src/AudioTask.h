@@ -6,28 +6,33 @@
 #include <freertos/queue.h>
 #include <freertos/semphr.h>
 
+#include "AudioBus.h"
 #include "Config.h"
 
-// Commands for the Audio Queue
-enum AudioCommandType { CMD_PLAY, CMD_STOP, CMD_CROSSFADE, CMD_SET_VOLUME };
-
-enum AudioState {
-  AUDIO_IDLE,
-  AUDIO_PLAYING,
-  AUDIO_FADING_OUT,
-  AUDIO_FADING_IN,
-  AUDIO_STOPPING
-};
-
-struct AudioCommand {
-  AudioCommandType type;
-  char filename[64]; // Path to file for Play/Crossfade
-  int value;         // Volume (0-21) or other parameters
-};
-
 // Global Handles
-extern QueueHandle_t audioQueue;
-extern SemaphoreHandle_t sdCardMutex;
+// The audio task sleeps on this set: audioBus's doorbell plus the I2S
+// event queue
+extern QueueSetHandle_t audioWakeSet;
+
+// Voice pools with their MP3 decoders and read-ahead, and the prefetch
+// buffer: about 112 KB plus 4 x 24 KB of decoder, from the heap. The
+// static DRAM segment is too small to hold them next to the display and
+// Wi-Fi. Call once before starting the task; false if they do not fit.
+bool audioAllocate();
+
+// Hard mute from any task, ahead of every command: the audio task cuts
+// the voices and zeroes the DMA ring on its next wake-up or before its
+// next block, whichever comes first. Then volume 0 and stop, as
+// CMD_PANIC (which also cancels the transport commands still waiting).
+void audioPanic();
+
+// File manager, before it removes or rewrites `path` (a file or a folder):
+// the audio task fades out the voices and drops the prefetch reading it,
+// its PCM sidecars included, and opens nothing under it until
+// audioReleaseDone(). Waits for that; false if the task did not answer
+// in AUDIO_RELEASE_TIMEOUT_MS. One caller at a time.
+bool audioReleasePath(const char *path);
+void audioReleaseDone();
 
 // Task Entry Point
 void audioTask(void *parameter);
@@ -14,6 +14,22 @@
 #define SD_MOSI 23
 #define SD_MISO 19
 #define SD_SCLK 18
+#define SD_SPI_HZ 20000000 // Card clock; the SD library default is 4 MHz
+#define SD_SECTOR_BYTES 512
+// One SD transfer: voices read ahead and uploads are written in runs of
+// this many bytes, whole 512-byte sectors, so the card sees multi-block
+// commands instead of a command per decoder read
+#define SD_TRANSFER_BYTES 4096
+// While a pad plays, card work other than the audio task's own (file
+// manager, index scan, PCM cache) runs in short slices, each started only
+// with SD_AUDIO_RESERVE_BLOCKS or more blocks queued to I2S, and takes at
+// most SD_BACKGROUND_DUTY_PCT of the card's time
+#define SD_AUDIO_RESERVE_BLOCKS 4
+#define SD_BACKGROUND_DUTY_PCT 50
+// Upload data collected in RAM and written to the card in one slice
+#define SD_UPLOAD_BATCH_BYTES (4 * SD_TRANSFER_BYTES)
+// An upload is grown to its announced size this much per slice
+#define SD_UPLOAD_GROW_BYTES (16 * SD_UPLOAD_BATCH_BYTES)
 
 // Controls
 // WARNING: GPIOs 34, 35, 39 are INPUT-ONLY and have NO internal pull-ups.
@@ -27,6 +43,16 @@
 #define PIN_ENC_A 16
 #define PIN_ENC_B 17
 #define PIN_ENC_BTN 21
+// Both encoders are decoded by the PCNT peripheral, which counts every
+// edge of both phases: a detent is ENC_COUNTS_PER_DETENT counts. Pulses
+// shorter than ENC_FILTER_CYCLES APB cycles (80 MHz) are contact bounce.
+#define ENC_COUNTS_PER_DETENT 4
+#define ENC_FILTER_CYCLES 1023 // 12.8 us, the longest the filter takes
+// Button edges waiting for the UI loop; bounce can queue a dozen per press
+#define INPUT_EDGE_QUEUE_LEN 64
+// Longest the UI loop sleeps waiting for input, so the encoders, serial
+// console and screen are still served at this pace
+#define INPUT_IDLE_MS 10
 
 // Display (HSPI)
 // CAUTION: If your TFT_RST is also on GPIO 4, the screen will flicker.
@@ -41,6 +67,44 @@
 // --- Constants ---
 #define UI_SCREEN_WIDTH 240
 #define UI_SCREEN_HEIGHT 240
+// Frame rate cap: a burst of changes (a fast encoder spin, a bank scan)
+// draws one frame per interval, not one per change
+#define UI_MAX_FPS 30
+#define UI_FRAME_MS (1000 / UI_MAX_FPS)
+// Pixels per display DMA buffer (there are two): 17 panel rows, 8 KB
+#define UI_DMA_BUF_PIXELS 4096
+// Height of the sprite, which holds one band of the screen: the rows of
+// one full-width DMA buffer
+#define UI_BAND_ROWS (UI_DMA_BUF_PIXELS / UI_SCREEN_WIDTH)
+
+// --- Audio Engine ---
+#define AUDIO_SAMPLE_RATE 44100 // Default I2S rate (retuned per file)
+#define AUDIO_BLOCK_FRAMES 256  // Stereo frames mixed per I2S write
+#define AUDIO_DMA_BUF_COUNT 8
+// Play/Stop/Crossfade/Prefetch waiting for the audio task; parameters
+// and panic have slots of their own (AudioBus)
+#define AUDIO_TRANSPORT_QUEUE_LEN 8
+// Longest the card can keep the audio task waiting for it: the SD write
+// busy limit (500 ms on SDXC) of the transfer holding it
+#define AUDIO_MAX_SD_WAIT_MS 500
+// I2S DMA events: one per buffer the DMA can finish in that wait at 48 kHz
+// (MP3's highest rate), so the driver never finds the queue full. On a full
+// queue it drops the oldest event, which leaves a stale entry in the wake
+// set that nothing made room for.
+#define AUDIO_SD_WAIT_BLOCKS (AUDIO_MAX_SD_WAIT_MS * 48 / AUDIO_BLOCK_FRAMES + 1)
+#define AUDIO_EVENT_QUEUE_LEN (AUDIO_DMA_BUF_COUNT + AUDIO_SD_WAIT_BLOCKS)
+// Wake-up set of the audio task: one entry for the command doorbell (a
+// binary semaphore) and one per I2S event queue slot
+#define AUDIO_WAKE_SET_LEN (1 + AUDIO_EVENT_QUEUE_LEN)
+#define AUDIO_DECLICK_MS 10 // Short fade used for hard cuts
+#define AUDIO_RETUNE_MS 20  // Pitch glide when a cut retunes a root recording
+#define AUDIO_STOP_FADE_MS 500
+#define AUDIO_VOLUME_SMOOTH_MS 30 // Glide time for volume knob changes
+// RAM head of the queued next pad: ~90 ms of PCM, ~1 s of 128 kbps MP3
+#define AUDIO_PREFETCH_BYTES (16 * 1024)
+#define AUDIO_PREFETCH_CHUNK 4096 // Bytes read per audio block while filling
+// The file manager's wait for the audio task to close a file it replaces
+#define AUDIO_RELEASE_TIMEOUT_MS 500
 
 // Colors - DEPRECATED (Moved to Dynamic Theme in UI_Logic)
 // Legacy colors removed to prevent usage.
@@ -0,0 +1,178 @@
+#ifndef GAIN_RAMP_H
+#define GAIN_RAMP_H
+
+#include <array>
+#include <stdint.h>
+
+// Fade shapes. The tables below are generated by the compiler, so there is
+// no boot-time setup and they live in flash.
+enum GainCurve {
+  CURVE_LINEAR,      // Gain proportional to position
+  CURVE_EQUAL_POWER, // Quarter sine: constant power across a crossfade
+  CURVE_LOG          // Linear in dB (-60 dB..0 dB), pinned to 0 at the end
+};
+
+namespace gaincurve {
+
+static constexpr int TABLE_SIZE = 256;
+static constexpr double HALF_PI = 1.57079632679489661923;
+static constexpr double LN10 = 2.30258509299404568402;
+static constexpr double FLOOR_DB = -60.0;
+
+// Taylor series, accurate to ~1e-12 on [0, pi/2]
+constexpr double sine(double x) {
+  double term = x, sum = x;
+  for (int n = 1; n < 12; n++) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+// exp() for x <= 0: series on x/32, then squared five times
+constexpr double expNeg(double x) {
+  double y = x / 32.0, term = 1.0, sum = 1.0;
+  for (int n = 1; n < 12; n++) {
+    term *= y / n;
+    sum += term;
+  }
+  for (int i = 0; i < 5; i++)
+    sum *= sum;
+  return sum;
+}
+
+constexpr double shape(GainCurve curve, double pos) {
+  if (curve == CURVE_EQUAL_POWER)
+    return sine(pos * HALF_PI);
+  if (curve == CURVE_LOG) {
+    // 10^(dB/20), rescaled so pos == 0 is true silence
+    double floorGain = expNeg(FLOOR_DB / 20.0 * LN10);
+    double g = expNeg((1.0 - pos) * FLOOR_DB / 20.0 * LN10);
+    return (g - floorGain) / (1.0 - floorGain);
+  }
+  return pos;
+}
+
+constexpr std::array<float, TABLE_SIZE + 1> makeTable(GainCurve curve) {
+  std::array<float, TABLE_SIZE + 1> t{};
+  for (int i = 0; i <= TABLE_SIZE; i++)
+    t[i] = (float)shape(curve, (double)i / TABLE_SIZE);
+  return t;
+}
+
+static constexpr std::array<float, TABLE_SIZE + 1> tables[3] = {
+    makeTable(CURVE_LINEAR), makeTable(CURVE_EQUAL_POWER),
+    makeTable(CURVE_LOG)};
+
+// Table lookup with linear interpolation between entries
+inline float lookup(GainCurve curve, float pos) {
+  if (pos <= 0.0f)
+    return 0.0f;
+  if (pos >= 1.0f)
+    return 1.0f;
+  const std::array<float, TABLE_SIZE + 1> &t = tables[curve];
+  float x = pos * TABLE_SIZE;
+  int idx = (int)x;
+  float frac = x - idx;
+  return t[idx] + frac * (t[idx + 1] - t[idx]);
+}
+
+// Position at which `curve` reaches `gain` (binary search on the table)
+inline float inverse(GainCurve curve, float gain) {
+  if (gain <= 0.0f)
+    return 0.0f;
+  if (gain >= 1.0f)
+    return 1.0f;
+  const std::array<float, TABLE_SIZE + 1> &t = tables[curve];
+  int lo = 0, hi = TABLE_SIZE;
+  while (hi - lo > 1) {
+    int mid = (lo + hi) / 2;
+    if (t[mid] < gain)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  float span = t[hi] - t[lo];
+  float frac = span > 0.0f ? (gain - t[lo]) / span : 0.0f;
+  return (lo + frac) / TABLE_SIZE;
+}
+
+} // namespace gaincurve
+
+// A gain that moves along a curve on the sample clock.
+// The position (0..1) advances by a fixed step per frame and lands exactly
+// on the target after the requested number of frames, independent of how
+// the output is split into blocks.
+class GainRamp {
+public:
+  GainRamp() : curve(CURVE_LINEAR), pos(0.0f), step(0.0f), target(0.0f),
+               remaining(0) {}
+
+  // Jump straight to `position` and stop any ramp
+  void set(float position) {
+    pos = target = position;
+    step = 0.0f;
+    remaining = 0;
+  }
+
+  // Move to `position` along `shape`. A full 0..1 sweep takes `frames`;
+  // partial sweeps keep the same slope, so interrupting a fade never
+  // speeds it up.
+  void rampTo(float position, uint32_t frames, GainCurve shape) {
+    changeCurve(shape);
+    target = position;
+    float dist = position > pos ? position - pos : pos - position;
+    remaining = (uint32_t)(dist * frames + 0.5f);
+    if (remaining == 0) {
+      set(position);
+      return;
+    }
+    step = (position - pos) / remaining;
+  }
+
+  // Ramp that takes exactly `frames`, whatever the distance
+  void rampToIn(float position, uint32_t frames, GainCurve shape) {
+    changeCurve(shape);
+    target = position;
+    remaining = frames;
+    if (remaining == 0) {
+      set(position);
+      return;
+    }
+    step = (position - pos) / remaining;
+  }
+
+  bool isRamping() const { return remaining > 0; }
+  float position() const { return pos; }
+  float gain() const { return gaincurve::lookup(curve, pos); }
+
+  // Gain for the current frame, then advance one frame
+  float next() {
+    float g = gaincurve::lookup(curve, pos);
+    if (remaining > 0) {
+      if (--remaining == 0)
+        pos = target;
+      else
+        pos += step;
+    }
+    return g;
+  }
+
+private:
+  // Switching shape mid-fade keeps the current gain, not the position,
+  // so e.g. a stop that interrupts a crossfade cannot step the level.
+  void changeCurve(GainCurve shape) {
+    if (shape == curve)
+      return;
+    pos = gaincurve::inverse(shape, gain());
+    curve = shape;
+  }
+
+  GainCurve curve;
+  float pos;
+  float step;
+  float target;
+  uint32_t remaining;
+};
+
+#endif
@@ -1,5 +1,17 @@
 #include "InputManager.h"
 
+// The counter runs between -PCNT_LIMIT and PCNT_LIMIT and wraps to 0 at
+// either one; reads are far more often than that many counts
+static const int16_t PCNT_LIMIT = 32000;
+
+static QueueHandle_t edgeQueue;
+static volatile bool edgesLost = false; // Queue was full: resync from pins
+
+// Whether `at` has come, on a wrapping millisecond clock
+static bool reached(uint32_t now, uint32_t at) {
+  return (int32_t)(now - at) >= 0;
+}
+
 void InputManager::init() {
   // Nav Encoder
   pinMode(PIN_ENC_A, INPUT_PULLUP);
@@ -15,113 +27,199 @@ void InputManager::init() {
   pinMode(PIN_PREV, INPUT_PULLUP);
   pinMode(PIN_PLAY, INPUT_PULLUP);
   pinMode(PIN_NEXT, INPUT_PULLUP);
-}
 
-void InputManager::update() {
-  unsigned long now = millis();
+  setupEncoder(volEnc, PIN_VOL_ENC_A, PIN_VOL_ENC_B);
+  setupEncoder(navEnc, PIN_ENC_A, PIN_ENC_B);
 
-  // 1. Volume Encoder
-  int currentVolClk = digitalRead(PIN_VOL_ENC_A);
-  if (currentVolClk != lastVolClk && currentVolClk == LOW) {
-    int dt = digitalRead(PIN_VOL_ENC_B);
-    volDelta += (dt != currentVolClk) ? 1 : -1;
+  const uint8_t pins[BTN_COUNT] = {PIN_VOL_ENC_BTN, PIN_ENC_BTN, PIN_NEXT,
+                                   PIN_PREV, PIN_PLAY};
+  edgeQueue = xQueueCreate(INPUT_EDGE_QUEUE_LEN, sizeof(Edge));
+  for (int i = 0; i < BTN_COUNT; i++) {
+    buttons[i] = {};
+    buttons[i].pin = pins[i];
+    // The interrupt learns the button and its pin from the argument
+    uintptr_t tag = (uintptr_t)(i << 8 | pins[i]);
+    attachInterruptArg(pins[i], onEdge, (void *)tag, CHANGE);
   }
-  lastVolClk = currentVolClk;
+}
 
-  // 2. Nav Encoder
-  int currentNavClk = digitalRead(PIN_ENC_A);
-  if (currentNavClk != lastNavClk && currentNavClk == LOW) {
-    int dt = digitalRead(PIN_ENC_B);
-    navDelta += (dt != currentNavClk) ? 1 : -1;
-  }
-  lastNavClk = currentNavClk;
+// Full quadrature: each channel counts both edges of one phase, with the
+// other phase as its direction. Clockwise (A falls while B is high) counts
+// up on all four edges of a detent.
+void InputManager::setupEncoder(Encoder &enc, int pinA, int pinB) {
+  pcnt_config_t cfg = {};
+  cfg.unit = enc.unit;
+  cfg.counter_h_lim = PCNT_LIMIT;
+  cfg.counter_l_lim = -PCNT_LIMIT;
 
-  // 3. Volume Button (Back)
-  static int lastVolBtnState = HIGH;
-  int volBtnState = digitalRead(PIN_VOL_ENC_BTN);
-  if (lastVolBtnState == HIGH && volBtnState == LOW) {
-    if (now - lastVolBtnTime > DEBOUNCE_MS) {
-      volBtnPressed = true;
-      lastVolBtnTime = now;
-    }
-  }
-  lastVolBtnState = volBtnState;
+  cfg.channel = PCNT_CHANNEL_0;
+  cfg.pulse_gpio_num = pinA;
+  cfg.ctrl_gpio_num = pinB;
+  cfg.pos_mode = PCNT_COUNT_DEC;
+  cfg.neg_mode = PCNT_COUNT_INC;
+  cfg.lctrl_mode = PCNT_MODE_REVERSE;
+  cfg.hctrl_mode = PCNT_MODE_KEEP;
+  pcnt_unit_config(&cfg);
 
-  // 4. Nav Button (Select)
-  static int lastNavBtnState = HIGH;
-  int navBtnState = digitalRead(PIN_ENC_BTN);
-  if (lastNavBtnState == HIGH && navBtnState == LOW) {
-    if (now - lastNavBtnTime > DEBOUNCE_MS) {
-      navBtnPressed = true;
-      lastNavBtnTime = now;
-    }
+  cfg.channel = PCNT_CHANNEL_1;
+  cfg.pulse_gpio_num = pinB;
+  cfg.ctrl_gpio_num = pinA;
+  cfg.pos_mode = PCNT_COUNT_INC;
+  cfg.neg_mode = PCNT_COUNT_DEC;
+  pcnt_unit_config(&cfg);
+
+  pcnt_set_filter_value(enc.unit, ENC_FILTER_CYCLES);
+  pcnt_filter_enable(enc.unit);
+  pcnt_counter_pause(enc.unit);
+  pcnt_counter_clear(enc.unit);
+  pcnt_counter_resume(enc.unit);
+  enc.lastCount = 0;
+  enc.counts = 0;
+}
+
+int InputManager::readEncoder(Encoder &enc) {
+  int16_t now = 0;
+  pcnt_get_counter_value(enc.unit, &now);
+  int delta = now - enc.lastCount;
+  if (delta > PCNT_LIMIT / 2) // Wrapped at a limit
+    delta -= PCNT_LIMIT;
+  else if (delta < -PCNT_LIMIT / 2)
+    delta += PCNT_LIMIT;
+  enc.lastCount = now;
+
+  enc.counts += delta;
+  int detents = enc.counts / ENC_COUNTS_PER_DETENT;
+  enc.counts -= detents * ENC_COUNTS_PER_DETENT;
+  return detents;
+}
+
+// INTERRUPT: stamp the edge and queue it, nothing more
+void IRAM_ATTR InputManager::onEdge(void *arg) {
+  uintptr_t tag = (uintptr_t)arg;
+  Edge e;
+  e.button = (uint8_t)(tag >> 8);
+  e.down = digitalRead((uint8_t)(tag & 0xff)) == LOW;
+  e.ms = millis();
+  BaseType_t woken = pdFALSE;
+  if (xQueueSendFromISR(edgeQueue, &e, &woken) != pdTRUE)
+    edgesLost = true;
+  if (woken)
+    portYIELD_FROM_ISR();
+}
+
+void InputManager::update(uint32_t waitMs) {
+  uint32_t wait = min(waitMs, msToNextDeadline(millis()));
+
+  Edge e;
+  if (xQueueReceive(edgeQueue, &e, pdMS_TO_TICKS(wait)) == pdTRUE) {
+    handleEdge(e);
+    while (xQueueReceive(edgeQueue, &e, 0) == pdTRUE)
+      handleEdge(e);
   }
-  lastNavBtnState = navBtnState;
-
-  // 5. NEXT Button (Hold & Press)
-  if (digitalRead(PIN_NEXT) == LOW) {
-    if (btnNextHoldTime == 0) {
-      btnNextHoldTime = now;
-    } else {
-      // Holding
-      if (now - btnNextHoldTime > HOLD_DELAY_MS) {
-        // Repeat Logic
-        if (now - lastRepeatTime > REPEAT_RATE_MS) {
-          nextPressed = true;    // Trigger Event repeatedly
-          nextHeldRepeat = true; // Internal flag if needed
-          lastRepeatTime = now;
-        }
-      }
-    }
-  } else {
-    if (btnNextHoldTime > 0) {
-      // Released
-      if (now - btnNextHoldTime < HOLD_DELAY_MS) {
-        nextPressed = true; // Short Press
-      }
-      btnNextHoldTime = 0;
-      nextHeldRepeat = false;
-    }
+  if (edgesLost) {
+    edgesLost = false;
+    resync(millis());
   }
+  advance(millis());
+
+  // Encoders: whatever the PCNT counted since the last pass
+  volDelta += readEncoder(volEnc);
+  navDelta += readEncoder(navEnc);
+}
+
+void InputManager::handleEdge(const Edge &e) {
+  advance(e.ms); // Holds and repeats due before this edge come first
+  Button &b = buttons[e.button];
+  b.raw = e.down;
+  if (b.raw != b.down && reached(e.ms, b.settleMs))
+    setDown((ButtonId)e.button, b.raw, e.ms);
+}
 
-  // 6. PREV Button
-  if (digitalRead(PIN_PREV) == LOW) {
-    if (btnPrevHoldTime == 0) {
-      btnPrevHoldTime = now;
-    } else {
-      if (now - btnPrevHoldTime > HOLD_DELAY_MS) {
-        if (now - lastRepeatTime > REPEAT_RATE_MS) {
-          prevPressed = true;
-          prevHeldRepeat = true;
-          lastRepeatTime = now;
-        }
+void InputManager::advance(uint32_t now) {
+  for (int i = 0; i < BTN_COUNT; i++) {
+    Button &b = buttons[i];
+    // Bounce that ended the other way round
+    if (b.raw != b.down && reached(now, b.settleMs))
+      setDown((ButtonId)i, b.raw, b.settleMs);
+    if (!b.down)
+      continue;
+
+    if (i == BTN_PLAY) {
+      if (!b.held && reached(now, b.downMs + PANIC_DELAY_MS))
+        b.held = true;
+    } else if (i == BTN_NEXT || i == BTN_PREV) {
+      if (!b.held && reached(now, b.downMs + HOLD_DELAY_MS)) {
+        b.held = true;
+        b.nextRepeatMs = b.downMs + HOLD_DELAY_MS;
       }
-    }
-  } else {
-    if (btnPrevHoldTime > 0) {
-      if (now - btnPrevHoldTime < HOLD_DELAY_MS) {
-        prevPressed = true;
+      // Repeats due by now, as one press: the loop was busy for them
+      if (b.held && reached(now, b.nextRepeatMs)) {
+        if (i == BTN_NEXT)
+          nextPressed = nextRepeat = true;
+        else
+          prevPressed = prevRepeat = true;
+        while (reached(now, b.nextRepeatMs))
+          b.nextRepeatMs += REPEAT_RATE_MS;
       }
-      btnPrevHoldTime = 0;
-      prevHeldRepeat = false;
     }
   }
+}
 
-  // 7. PLAY Button (Panic)
-  if (digitalRead(PIN_PLAY) == LOW) {
-    if (btnPlayHoldTime == 0) {
-      btnPlayHoldTime = now;
-    } else {
-      if (now - btnPlayHoldTime > PANIC_DELAY_MS) {
-        playHeldState = true;
-      }
-    }
-  } else {
-    if (btnPlayHoldTime > 0 && !playHeldState) {
+void InputManager::setDown(ButtonId id, bool down, uint32_t ms) {
+  Button &b = buttons[id];
+  b.down = down;
+  b.settleMs = ms + DEBOUNCE_MS;
+  if (down) {
+    b.downMs = ms;
+    b.held = false;
+    if (id == BTN_VOL)
+      volBtnPressed = true;
+    else if (id == BTN_NAV)
+      navBtnPressed = true;
+    return;
+  }
+
+  // Released: a tap, unless it was held
+  if (!b.held) {
+    if (id == BTN_NEXT) {
+      nextPressed = true;
+      nextRepeat = false;
+    } else if (id == BTN_PREV) {
+      prevPressed = true;
+      prevRepeat = false;
+    } else if (id == BTN_PLAY) {
       playPressed = true;
     }
-    btnPlayHoldTime = 0;
-    playHeldState = false;
+  }
+  b.held = false;
+}
+
+uint32_t InputManager::msToNextDeadline(uint32_t now) const {
+  uint32_t next = UINT32_MAX;
+  auto consider = [&](uint32_t at) {
+    uint32_t in = reached(now, at) ? 0 : at - now;
+    next = min(next, in);
+  };
+  for (int i = 0; i < BTN_COUNT; i++) {
+    const Button &b = buttons[i];
+    if (b.raw != b.down)
+      consider(b.settleMs);
+    if (!b.down)
+      continue;
+    if (i == BTN_PLAY && !b.held)
+      consider(b.downMs + PANIC_DELAY_MS);
+    else if (i == BTN_NEXT || i == BTN_PREV)
+      consider(b.held ? b.nextRepeatMs : b.downMs + HOLD_DELAY_MS);
+  }
+  return next;
+}
+
+void InputManager::resync(uint32_t now) {
+  for (int i = 0; i < BTN_COUNT; i++) {
+    Button &b = buttons[i];
+    b.raw = digitalRead(b.pin) == LOW;
+    if (b.raw != b.down && reached(now, b.settleMs))
+      setDown((ButtonId)i, b.raw, now);
   }
 }
 
@@ -167,8 +265,13 @@ bool InputManager::wasPlayPressed() {
   return b;
 }
 
-bool InputManager::isPlayHeld() { return playHeldState; }
+bool InputManager::isPlayHeld() { return buttons[BTN_PLAY].held; }
 
-bool InputManager::isNextHeld() { return nextHeldRepeat; }
+bool InputManager::isNextHeld() { return nextRepeat; }
 
-bool InputManager::isPrevHeld() { return prevHeldRepeat; }
+bool InputManager::isPrevHeld() { return prevRepeat; }
+
+bool InputManager::hasPendingInput() {
+  return volDelta != 0 || navDelta != 0 || volBtnPressed || navBtnPressed ||
+         nextPressed || prevPressed || playPressed;
+}
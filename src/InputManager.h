@@ -3,47 +3,86 @@
 
 #include "Config.h"
 #include <Arduino.h>
+#include <driver/pcnt.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 
+// Footswitches and encoder buttons raise a GPIO interrupt on every edge,
+// which queues the new level with the time it happened. update() sleeps
+// on that queue and runs debounce, hold and repeat from the edge times,
+// so a press counts from when the foot went down, not from when loop()
+// got round to looking. The encoders are counted in hardware (PCNT, one
+// unit each), so no detent is missed however long a loop() pass takes.
 class InputManager {
 public:
   void init();
-  void update();
 
-  // Encoders
-  int getVolumeDelta(); // Returns +1, -1, or 0
-  int getNavDelta();    // Returns +1, -1, or 0
+  // Wait up to `waitMs` for an edge or the next hold/repeat moment, then
+  // take in everything that happened since the last call
+  void update(uint32_t waitMs);
+
+  // Encoders: detents turned since the last call, + clockwise
+  int getVolumeDelta();
+  int getNavDelta();
 
   // Buttons (Events)
   bool wasVolBtnPressed(); // Click event
   bool wasNavBtnPressed(); // Click event
 
-  bool wasNextPressed();
+  bool wasNextPressed(); // Also once per repeat while held
   bool wasPrevPressed();
   bool wasPlayPressed();
 
   // Buttons (State)
   bool isPlayHeld(); // For Panic
-  bool isNextHeld(); // For Fast Scroll
-  bool isPrevHeld(); // For Fast Scroll
+  bool isNextHeld(); // The last press was a repeat: fast scroll
+  bool isPrevHeld();
+
+  // Any event buffered, without consuming it
+  bool hasPendingInput();
 
 private:
-  // Internal State
-  int lastVolClk = HIGH;
-  int lastNavClk = HIGH;
+  // One PCNT unit per encoder
+  struct Encoder {
+    pcnt_unit_t unit;
+    int16_t lastCount; // Counter as last read
+    int counts;        // Read but short of a whole detent
+  };
+  Encoder volEnc = {PCNT_UNIT_0, 0, 0};
+  Encoder navEnc = {PCNT_UNIT_1, 0, 0};
+
+  static void setupEncoder(Encoder &enc, int pinA, int pinB);
+  static int readEncoder(Encoder &enc); // Whole detents since last read
+
+  enum ButtonId { BTN_VOL, BTN_NAV, BTN_NEXT, BTN_PREV, BTN_PLAY, BTN_COUNT };
 
-  // Debounce & Hold Timers
-  unsigned long lastVolBtnTime = 0;
-  unsigned long lastNavBtnTime = 0;
+  // An edge as the interrupt saw it
+  struct Edge {
+    uint8_t button;
+    uint8_t down; // Level after the edge is LOW
+    uint32_t ms;
+  };
 
-  unsigned long btnNextHoldTime = 0;
-  unsigned long btnPrevHoldTime = 0;
-  unsigned long btnPlayHoldTime = 0;
-  unsigned long lastRepeatTime = 0;
+  // Debounced state of one button. The first edge after a quiet spell
+  // counts at once; edges for DEBOUNCE_MS after it are bounce, and if
+  // they leave the button the other way, that counts when it ends.
+  struct Button {
+    uint8_t pin;
+    bool down;          // Debounced
+    bool raw;           // Level of the latest edge
+    uint32_t settleMs;  // End of the bounce window
+    uint32_t downMs;    // When it went down
+    uint32_t nextRepeatMs;
+    bool held; // Past the hold (or panic) delay
+  };
+  Button buttons[BTN_COUNT];
 
-  // State Flags for Hold
-  bool playHeldState = false;
-  bool nextHeldRepeat = false;
-  bool prevHeldRepeat = false;
+  static void IRAM_ATTR onEdge(void *arg);
+  void handleEdge(const Edge &e);
+  void advance(uint32_t now); // Bounce windows, holds and repeats up to now
+  void setDown(ButtonId id, bool down, uint32_t ms);
+  uint32_t msToNextDeadline(uint32_t now) const;
+  void resync(uint32_t now); // After lost edges: take the pins as they are
 
   // Buffered Events (cleared after read)
   int volDelta = 0;
@@ -53,12 +92,14 @@ private:
   bool nextPressed = false;
   bool prevPressed = false;
   bool playPressed = false;
+  bool nextRepeat = false; // What the last next/prev press was
+  bool prevRepeat = false;
 
   // Constants
-  const int DEBOUNCE_MS = 50;
-  const int HOLD_DELAY_MS = 400;
-  const int REPEAT_RATE_MS = 100;
-  const int PANIC_DELAY_MS = 1000;
+  static const uint32_t DEBOUNCE_MS = 50;
+  static const uint32_t HOLD_DELAY_MS = 400;
+  static const uint32_t REPEAT_RATE_MS = 100;
+  static const uint32_t PANIC_DELAY_MS = 1000;
 };
 
 #endif
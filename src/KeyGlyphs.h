@@ -0,0 +1,203 @@
+#ifndef KEY_GLYPHS_H
+#define KEY_GLYPHS_H
+
+#include <array>
+#include <stdint.h>
+
+// Anti-aliased glyphs for the big key name on the performance screen, in
+// place of font 4 blown up 3x. Each glyph is a few pen strokes (lines and
+// elliptical arcs) that the compiler rasterizes into 4-bit coverage, like
+// the gain curves: the atlas is in flash and costs nothing at boot. The
+// colour is applied as it is drawn, so one atlas serves both themes.
+namespace keyglyphs {
+
+// About the ink of font 4 at size 3: capitals 59 pixels tall
+static constexpr int CELL_W = 48; // Pixels; each glyph has its own width
+static constexpr int CELL_H = 62;
+static constexpr double SCALE = 0.5; // Pixels per design unit
+static constexpr double PEN = 9.0;   // Stroke width of the letters, pixels
+static constexpr double MARGIN = PEN / 2 + 1;
+static constexpr double PI = 3.14159265358979323846;
+
+// sin() for any x: reduced to [-pi/2, pi/2], then a Taylor series
+constexpr double sine(double x) {
+  while (x > PI)
+    x -= 2 * PI;
+  while (x < -PI)
+    x += 2 * PI;
+  if (x > PI / 2)
+    x = PI - x;
+  else if (x < -PI / 2)
+    x = -PI - x;
+  double term = x, sum = x;
+  for (int n = 1; n < 12; n++) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double cosine(double x) { return sine(x + PI / 2); }
+
+constexpr double root(double x) {
+  double r = x > 1 ? x : 1;
+  for (int i = 0; i < 24; i++)
+    r = (r + x / r) / 2;
+  return r;
+}
+
+// Design units: cap height 100, y down from the top of the capitals. An
+// arc runs from angle t0 to t1 (degrees, counter-clockwise from 3 o'clock)
+// around (x0, y0) with radii x1, y1.
+struct Stroke {
+  bool arc;
+  double x0, y0, x1, y1;
+  double t0, t1;
+};
+
+constexpr Stroke line(double x0, double y0, double x1, double y1) {
+  return {false, x0, y0, x1, y1, 0, 0};
+}
+
+constexpr Stroke arc(double cx, double cy, double rx, double ry, double t0,
+                     double t1) {
+  return {true, cx, cy, rx, ry, t0, t1};
+}
+
+static constexpr int MAX_STROKES = 6;
+
+struct Design {
+  char name;
+  double width; // Design units
+  double pen;   // Pixels
+  int strokeCount;
+  Stroke strokes[MAX_STROKES];
+};
+
+static constexpr Design DESIGNS[] = {
+    {'A', 60, PEN, 3, {line(0, 100, 30, 0), line(30, 0, 60, 100),
+                  line(12, 64, 48, 64)}},
+    {'B', 58, PEN, 6, {line(0, 0, 0, 100), line(0, 0, 30, 0),
+                  arc(30, 24, 24, 24, 90, -90), line(0, 48, 32, 48),
+                  arc(32, 74, 26, 26, 90, -90), line(32, 100, 0, 100)}},
+    {'C', 64, PEN, 1, {arc(34, 50, 34, 50, 42, 318)}},
+    {'D', 60, PEN, 4, {line(0, 0, 0, 100), line(0, 0, 22, 0),
+                  arc(22, 50, 38, 50, 90, -90), line(22, 100, 0, 100)}},
+    {'E', 52, PEN, 4, {line(0, 0, 0, 100), line(0, 0, 52, 0),
+                  line(0, 48, 42, 48), line(0, 100, 52, 100)}},
+    {'F', 52, PEN, 3, {line(0, 0, 0, 100), line(0, 0, 52, 0),
+                  line(0, 48, 42, 48)}},
+    {'G', 66, PEN, 3, {arc(34, 50, 34, 50, 42, 330), line(63, 75, 64, 54),
+                  line(40, 54, 64, 54)}},
+    // Raised to the top of the capitals, with a lighter pen
+    {'#', 46, 6, 4, {line(17, 0, 12, 62), line(38, 0, 33, 62),
+                     line(0, 20, 46, 20), line(0, 43, 46, 43)}},
+};
+
+static constexpr int GLYPH_COUNT = sizeof(DESIGNS) / sizeof(DESIGNS[0]);
+
+struct Glyph {
+  char name;
+  uint8_t width; // Pixels used of CELL_W
+  std::array<uint8_t, CELL_W * CELL_H / 2> alpha; // 4 bits, left pixel high
+};
+
+constexpr double px(double units) { return MARGIN + units * SCALE; }
+
+// Distance squared from (x, y) to the segment (ax, ay)-(bx, by)
+constexpr double distance2(double x, double y, double ax, double ay,
+                           double bx, double by) {
+  double dx = bx - ax, dy = by - ay;
+  double len2 = dx * dx + dy * dy;
+  double t = len2 > 0 ? ((x - ax) * dx + (y - ay) * dy) / len2 : 0;
+  t = t < 0 ? 0 : (t > 1 ? 1 : t);
+  double ex = ax + t * dx - x, ey = ay + t * dy - y;
+  return ex * ex + ey * ey;
+}
+
+// Each pixel's coverage is how far the pen reaches past its center, over
+// one pixel: exact for straight edges, and no supersampling to pay for
+constexpr Glyph makeGlyph(const Design &d) {
+  // Strokes as segments in pixels; arcs in steps of at most 12 degrees
+  double seg[48][4] = {};
+  int n = 0;
+  for (int s = 0; s < d.strokeCount; s++) {
+    const Stroke &k = d.strokes[s];
+    if (!k.arc) {
+      seg[n][0] = px(k.x0);
+      seg[n][1] = px(k.y0);
+      seg[n][2] = px(k.x1);
+      seg[n][3] = px(k.y1);
+      n++;
+      continue;
+    }
+    double sweep = k.t1 - k.t0;
+    int steps = (int)((sweep < 0 ? -sweep : sweep) / 12) + 1;
+    for (int i = 0; i < steps; i++) {
+      double a0 = (k.t0 + sweep * i / steps) * PI / 180;
+      double a1 = (k.t0 + sweep * (i + 1) / steps) * PI / 180;
+      seg[n][0] = px(k.x0 + k.x1 * cosine(a0));
+      seg[n][1] = px(k.y0 - k.y1 * sine(a0));
+      seg[n][2] = px(k.x0 + k.x1 * cosine(a1));
+      seg[n][3] = px(k.y0 - k.y1 * sine(a1));
+      n++;
+    }
+  }
+
+  Glyph g{};
+  g.name = d.name;
+  g.width = (uint8_t)(px(d.width) + MARGIN + 0.5);
+  double reach = d.pen / 2 + 0.5;
+  for (int y = 0; y < CELL_H; y++) {
+    for (int x = 0; x < g.width; x++) {
+      double cx = x + 0.5, cy = y + 0.5;
+      double best = reach * reach;
+      for (int i = 0; i < n; i++) {
+        // Out of reach of the whole segment: skip the exact distance
+        if ((cx < seg[i][0] - reach && cx < seg[i][2] - reach) ||
+            (cx > seg[i][0] + reach && cx > seg[i][2] + reach) ||
+            (cy < seg[i][1] - reach && cy < seg[i][3] - reach) ||
+            (cy > seg[i][1] + reach && cy > seg[i][3] + reach))
+          continue;
+        double d2 = distance2(cx, cy, seg[i][0], seg[i][1], seg[i][2],
+                              seg[i][3]);
+        if (d2 < best)
+          best = d2;
+      }
+      if (best >= reach * reach)
+        continue;
+      double cover = reach - root(best);
+      int a = (int)((cover > 1 ? 1 : cover) * 15 + 0.5);
+      int at = (y * CELL_W + x) / 2;
+      g.alpha[at] |= (uint8_t)(x % 2 ? a : a << 4);
+    }
+  }
+  return g;
+}
+
+constexpr std::array<Glyph, GLYPH_COUNT> makeAtlas() {
+  std::array<Glyph, GLYPH_COUNT> atlas{};
+  for (int i = 0; i < GLYPH_COUNT; i++)
+    atlas[i] = makeGlyph(DESIGNS[i]);
+  return atlas;
+}
+
+static constexpr std::array<Glyph, GLYPH_COUNT> atlas = makeAtlas();
+
+inline const Glyph *find(char name) {
+  for (const Glyph &g : atlas) {
+    if (g.name == name)
+      return &g;
+  }
+  return nullptr;
+}
+
+// Coverage 0-15 of pixel (x, y)
+inline uint8_t alphaAt(const Glyph &g, int x, int y) {
+  uint8_t b = g.alpha[(y * CELL_W + x) / 2];
+  return x % 2 ? b & 0x0f : b >> 4;
+}
+
+} // namespace keyglyphs
+
+#endif
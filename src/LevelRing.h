@@ -0,0 +1,54 @@
+#ifndef LEVEL_RING_H
+#define LEVEL_RING_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Output level of one mixed block, 0-32767
+struct LevelReading {
+  uint16_t peak;
+  uint16_t rms;
+};
+
+// Block levels from the audio task to the display's level meter. One
+// producer and one consumer, each owning one index, so neither side ever
+// waits: no queue, no mutex, nothing that could block the audio task. A
+// full ring drops the new reading instead (the meter only needs the
+// latest few).
+//
+// Plain C++, like AudioMixer.
+class LevelRing {
+public:
+  static const uint32_t SIZE = 64; // Blocks, ~370 ms at 44.1 kHz
+
+  LevelRing() : head(0), tail(0) {}
+
+  // Audio task only. False if the reading was dropped.
+  bool push(const LevelReading &r) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= SIZE)
+      return false;
+    slots[h % SIZE] = r;
+    head.store(h + 1, std::memory_order_release); // Publishes the slot
+    return true;
+  }
+
+  // Display only. False when empty.
+  bool pop(LevelReading *r) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+      return false;
+    *r = slots[t % SIZE];
+    tail.store(t + 1, std::memory_order_release); // Frees the slot
+    return true;
+  }
+
+private:
+  LevelReading slots[SIZE];
+  std::atomic<uint32_t> head; // Written by push() only
+  std::atomic<uint32_t> tail; // Written by pop() only
+};
+
+extern LevelRing levelRing;
+
+#endif
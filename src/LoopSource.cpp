@@ -0,0 +1,170 @@
+#include "LoopSource.h"
+#include "GainRamp.h"
+#include <string.h>
+
+void LoopSource::begin(PcmSource *source, uint32_t start, uint32_t end) {
+  inner = source;
+  loopStart = start;
+  loopEnd = end;
+  headFrames = 0;
+  marked = false;
+  ringStart = 0;
+  ringCount = 0;
+  innerPos = 0;
+  innerDone = false;
+  headPos = 0;
+  // A loop must hold the head plus the wrap crossfade
+  looping = (end == 0) || (end >= start + HEAD_FRAMES + XFADE_FRAMES);
+}
+
+void LoopSource::close() {
+  if (inner)
+    inner->close();
+  inner = nullptr;
+}
+
+bool LoopSource::canWrap() const {
+  return looping && marked && loopEnd >= loopStart + HEAD_FRAMES + XFADE_FRAMES;
+}
+
+// Read from the inner source, never past loopEnd and stopping exactly at
+// the mark point, capturing the loop head on the way.
+size_t LoopSource::pull(int16_t *dst, size_t frames) {
+  const uint32_t markPos = loopStart + HEAD_FRAMES;
+  uint32_t limit = frames;
+  if (looping && loopEnd != 0 && innerPos + limit > loopEnd)
+    limit = loopEnd - innerPos;
+  if (looping && !marked && innerPos < markPos && innerPos + limit > markPos)
+    limit = markPos - innerPos;
+
+  size_t n = 0;
+  while (n < limit) {
+    size_t got = inner->read(dst + n * 2, limit - n);
+    if (got == 0)
+      break;
+    n += got;
+  }
+
+  if (looping && !marked) {
+    uint32_t from = innerPos > loopStart ? innerPos : loopStart;
+    uint32_t to = innerPos + n < markPos ? innerPos + n : markPos;
+    if (to > from) {
+      memcpy(head + (from - loopStart) * 2, dst + (from - innerPos) * 2,
+             (to - from) * 2 * sizeof(int16_t));
+    }
+  }
+  innerPos += n;
+
+  if (looping && !marked && innerPos == markPos) {
+    marked = inner->mark();
+    headFrames = HEAD_FRAMES;
+    if (!marked)
+      looping = false; // Source cannot seek: play through once
+  }
+
+  if (n < limit || (loopEnd != 0 && innerPos >= loopEnd)) {
+    innerDone = true;
+    if (looping) {
+      if (loopEnd == 0)
+        loopEnd = innerPos; // End of file is the loop end
+      if (!canWrap())
+        looping = false;
+    }
+  }
+  return n;
+}
+
+void LoopSource::fillRing() {
+  while (!innerDone && ringCount < RING_FRAMES) {
+    uint32_t writeIdx = (ringStart + ringCount) % RING_FRAMES;
+    uint32_t space = RING_FRAMES - ringCount;
+    if (space > RING_FRAMES - writeIdx)
+      space = RING_FRAMES - writeIdx;
+    size_t n = pull(ring + writeIdx * 2, space);
+    ringCount += n;
+    if (n == 0)
+      break;
+  }
+}
+
+void LoopSource::wrap() {
+  if (!inner->rewind()) {
+    looping = false;
+    return;
+  }
+  innerPos = loopStart + HEAD_FRAMES;
+  innerDone = false;
+  headPos = XFADE_FRAMES; // The crossfade already used the first part
+}
+
+size_t LoopSource::read(int16_t *out, size_t frames) {
+  if (!inner)
+    return 0;
+
+  size_t done = 0;
+  while (done < frames) {
+    // Just wrapped: the rest of the head comes from RAM
+    if (headPos > 0) {
+      uint32_t n = headFrames - headPos;
+      if (n > frames - done)
+        n = frames - done;
+      memcpy(out + done * 2, head + headPos * 2, n * 2 * sizeof(int16_t));
+      headPos += n;
+      done += n;
+      if (headPos >= headFrames)
+        headPos = 0;
+      continue;
+    }
+
+    fillRing();
+    if (ringCount == 0)
+      break;
+
+    uint32_t n;
+    if (looping && innerDone && ringCount <= XFADE_FRAMES) {
+      // Crossfade the tail into the loop head. The index into the fade
+      // follows from how much tail is left, so it survives any block size.
+      n = ringCount;
+      if (n > frames - done)
+        n = frames - done;
+      if (n > RING_FRAMES - ringStart)
+        n = RING_FRAMES - ringStart;
+      for (uint32_t j = 0; j < n; j++) {
+        uint32_t i = XFADE_FRAMES - ringCount + j;
+        float t = (i + 0.5f) / XFADE_FRAMES;
+        float gIn = gaincurve::lookup(CURVE_EQUAL_POWER, t);
+        float gOut = gaincurve::lookup(CURVE_EQUAL_POWER, 1.0f - t);
+        for (int ch = 0; ch < 2; ch++) {
+          float s = ring[(ringStart + j) * 2 + ch] * gOut + head[i * 2 + ch] * gIn;
+          if (s > 32767.0f)
+            s = 32767.0f;
+          else if (s < -32768.0f)
+            s = -32768.0f;
+          out[(done + j) * 2 + ch] = (int16_t)s;
+        }
+      }
+      ringStart = (ringStart + n) % RING_FRAMES;
+      ringCount -= n;
+      done += n;
+      if (ringCount == 0)
+        wrap();
+      continue;
+    }
+
+    // Plain playback, keeping the crossfade span in the ring while a wrap
+    // is still possible
+    uint32_t keep = looping ? XFADE_FRAMES : 0;
+    if (ringCount <= keep)
+      break; // Cannot happen unless the inner source stalls
+    n = ringCount - keep;
+    if (n > frames - done)
+      n = frames - done;
+    if (n > RING_FRAMES - ringStart)
+      n = RING_FRAMES - ringStart;
+    memcpy(out + done * 2, ring + ringStart * 2, n * 2 * sizeof(int16_t));
+    ringStart = (ringStart + n) % RING_FRAMES;
+    ringCount -= n;
+    done += n;
+  }
+  return done;
+}
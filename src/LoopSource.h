@@ -0,0 +1,68 @@
+#ifndef LOOP_SOURCE_H
+#define LOOP_SOURCE_H
+
+#include "PcmSource.h"
+
+// Loops the region [loopStart, loopEnd) of another source without a gap.
+//
+// On the first pass the first HEAD_FRAMES frames after loopStart are kept
+// in RAM and the inner source marks its position right after them. The
+// last XFADE_FRAMES before the loop end are crossfaded (equal power) into
+// that head; while the rest of the head plays from RAM the inner source
+// rewinds to its mark, so the wrap itself never waits on the SD card or a
+// decoder restart. loopEnd == 0 means "end of file": a short lookahead
+// ring lets the crossfade start before the end is actually reached.
+//
+// Plain C++, like AudioMixer.
+class LoopSource : public PcmSource {
+public:
+  // The crossfade plus one 256-frame audio block to play while the inner
+  // source rewinds
+  static const uint32_t HEAD_FRAMES = 1280;
+  static const uint32_t XFADE_FRAMES = 1024;
+
+  LoopSource() : inner(nullptr) {}
+
+  void begin(PcmSource *source, uint32_t loopStart, uint32_t loopEnd);
+
+  size_t read(int16_t *out, size_t frames) override;
+  uint32_t sampleRate() const override {
+    return inner ? inner->sampleRate() : 0;
+  }
+  bool isOpen() const override { return inner && inner->isOpen(); }
+  void close() override;
+  bool reads(const char *path) const override {
+    return inner && inner->reads(path);
+  }
+
+private:
+  static const uint32_t CHUNK_FRAMES = 256;
+  static const uint32_t RING_FRAMES = XFADE_FRAMES + CHUNK_FRAMES;
+
+  PcmSource *inner;
+  uint32_t loopStart;
+  uint32_t loopEnd; // 0 until known (end of file)
+
+  // Loop head, captured on the first pass
+  int16_t head[HEAD_FRAMES * 2];
+  uint32_t headFrames;
+  bool marked;
+
+  // Lookahead of inner frames not yet output
+  int16_t ring[RING_FRAMES * 2];
+  uint32_t ringStart;
+  uint32_t ringCount;
+
+  uint32_t innerPos; // Timeline position of the next inner frame
+  bool innerDone;    // Inner hit EOF or loopEnd
+  bool looping;      // False once the loop turned out to be unusable
+
+  uint32_t headPos; // Next head frame to play after a wrap (0 = none)
+
+  void fillRing();
+  size_t pull(int16_t *dst, size_t frames);
+  bool canWrap() const;
+  void wrap();
+};
+
+#endif
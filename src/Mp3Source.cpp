@@ -0,0 +1,234 @@
+#include "Mp3Source.h"
+#include "AudioMetrics.h"
+
+Mp3Source::Mp3Source()
+    : decoder(nullptr), opened(false), fileEnded(true),
+      rate(AUDIO_SAMPLE_RATE), inPtr(inBuf), inLen(0), pcmFrames(0),
+      pcmPos(0), marked(false), markPcmPos(0) {
+  memset(frameOffsets, 0, sizeof(frameOffsets));
+}
+
+Mp3Source::~Mp3Source() {
+  close();
+  if (decoder)
+    MP3FreeDecoder(decoder);
+}
+
+bool Mp3Source::allocate() {
+  if (!decoder)
+    decoder = MP3InitDecoder();
+  if (!decoder)
+    Serial.println("MP3 decoder alloc failed");
+  return decoder != nullptr;
+}
+
+bool Mp3Source::open(const char *path) {
+  close();
+  if (!reader.open(path)) {
+    Serial.printf("Cannot open %s\n", path);
+    return false;
+  }
+
+  uint8_t hdr[10];
+  uint32_t skip = 0;
+  if (reader.read(hdr, sizeof(hdr)) == sizeof(hdr))
+    skip = id3TagSize(hdr);
+  reader.seek(skip);
+  return start();
+}
+
+bool Mp3Source::open(PadLocation *pad) {
+  close();
+  if (!reader.openPad(pad)) {
+    Serial.printf("Cannot open %s\n", pad->path);
+    return false;
+  }
+  return start();
+}
+
+bool Mp3Source::open(PadPrefetch &prefetch) {
+  close();
+  if (!reader.openPrefetched(prefetch))
+    return false;
+  return start();
+}
+
+bool Mp3Source::start() {
+  if (!decoder) { // allocate() was not called or failed
+    reader.close();
+    return false;
+  }
+
+  opened = true;
+  fileEnded = false;
+  inPtr = inBuf;
+  inLen = 0;
+  pcmFrames = 0;
+  pcmPos = 0;
+  marked = false;
+  memset(frameOffsets, 0, sizeof(frameOffsets));
+
+  // Decode the first frame now so the sample rate is known before the
+  // voice is handed to the mixer.
+  if (!decodeFrame()) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void Mp3Source::close() {
+  reader.close();
+  opened = false;
+  fileEnded = true;
+}
+
+uint32_t Mp3Source::id3TagSize(const uint8_t *hdr) {
+  if (hdr[0] != 'I' || hdr[1] != 'D' || hdr[2] != '3')
+    return 0;
+  // Syncsafe size, excludes the 10-byte header (and optional footer)
+  uint32_t size = ((uint32_t)(hdr[6] & 0x7F) << 21) |
+                  ((uint32_t)(hdr[7] & 0x7F) << 14) |
+                  ((uint32_t)(hdr[8] & 0x7F) << 7) | (hdr[9] & 0x7F);
+  size += 10;
+  if (hdr[5] & 0x10)
+    size += 10;
+  return size;
+}
+
+void Mp3Source::refill() {
+  if (fileEnded)
+    return;
+
+  if (inLen > 0 && inPtr != inBuf)
+    memmove(inBuf, inPtr, inLen);
+  inPtr = inBuf;
+
+  size_t space = IN_BUF_SIZE - inLen;
+  if (space == 0)
+    return;
+
+  size_t got = reader.read(inBuf + inLen, space);
+  if (got == 0)
+    fileEnded = true;
+  inLen += got;
+}
+
+bool Mp3Source::decodeFrame() {
+  // Bounded so a corrupt file cannot stall the audio task
+  for (int attempts = 0; attempts < 64; attempts++) {
+    if (inLen < (int)(IN_BUF_SIZE / 2))
+      refill();
+    if (inLen <= 0)
+      return false;
+
+    int offset = MP3FindSyncWord(inPtr, inLen);
+    if (offset < 0) {
+      inLen = 0; // No sync in the buffer: discard it all
+      continue;
+    }
+    inPtr += offset;
+    inLen -= offset;
+
+    uint32_t at = reader.tell() - inLen;
+    uint32_t t0 = micros();
+    int err = MP3Decode(decoder, &inPtr, &inLen, pcm, 0);
+    if (audioMetrics.isAudioTask())
+      audioMetrics.decodeUs.record(micros() - t0);
+    if (err == ERR_MP3_INDATA_UNDERFLOW) {
+      if (fileEnded)
+        return false;
+      refill();
+      continue;
+    }
+    if (err == ERR_MP3_MAINDATA_UNDERFLOW) {
+      continue; // Bit reservoir still filling, next frame will decode
+    }
+    if (err != ERR_MP3_NONE) {
+      // Skip past the bad sync byte and search again
+      inPtr++;
+      inLen--;
+      continue;
+    }
+
+    MP3FrameInfo info;
+    MP3GetLastFrameInfo(decoder, &info);
+    rate = info.samprate;
+    memmove(frameOffsets + 1, frameOffsets,
+            (HISTORY - 1) * sizeof(frameOffsets[0]));
+    frameOffsets[0] = at;
+
+    if (info.nChans == 1) {
+      // Expand mono to stereo in place, back to front
+      for (int i = info.outputSamps - 1; i >= 0; i--) {
+        pcm[i * 2] = pcm[i];
+        pcm[i * 2 + 1] = pcm[i];
+      }
+      pcmFrames = info.outputSamps;
+    } else {
+      pcmFrames = info.outputSamps / 2;
+    }
+    pcmPos = 0;
+    return true;
+  }
+  return false;
+}
+
+bool Mp3Source::mark() {
+  if (!opened || pcmFrames == 0)
+    return false;
+  memcpy(markOffsets, frameOffsets, sizeof(markOffsets));
+  markPcmPos = pcmPos;
+  marked = true;
+  return true;
+}
+
+bool Mp3Source::rewind() {
+  if (!opened || !marked)
+    return false;
+
+  // Restart a couple of frames early; their output is discarded
+  uint32_t from = markOffsets[0];
+  for (int i = 1; i < HISTORY; i++) {
+    if (markOffsets[i] < from && markOffsets[i] != 0)
+      from = markOffsets[i];
+  }
+  if (!reader.seek(from))
+    return false;
+
+  fileEnded = false;
+  inPtr = inBuf;
+  inLen = 0;
+  memset(frameOffsets, 0, sizeof(frameOffsets));
+  do {
+    if (!decodeFrame()) {
+      close();
+      return false;
+    }
+  } while (frameOffsets[0] < markOffsets[0]);
+
+  if (frameOffsets[0] != markOffsets[0])
+    return false; // Lost sync; the frame boundaries no longer line up
+  pcmPos = markPcmPos;
+  return true;
+}
+
+size_t Mp3Source::read(int16_t *out, size_t frames) {
+  if (!opened)
+    return 0;
+
+  size_t written = 0;
+  while (written < frames) {
+    if (pcmPos >= pcmFrames) {
+      if (!decodeFrame())
+        break;
+    }
+    size_t n = pcmFrames - pcmPos;
+    if (n > frames - written)
+      n = frames - written;
+    memcpy(out + written * 2, pcm + pcmPos * 2, n * 2 * sizeof(int16_t));
+    pcmPos += n;
+    written += n;
+  }
+  return written;
+}
@@ -0,0 +1,71 @@
+#ifndef MP3_SOURCE_H
+#define MP3_SOURCE_H
+
+#include "PadReader.h"
+#include "PcmSource.h"
+#include <Arduino.h>
+
+#include "libhelix-mp3/mp3dec.h"
+
+// One decoder voice: streams an MP3 from the SD card through its own Helix
+// decoder instance, so two of them can run side by side during a crossfade.
+class Mp3Source : public PcmSource {
+public:
+  Mp3Source();
+  ~Mp3Source();
+
+  // Creates the Helix decoder (about 24 KB); false if the heap is short.
+  // Call once, before the first open.
+  bool allocate();
+  void setReadAhead(uint8_t *buf) { reader.setReadAhead(buf); }
+
+  bool open(const char *path);
+  bool open(PadLocation *pad); // Indexed: ID3 tag size known
+  bool open(PadPrefetch &prefetch); // ID3 tag already skipped
+
+  size_t read(int16_t *out, size_t frames) override;
+  uint32_t sampleRate() const override { return rate; }
+  bool isOpen() const override { return opened; }
+  void close() override;
+  bool reads(const char *path) const override { return reader.reads(path); }
+  bool mark() override;
+  bool rewind() override;
+
+  // Length of the ID3v2 tag starting with `hdr` (first 10 bytes of the
+  // file), or 0 if there is none
+  static uint32_t id3TagSize(const uint8_t *hdr);
+
+private:
+  static const size_t IN_BUF_SIZE = 4096;
+  static const size_t MAX_FRAME_SAMPLES = 1152 * 2;
+
+  PadReader reader;
+  HMP3Decoder decoder;
+  bool opened;
+  bool fileEnded;
+  uint32_t rate;
+
+  uint8_t inBuf[IN_BUF_SIZE];
+  uint8_t *inPtr;
+  int inLen;
+
+  int16_t pcm[MAX_FRAME_SAMPLES];
+  size_t pcmFrames;
+  size_t pcmPos;
+
+  // File offsets of the frame in pcm[] and the ones before it. Layer III
+  // frames borrow main data from earlier frames (bit reservoir) and the
+  // synthesis overlaps into the next one, so a rewind decodes a few
+  // frames ahead of the mark to rebuild that state.
+  static const int HISTORY = 3;
+  uint32_t frameOffsets[HISTORY]; // [0] = current frame
+  bool marked;
+  uint32_t markOffsets[HISTORY];
+  size_t markPcmPos;
+
+  bool start();
+  void refill();
+  bool decodeFrame();
+};
+
+#endif
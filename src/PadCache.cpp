@@ -0,0 +1,172 @@
+#include "PadCache.h"
+#include "Mp3Source.h"
+#include "PadIndex.h"
+#include "PcmFileSource.h"
+#include "SdScheduler.h"
+
+static const size_t BUILD_CHUNK_FRAMES = 2048; // 8 KB per SD write
+
+// --- PadCache ---
+
+PadCache::PadCache() : cancelRequested(false), task(NULL), doneSem(NULL) {}
+
+bool PadCache::cachePathFor(const char *mp3Path, char *out, size_t len) {
+  const char *dot = strrchr(mp3Path, '.');
+  int stemLen = dot ? (int)(dot - mp3Path) : (int)strlen(mp3Path);
+  int n = snprintf(out, len, PAD_CACHE_DIR "%.*s.pcm", stemLen, mp3Path);
+  return n > 0 && (size_t)n < len;
+}
+
+void PadCache::start(const std::vector<String> &mp3Paths) {
+  cancel();
+
+  if (!doneSem)
+    doneSem = xSemaphoreCreateBinary();
+  xSemaphoreTake(doneSem, 0); // Clear a completion nobody waited for
+
+  pending = mp3Paths;
+  cancelRequested = false;
+
+  // Core 1 at idle priority: only runs while the UI loop is sleeping, and
+  // never competes with the audio task on core 0.
+  if (xTaskCreatePinnedToCore(taskEntry, "PadCache", 4096 * 2, this,
+                              tskIDLE_PRIORITY, &task, 1) != pdPASS) {
+    task = NULL;
+  }
+}
+
+void PadCache::cancel() {
+  if (!task)
+    return;
+  cancelRequested = true;
+  xSemaphoreTake(doneSem, portMAX_DELAY);
+}
+
+void PadCache::taskEntry(void *param) {
+  PadCache *self = static_cast<PadCache *>(param);
+  self->run();
+  self->task = NULL;
+  xSemaphoreGive(self->doneSem);
+  vTaskDelete(NULL);
+}
+
+void PadCache::run() {
+  char pcmPath[96];
+  int built = 0;
+
+  for (size_t i = 0; i < pending.size() && !cancelRequested; i++) {
+    const char *mp3Path = pending[i].c_str();
+    if (!cachePathFor(mp3Path, pcmPath, sizeof(pcmPath)))
+      continue;
+    if (isFresh(mp3Path, pcmPath))
+      continue;
+    if (build(mp3Path, pcmPath))
+      built++;
+  }
+
+  if (built > 0) {
+    Serial.printf("PadCache: %d pads decoded\n", built);
+    padIndex.stampCard(); // The sidecars are not a change to the banks
+  }
+}
+
+uint32_t PadCache::sourceSize(const char *mp3Path) {
+  File src = SD.open(mp3Path);
+  if (!src)
+    return 0;
+  uint32_t size = src.size();
+  src.close();
+  return size;
+}
+
+bool PadCache::isFresh(const char *mp3Path, const char *pcmPath) {
+  bool fresh = false;
+  sdScheduler.lock();
+  uint32_t srcSize = sourceSize(mp3Path);
+  if (srcSize > 0) {
+    File pcm = SD.open(pcmPath);
+    if (pcm) {
+      PcmCacheHeader hdr;
+      fresh = pcm.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+              PcmFileSource::isValidHeader(hdr) && hdr.sourceSize == srcSize;
+      pcm.close();
+    }
+  } else {
+    fresh = true; // No source pad for this key: nothing to build
+  }
+  sdScheduler.unlock();
+  return fresh;
+}
+
+bool PadCache::build(const char *mp3Path, const char *pcmPath) {
+  // Heap, not stack: the decoder voice carries its own buffers
+  Mp3Source *decoder = new Mp3Source();
+  uint8_t *readAhead = (uint8_t *)malloc(SD_TRANSFER_BYTES);
+  int16_t *chunk = (int16_t *)malloc(BUILD_CHUNK_FRAMES * 2 * sizeof(int16_t));
+  decoder->setReadAhead(readAhead);
+  if (!chunk || !readAhead || !decoder->allocate() || !decoder->open(mp3Path)) {
+    free(chunk);
+    delete decoder;
+    free(readAhead);
+    return false;
+  }
+
+  char tmpPath[100];
+  snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", pcmPath);
+
+  PcmCacheHeader hdr;
+  PcmFileSource::fillMagic(hdr);
+  hdr.sampleRate = decoder->sampleRate();
+  hdr.frames = 0;
+  hdr.sourceSize = 0;
+
+  sdScheduler.lock();
+  hdr.sourceSize = sourceSize(mp3Path);
+  if (!SD.exists(PAD_CACHE_DIR))
+    SD.mkdir(PAD_CACHE_DIR);
+  String dir = String(pcmPath);
+  dir = dir.substring(0, dir.lastIndexOf('/'));
+  if (!SD.exists(dir))
+    SD.mkdir(dir);
+  File out = SD.open(tmpPath, FILE_WRITE);
+  if (out)
+    out.write((const uint8_t *)&hdr, sizeof(hdr)); // Patched when done
+  sdScheduler.unlock();
+
+  bool ok = (bool)out;
+  while (ok && !cancelRequested) {
+    size_t n = decoder->read(chunk, BUILD_CHUNK_FRAMES);
+    if (n == 0)
+      break;
+    size_t bytes = n * 2 * sizeof(int16_t);
+    sdScheduler.lock();
+    ok = out.write((const uint8_t *)chunk, bytes) == bytes;
+    sdScheduler.unlock();
+    hdr.frames += n;
+    vTaskDelay(1); // Let the UI loop and Wi-Fi stack breathe
+  }
+  decoder->close();
+  delete decoder;
+  free(readAhead);
+  free(chunk);
+
+  ok = ok && !cancelRequested && hdr.frames > 0;
+
+  sdScheduler.lock();
+  if (out) {
+    if (ok) {
+      out.seek(0);
+      out.write((const uint8_t *)&hdr, sizeof(hdr));
+    }
+    out.close();
+  }
+  if (ok) {
+    if (SD.exists(pcmPath))
+      SD.remove(pcmPath);
+    ok = SD.rename(tmpPath, pcmPath);
+  } else {
+    SD.remove(tmpPath);
+  }
+  sdScheduler.unlock();
+  return ok;
+}
@@ -0,0 +1,55 @@
+#ifndef PAD_CACHE_H
+#define PAD_CACHE_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <vector>
+
+// Pre-decoded PCM sidecars for the MP3 banks.
+// Each /<bank>/<key>.mp3 is decoded once, in the background, into
+// /.padcache/<bank>/<key>.pcm (raw 16-bit stereo behind a small header).
+// Playback of a cached pad is then a plain file read with no decoding.
+
+#define PAD_CACHE_DIR "/.padcache"
+
+struct PcmCacheHeader {
+  char magic[4];       // "PCM1"
+  uint32_t sampleRate;
+  uint32_t frames;
+  uint32_t sourceSize; // Size of the MP3 it was built from (staleness check)
+};
+
+class PadCache {
+public:
+  PadCache();
+
+  // Map "/<bank>/<key>.mp3" to its sidecar path. Returns false if the
+  // result does not fit in `out`.
+  static bool cachePathFor(const char *mp3Path, char *out, size_t len);
+
+  // Size of the MP3 a sidecar must have been built from, 0 if it is gone.
+  // Call with the card locked.
+  static uint32_t sourceSize(const char *mp3Path);
+
+  // Build any missing or stale sidecars for `mp3Paths` on a low-priority
+  // task. Restarts the build if one is already running.
+  void start(const std::vector<String> &mp3Paths);
+
+  // Stop the background build and wait for it to let go of the card
+  void cancel();
+
+  bool isBusy() const { return task != NULL; }
+
+private:
+  std::vector<String> pending;
+  volatile bool cancelRequested;
+  TaskHandle_t task;
+  SemaphoreHandle_t doneSem;
+
+  static void taskEntry(void *param);
+  void run();
+  bool isFresh(const char *mp3Path, const char *pcmPath);
+  bool build(const char *mp3Path, const char *pcmPath);
+};
+
+#endif
@@ -0,0 +1,603 @@
+#include "PadIndex.h"
+#include "Mp3Source.h"
+#include "SdScheduler.h"
+
+#include <Preferences.h>
+#include <algorithm>
+
+PadIndex padIndex;
+
+// Semitones above C of the natural notes A-G
+static const int8_t NOTE_KEYS[7] = {9, 11, 0, 2, 4, 5, 7};
+
+static const char ROOT_PREFIX[] = "root-";
+static const char INDEX_MAGIC[4] = {'P', 'I', 'X', '1'};
+
+// Used space of the card when the index was last saved, kept in NVS: a
+// card changed on a computer no longer matches it
+static const char STAMP_NAMESPACE[] = "padindex";
+static const char STAMP_KEY[] = "used";
+
+static uint64_t readStamp() {
+  Preferences prefs;
+  uint64_t used = 0;
+  prefs.begin(STAMP_NAMESPACE, true);
+  if (prefs.getBytes(STAMP_KEY, &used, sizeof(used)) != sizeof(used))
+    used = 0;
+  prefs.end();
+  return used;
+}
+
+static void writeStamp(uint64_t used) {
+  Preferences prefs;
+  prefs.begin(STAMP_NAMESPACE, false);
+  prefs.putBytes(STAMP_KEY, &used, sizeof(used));
+  prefs.end();
+}
+
+// Last part of a directory entry's name: some cores list full paths
+static const char *entryName(File &entry) {
+  const char *name = entry.name();
+  const char *slash = strrchr(name, '/');
+  return slash ? slash + 1 : name;
+}
+
+// Key named by `stem` ("C", "Cs", "C#", "Db", any case), or -1
+static int parseKeyName(const char *stem, size_t len) {
+  if (len < 1 || len > 2)
+    return -1;
+  char note = toupper(stem[0]);
+  if (note < 'A' || note > 'G')
+    return -1;
+  int key = NOTE_KEYS[note - 'A'];
+  if (len == 2) {
+    char acc = stem[1];
+    if (acc == '#' || acc == 's' || acc == 'S')
+      key++;
+    else if (acc == 'b')
+      key--;
+    else
+      return -1;
+  }
+  return (key + PAD_KEY_COUNT) % PAD_KEY_COUNT;
+}
+
+// Split "Db.wav" into its key (or root key) and format. Returns false for
+// anything that is not a pad.
+static bool parsePadName(const char *name, int *key, bool *root,
+                         PadFormat *format) {
+  const char *dot = strrchr(name, '.');
+  if (!dot)
+    return false;
+  if (strcasecmp(dot, ".mp3") == 0)
+    *format = PAD_MP3;
+  else if (strcasecmp(dot, ".wav") == 0)
+    *format = PAD_WAV;
+  else
+    return false;
+
+  const char *stem = name;
+  size_t prefix = sizeof(ROOT_PREFIX) - 1;
+  *root = strncasecmp(name, ROOT_PREFIX, prefix) == 0;
+  if (*root)
+    stem += prefix;
+  *key = parseKeyName(stem, dot - stem);
+  return *key >= 0;
+}
+
+static uint32_t readLE32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t readLE16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+// Find where the audio starts in `f` (open at offset 0). WAV files must be
+// 16-bit stereo PCM, which is what the mixer plays; others are skipped.
+bool PadIndex::locateData(File &f, PadFormat format, Pad &pad) {
+  uint32_t size = f.size();
+  pad.sampleRate = 0;
+
+  if (format == PAD_MP3) {
+    uint8_t hdr[10];
+    uint32_t skip = 0;
+    if (f.read(hdr, sizeof(hdr)) == sizeof(hdr))
+      skip = Mp3Source::id3TagSize(hdr);
+    if (skip >= size)
+      return false;
+    pad.dataOffset = skip;
+    pad.dataBytes = size - skip;
+    return true;
+  }
+
+  uint8_t riff[12];
+  if (f.read(riff, sizeof(riff)) != sizeof(riff) ||
+      memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+    return false;
+
+  uint32_t at = sizeof(riff);
+  while (at + 8 <= size) {
+    uint8_t chunk[8];
+    if (!f.seek(at) || f.read(chunk, sizeof(chunk)) != sizeof(chunk))
+      return false;
+    uint32_t len = readLE32(chunk + 4);
+    at += sizeof(chunk);
+
+    if (memcmp(chunk, "fmt ", 4) == 0) {
+      uint8_t fmt[16];
+      if (len < sizeof(fmt) || f.read(fmt, sizeof(fmt)) != sizeof(fmt))
+        return false;
+      if (readLE16(fmt) != 1 || readLE16(fmt + 2) != 2 ||
+          readLE16(fmt + 14) != 16)
+        return false; // Not 16-bit stereo PCM
+      pad.sampleRate = readLE32(fmt + 4);
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      if (pad.sampleRate == 0)
+        return false; // No usable fmt chunk ahead of the data
+      pad.dataOffset = at;
+      pad.dataBytes = std::min(len, size - at) & ~3u; // Whole frames
+      return true;
+    }
+    at += len + (len & 1); // Chunks are padded to even sizes
+  }
+  return false;
+}
+
+bool PadIndex::isBankName(const char *name) {
+  return name[0] != '.' && strncmp(name, "System", 6) != 0;
+}
+
+// One pass over the bank folder, reusing what `previous` (the same bank
+// as last indexed, or NULL) knows of files that have not changed. Takes
+// the card per entry, so audio reads get it in between. Returns
+// false if the folder is gone.
+bool PadIndex::indexBank(Bank &bank, const Bank *previous) {
+  bank.rootKey = -1;
+  memset(bank.pads, 0, sizeof(bank.pads));
+
+  int rootKey = -1;
+  Pad rootPad = {};
+  bool anyKeyFile = false;
+  std::vector<String> loopStems;
+
+  char dirPath[72];
+  snprintf(dirPath, sizeof(dirPath), "/%s", bank.name);
+  sdScheduler.lock();
+  File dir = SD.open(dirPath);
+  bool exists = dir && dir.isDirectory();
+  if (!exists)
+    dir.close();
+  sdScheduler.unlock();
+  if (!exists)
+    return false;
+
+  while (true) {
+    sdScheduler.lock();
+    File entry = dir.openNextFile();
+    if (!entry) {
+      dir.close();
+      sdScheduler.unlock();
+      break;
+    }
+    const char *name = entryName(entry);
+    const char *dot = strrchr(name, '.');
+    int key;
+    bool root;
+    PadFormat format;
+    if (entry.isDirectory() || strlen(name) >= sizeof(Pad::name)) {
+      // Not a pad
+    } else if (dot && strcasecmp(dot, ".loop") == 0) {
+      loopStems.push_back(String(name).substring(0, dot - name));
+    } else if (parsePadName(name, &key, &root, &format)) {
+      Pad &pad = root ? rootPad : bank.pads[key];
+      uint32_t size = entry.size();
+      uint32_t modTime = (uint32_t)entry.getLastWrite();
+      const Pad *known = NULL;
+      for (int k = 0; previous && k < PAD_KEY_COUNT && !known; k++) {
+        const Pad &p = previous->pads[k];
+        if (strcmp(p.name, name) == 0 && p.fileSize == size &&
+            p.modTime == modTime)
+          known = &p;
+      }
+      if (pad.name[0] != '\0') {
+        // First spelling found wins
+      } else if (known) {
+        pad = *known;
+        pad.hasLoopFile = 0; // Found again below
+        if (root)
+          rootKey = key;
+        else
+          anyKeyFile = true;
+      } else if (locateData(entry, format, pad)) {
+        strcpy(pad.name, name);
+        pad.fileSize = size;
+        pad.modTime = modTime;
+        pad.format = format;
+        if (root)
+          rootKey = key;
+        else
+          anyKeyFile = true;
+      }
+    }
+    entry.close();
+    sdScheduler.unlock();
+  }
+
+  // Key files win over a root recording left in the same folder
+  if (!anyKeyFile && rootKey >= 0) {
+    bank.rootKey = rootKey;
+    bank.pads[rootKey] = rootPad;
+  }
+  for (Pad &pad : bank.pads) {
+    const char *dot = strrchr(pad.name, '.');
+    for (const String &stem : loopStems) {
+      if (dot && stem.length() == (size_t)(dot - pad.name) &&
+          strncmp(stem.c_str(), pad.name, stem.length()) == 0)
+        pad.hasLoopFile = 1;
+    }
+  }
+  return true;
+}
+
+void PadIndex::begin() { lock = xSemaphoreCreateMutex(); }
+
+static bool bankLess(const char *a, const char *b) { return strcmp(a, b) < 0; }
+
+bool PadIndex::load() {
+  std::vector<Bank> loaded;
+  bool ok = false;
+
+  sdScheduler.lock();
+  uint64_t stamp = readStamp();
+  stale = stamp == 0 || stamp != SD.usedBytes();
+  {
+    File f = SD.open(PAD_INDEX_FILE);
+    FileHeader hdr;
+    if (f && f.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+        memcmp(hdr.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+        hdr.bankSize == sizeof(Bank) &&
+        f.size() == sizeof(hdr) + (size_t)hdr.bankCount * sizeof(Bank)) {
+      loaded.resize(hdr.bankCount);
+      size_t bytes = loaded.size() * sizeof(Bank);
+      ok = f.read((uint8_t *)loaded.data(), bytes) == bytes;
+    }
+    f.close();
+  }
+  sdScheduler.unlock();
+  if (!ok) {
+    stale = true;
+    return false;
+  }
+
+  for (Bank &b : loaded)
+    b.name[sizeof(b.name) - 1] = '\0';
+  xSemaphoreTake(lock, portMAX_DELAY);
+  banks.swap(loaded);
+  revisionCount++;
+  xSemaphoreGive(lock);
+  return !stale;
+}
+
+void PadIndex::startRescan() {
+  cancelRescan();
+
+  if (!doneSem)
+    doneSem = xSemaphoreCreateBinary();
+  xSemaphoreTake(doneSem, 0); // Clear a completion nobody waited for
+
+  cancelRequested = false;
+  scanning = true;
+  // Idle priority on core 1, like the PCM cache builder: it runs while the
+  // UI loop sleeps and never competes with the audio task
+  if (xTaskCreatePinnedToCore(taskEntry, "PadScan", 4096, this,
+                              tskIDLE_PRIORITY, &task, 1) != pdPASS) {
+    task = NULL;
+    scanning = false;
+  }
+}
+
+void PadIndex::cancelRescan() {
+  if (!task)
+    return;
+  cancelRequested = true;
+  xSemaphoreTake(doneSem, portMAX_DELAY);
+}
+
+void PadIndex::taskEntry(void *param) {
+  PadIndex *self = static_cast<PadIndex *>(param);
+  self->scan();
+  self->scanning = false;
+  self->task = NULL;
+  xSemaphoreGive(self->doneSem);
+  vTaskDelete(NULL);
+}
+
+// Put `bank` in place (sorted by name) and let the UI know. Caller holds
+// `lock`.
+void PadIndex::publish(const Bank &bank) {
+  auto it = std::lower_bound(
+      banks.begin(), banks.end(), bank.name,
+      [](const Bank &b, const char *n) { return bankLess(b.name, n); });
+  if (it != banks.end() && strcmp(it->name, bank.name) == 0)
+    *it = bank;
+  else
+    banks.insert(it, bank);
+  revisionCount++;
+}
+
+// Copy of what the index holds for `name`, for indexBank() to reuse
+bool PadIndex::snapshot(const char *name, Bank *out) const {
+  xSemaphoreTake(lock, portMAX_DELAY);
+  const Bank *b = find(name);
+  if (b)
+    *out = *b;
+  xSemaphoreGive(lock);
+  return b != NULL;
+}
+
+// List the root for bank folders, then index and publish them one at a
+// time. The card is taken per directory entry, never for the whole scan.
+void PadIndex::scan() {
+  std::vector<String> names;
+  sdScheduler.lock();
+  File root = SD.open("/");
+  sdScheduler.unlock();
+  while (root && !cancelRequested) {
+    sdScheduler.lock();
+    File entry = root.openNextFile();
+    const char *name = entry ? entryName(entry) : "";
+    if (entry && entry.isDirectory() && isBankName(name) &&
+        strlen(name) < sizeof(Bank::name))
+      names.push_back(name);
+    bool more = (bool)entry;
+    entry.close();
+    sdScheduler.unlock();
+    if (!more)
+      break;
+  }
+  sdScheduler.lock();
+  root.close();
+  sdScheduler.unlock();
+  if (cancelRequested)
+    return;
+
+  for (const String &name : names) {
+    if (cancelRequested)
+      return;
+    Bank fresh, previous;
+    strcpy(fresh.name, name.c_str());
+    bool known = snapshot(fresh.name, &previous);
+    if (!indexBank(fresh, known ? &previous : NULL))
+      continue;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    publish(fresh);
+    xSemaphoreGive(lock);
+  }
+
+  // Drop the banks that are gone
+  std::sort(names.begin(), names.end());
+  xSemaphoreTake(lock, portMAX_DELAY);
+  auto gone = std::remove_if(banks.begin(), banks.end(), [&](const Bank &b) {
+    return !std::binary_search(names.begin(), names.end(), String(b.name));
+  });
+  if (gone != banks.end()) {
+    banks.erase(gone, banks.end());
+    revisionCount++;
+  }
+  xSemaphoreGive(lock);
+
+  stale = false;
+  save();
+}
+
+void PadIndex::updateBank(const char *name) {
+  if (!isBankName(name) || strlen(name) >= sizeof(Bank::name))
+    return;
+
+  Bank fresh, previous;
+  strcpy(fresh.name, name);
+  bool known = snapshot(name, &previous);
+  if (!indexBank(fresh, known ? &previous : NULL)) {
+    removeBank(name);
+    return;
+  }
+  xSemaphoreTake(lock, portMAX_DELAY);
+  publish(fresh);
+  xSemaphoreGive(lock);
+  save();
+}
+
+void PadIndex::removeBank(const char *name) {
+  xSemaphoreTake(lock, portMAX_DELAY);
+  auto it = std::lower_bound(
+      banks.begin(), banks.end(), name,
+      [](const Bank &b, const char *n) { return bankLess(b.name, n); });
+  bool found = it != banks.end() && strcmp(it->name, name) == 0;
+  if (found) {
+    banks.erase(it);
+    revisionCount++;
+  }
+  xSemaphoreGive(lock);
+  if (found)
+    save();
+}
+
+void PadIndex::save() {
+  FileHeader hdr;
+  memcpy(hdr.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  hdr.bankSize = sizeof(Bank);
+
+  sdScheduler.lock();
+  File f = SD.open(PAD_INDEX_FILE, FILE_WRITE);
+  if (f) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    hdr.bankCount = banks.size();
+    size_t bytes = banks.size() * sizeof(Bank);
+    bool ok = f.write((const uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+              f.write((const uint8_t *)banks.data(), bytes) == bytes;
+    xSemaphoreGive(lock);
+    f.close();
+    // A stale index stays unstamped until a rescan has caught it up.
+    // NVS only when the stamp changes: saves come with every bank edit.
+    uint64_t used = ok && !stale ? SD.usedBytes() : 0;
+    if (used != readStamp())
+      writeStamp(used);
+  }
+  sdScheduler.unlock();
+}
+
+void PadIndex::stampCard() {
+  sdScheduler.lock();
+  uint64_t stamp = readStamp();
+  if (!stale && stamp != 0) { // Never vouch for an unsaved index
+    uint64_t used = SD.usedBytes();
+    if (used != stamp)
+      writeStamp(used);
+  }
+  sdScheduler.unlock();
+}
+
+uint32_t PadIndex::revision() const {
+  xSemaphoreTake(lock, portMAX_DELAY);
+  uint32_t g = revisionCount;
+  xSemaphoreGive(lock);
+  return g;
+}
+
+std::vector<String> PadIndex::bankNames() const {
+  std::vector<String> names;
+  xSemaphoreTake(lock, portMAX_DELAY);
+  names.reserve(banks.size());
+  for (const Bank &b : banks)
+    names.push_back(b.name);
+  xSemaphoreGive(lock);
+  return names;
+}
+
+const PadIndex::Bank *PadIndex::find(const char *name) const {
+  auto it = std::lower_bound(
+      banks.begin(), banks.end(), name,
+      [](const Bank &b, const char *n) { return bankLess(b.name, n); });
+  return (it != banks.end() && strcmp(it->name, name) == 0) ? &*it : NULL;
+}
+
+bool PadIndex::locate(const char *bank, int key, PadLocation *loc) const {
+  key = ((key % PAD_KEY_COUNT) + PAD_KEY_COUNT) % PAD_KEY_COUNT;
+  bool found = false;
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  const Bank *b = find(bank);
+  if (b) {
+    loc->rootKey = b->rootKey;
+    const Pad &pad = b->pads[b->rootKey >= 0 ? b->rootKey : key];
+    if (pad.name[0] != '\0') {
+      int n = snprintf(loc->path, sizeof(loc->path), "/%s/%s", bank,
+                       pad.name);
+      found = n > 0 && (size_t)n < sizeof(loc->path);
+      loc->format = pad.format;
+      loc->dataOffset = pad.dataOffset;
+      loc->dataBytes = pad.dataBytes;
+      loc->sampleRate = pad.sampleRate;
+      loc->fileSize = pad.fileSize;
+      loc->modTime = pad.modTime;
+      loc->hasLoopFile = pad.hasLoopFile;
+    }
+  }
+  xSemaphoreGive(lock);
+
+  if (!found) {
+    buildPadPath(bank, key, loc->path, sizeof(loc->path));
+    loc->format = PAD_MP3;
+    loc->dataOffset = loc->dataBytes = loc->sampleRate = 0;
+    loc->fileSize = loc->modTime = 0;
+    loc->rootKey = -1;
+    loc->hasLoopFile = false;
+  }
+  return found;
+}
+
+bool PadIndex::locate(BankHandle bank, int key, PadLocation *loc) const {
+  char name[sizeof(Bank::name)] = "";
+  xSemaphoreTake(lock, portMAX_DELAY);
+  if (bank < handles.size())
+    snprintf(name, sizeof(name), "%s", handles[bank].c_str());
+  xSemaphoreGive(lock);
+  return locate(name, key, loc);
+}
+
+BankHandle PadIndex::handle(const char *bank) {
+  if (bank[0] == '\0')
+    return PAD_NO_BANK;
+  xSemaphoreTake(lock, portMAX_DELAY);
+  size_t h = 0;
+  while (h < handles.size() && strcmp(handles[h].c_str(), bank) != 0)
+    h++;
+  if (h == handles.size() && h < PAD_NO_BANK)
+    handles.push_back(bank);
+  xSemaphoreGive(lock);
+  return h < PAD_NO_BANK ? (BankHandle)h : PAD_NO_BANK;
+}
+
+bool PadIndex::check(File &f, PadLocation *loc) {
+  bool known = loc->fileSize != 0;
+  if (!f) {
+    if (known)
+      queueChanged("");
+    return false;
+  }
+  if (known && f.size() == loc->fileSize &&
+      (uint32_t)f.getLastWrite() == loc->modTime)
+    return true;
+
+  // Not what was indexed (or not indexed yet): read the headers again
+  Pad pad = {};
+  bool ok = locateData(f, loc->format, pad);
+  if (ok) {
+    loc->dataOffset = pad.dataOffset;
+    loc->dataBytes = pad.dataBytes;
+    loc->sampleRate = pad.sampleRate;
+  }
+  if (known) {
+    char bank[sizeof(Bank::name)];
+    const char *name = loc->path + 1;
+    const char *slash = strchr(name, '/');
+    size_t len = slash ? (size_t)(slash - name) : 0;
+    if (len < sizeof(bank)) {
+      memcpy(bank, name, len);
+      bank[len] = '\0';
+      queueChanged(bank);
+    }
+  }
+  return ok;
+}
+
+// A second bank before the UI loop took the first: rescan the card
+void PadIndex::queueChanged(const char *bank) {
+  Serial.printf("Index out of date: %s\n", bank[0] ? bank : "card");
+  xSemaphoreTake(lock, portMAX_DELAY);
+  if (changedPending && strcmp(changedBank, bank) != 0)
+    changedBank[0] = '\0';
+  else if (!changedPending)
+    strcpy(changedBank, bank);
+  changedPending = true;
+  if (changedBank[0] == '\0')
+    stale = true;
+  xSemaphoreGive(lock);
+}
+
+bool PadIndex::takeChanged(String *bank) {
+  xSemaphoreTake(lock, portMAX_DELAY);
+  bool pending = changedPending;
+  if (pending)
+    *bank = changedBank;
+  changedPending = false;
+  xSemaphoreGive(lock);
+  return pending;
+}
+
+int PadIndex::rootKey(const char *bank) const {
+  xSemaphoreTake(lock, portMAX_DELAY);
+  const Bank *b = find(bank);
+  int root = b ? b->rootKey : -1;
+  xSemaphoreGive(lock);
+  return root;
+}
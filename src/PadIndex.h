@@ -0,0 +1,165 @@
+#ifndef PAD_INDEX_H
+#define PAD_INDEX_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <vector>
+
+#include "PadPaths.h"
+
+// Where each pad of each bank lives on the card, worked out once when the
+// banks are scanned: one listing per bank folder, with every accepted
+// spelling of a key file ("Cs", "C#", "Db", lower case, .mp3 or .wav) and
+// each file's audio data located. Play then opens the exact file and
+// starts reading at its first audio byte, with no probing for names and no
+// header parsing.
+//
+// The index is kept on the card in PAD_INDEX_FILE and loaded in one read
+// at boot. The file manager updates it bank by bank as it changes the
+// card, so the root is only listed again when the card was changed
+// somewhere else (its used space no longer matches). That rescan runs on
+// a background task and publishes each bank as it is indexed; the UI
+// picks them up when revision() moves.
+//
+// Some changes leave the used space as it was: a renamed folder, a pad
+// replaced by one of the same cluster count. Each pad is therefore checked
+// against its entry (size and time) as it is opened, see check().
+
+#define PAD_INDEX_FILE "/.padindex"
+
+// A bank as the audio commands name it: a small number in place of the
+// folder name, the same for as long as the firmware runs
+typedef uint16_t BankHandle;
+#define PAD_NO_BANK ((BankHandle)0xffff)
+
+enum PadFormat : uint8_t { PAD_MP3, PAD_WAV };
+
+// A pad file as the audio task opens it
+struct PadLocation {
+  char path[64];
+  PadFormat format;
+  uint32_t dataOffset; // First audio byte: past the ID3 tag or WAV headers
+  uint32_t dataBytes;  // Audio bytes from there
+  uint32_t sampleRate; // WAV only (MP3 frames carry their own)
+  uint32_t fileSize;   // As indexed, with modTime; 0 = not in the index
+  uint32_t modTime;
+  int rootKey;         // Key of a root recording, -1 for a key file
+  bool hasLoopFile;    // A .loop sidecar sits next to it
+};
+
+class PadIndex {
+public:
+  PadIndex()
+      : lock(NULL), revisionCount(0), changedPending(false), stale(true),
+        scanning(false), cancelRequested(false), task(NULL), doneSem(NULL) {
+    changedBank[0] = '\0';
+  }
+
+  void begin();
+
+  // Load PAD_INDEX_FILE. False if it is missing, damaged or stale: then
+  // startRescan(). Whatever could be read is kept meanwhile, so the last
+  // known banks are playable right away.
+  bool load();
+
+  // List the root and index every bank folder on a low-priority task,
+  // publishing banks as it goes, then save. Restarts a running scan.
+  void startRescan();
+  void cancelRescan(); // Waits for the task to let go of the card
+  bool isScanning() const { return scanning; }
+  bool isStale() const { return stale; } // A rescan has yet to finish
+
+  // Bumped whenever a bank is added, changed or dropped
+  uint32_t revision() const;
+
+  // Re-list one bank folder after it changed (created, uploaded to, file
+  // deleted), or drop it if it is gone, then save. Pads whose size and
+  // time are unchanged keep their entries without being reopened.
+  void updateBank(const char *bank);
+  void removeBank(const char *bank);
+
+  // Record the card as in step with the index after writes it does not
+  // track (the PCM cache). Takes the card.
+  void stampCard();
+
+  std::vector<String> bankNames() const; // Sorted
+
+  // Folders that hold pads: not hidden, not "System..."
+  static bool isBankName(const char *name);
+
+  // The file that sounds `key` (0-11 from C) in `bank`: its key file, or
+  // its root recording. False if the bank or the file is missing; `loc`
+  // then names the canonical key file so the failure shows in the log.
+  bool locate(const char *bank, int key, PadLocation *loc) const;
+  bool locate(BankHandle bank, int key, PadLocation *loc) const;
+
+  // Handle of a bank folder name, given out on first use and never
+  // reused, so it stays valid across rescans. PAD_NO_BANK for "".
+  BankHandle handle(const char *bank);
+
+  // Key of the bank's root recording, -1 for a key-file bank
+  int rootKey(const char *bank) const;
+
+  // A pad just opened (`f`, closed if the file is gone) against its entry.
+  // If the file changed since it was indexed, its audio data is found
+  // again into `loc` and the bank queued for takeChanged(); a missing file
+  // queues the whole card, as its folder may have been renamed. False if
+  // there is nothing to play. Caller holds sdScheduler's lock.
+  bool check(File &f, PadLocation *loc);
+
+  // UI loop: what check() found out of date, a bank name or "" for the
+  // whole card. False if nothing.
+  bool takeChanged(String *bank);
+
+private:
+  // Saved as they are: PAD_INDEX_FILE is a FileHeader and the banks
+  struct Pad {
+    uint32_t dataOffset;
+    uint32_t dataBytes;
+    uint32_t sampleRate;
+    uint32_t fileSize; // With modTime, tells a replaced file apart
+    uint32_t modTime;
+    char name[12]; // As listed ("Db.wav", "root-E.mp3"), "" = missing
+    PadFormat format;
+    uint8_t hasLoopFile;
+    uint8_t reserved[2];
+  };
+  struct Bank {
+    char name[64];
+    int32_t rootKey;
+    Pad pads[PAD_KEY_COUNT]; // By key; a root bank fills pads[rootKey]
+  };
+  struct FileHeader {
+    char magic[4]; // "PIX1"
+    uint32_t bankSize; // sizeof(Bank), so a layout change reads as stale
+    uint32_t bankCount;
+  };
+
+  std::vector<Bank> banks; // Sorted by name, like presetNames
+  SemaphoreHandle_t lock;  // Guards `banks`, `revisionCount`, `handles`
+  std::vector<String> handles; // Names by handle; only ever appended to
+  uint32_t revisionCount;
+  bool changedPending; // Also under `lock`; set from the audio task
+  char changedBank[sizeof(Bank::name)];
+
+  volatile bool stale;
+  volatile bool scanning;
+  volatile bool cancelRequested;
+  TaskHandle_t task;
+  SemaphoreHandle_t doneSem;
+
+  static void taskEntry(void *param);
+  void scan();
+  void publish(const Bank &bank);
+  void queueChanged(const char *bank);
+  bool snapshot(const char *name, Bank *out) const;
+
+  static bool indexBank(Bank &bank, const Bank *previous);
+  static bool locateData(File &f, PadFormat format, Pad &pad);
+  const Bank *find(const char *name) const;
+  void save();
+};
+
+extern PadIndex padIndex;
+
+#endif
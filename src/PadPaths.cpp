@@ -0,0 +1,25 @@
+#include "PadPaths.h"
+
+static const char *const KEY_FILE_NAMES[PAD_KEY_COUNT] = {
+    "C", "Cs", "D", "Ds", "E", "F", "Fs", "G", "Gs", "A", "As", "B"};
+
+const char *padKeyFileName(int key) {
+  return KEY_FILE_NAMES[((key % PAD_KEY_COUNT) + PAD_KEY_COUNT) %
+                        PAD_KEY_COUNT];
+}
+
+void buildPadPath(const char *bank, int key, char *out, size_t len) {
+  snprintf(out, len, "/%s/%s.mp3", bank, padKeyFileName(key));
+}
+
+int transposeSemitones(int key, int rootKey) {
+  int s = ((key - rootKey) % PAD_KEY_COUNT + PAD_KEY_COUNT) % PAD_KEY_COUNT;
+  return s > 5 ? s - PAD_KEY_COUNT : s;
+}
+
+bool pathIsUnder(const char *file, const char *path) {
+  size_t n = strlen(path);
+  if (n == 0 || strncmp(file, path, n) != 0)
+    return false;
+  return file[n] == '\0' || file[n] == '/' || path[n - 1] == '/';
+}
@@ -0,0 +1,27 @@
+#ifndef PAD_PATHS_H
+#define PAD_PATHS_H
+
+#include <Arduino.h>
+
+// Where a bank keeps its pads. A bank is either twelve key files,
+// "/<bank>/C.mp3" ... "/<bank>/B.mp3" with sharps spelled 's' (C# -> Cs),
+// or a single root recording, "/<bank>/root-<key>.mp3" (e.g. root-E.mp3),
+// that the audio task transposes into every key. PadIndex finds the files
+// actually on the card, in any of the spellings it accepts.
+
+#define PAD_KEY_COUNT 12
+
+// File-name spelling of key 0-11 from C ("C", "Cs", ... "B")
+const char *padKeyFileName(int key);
+
+// "/<bank>/<key>.mp3"
+void buildPadPath(const char *bank, int key, char *out, size_t len);
+
+// Semitones (-6..+5) that bring a recording in `rootKey` to `key`, so no
+// key is ever more than half an octave away from the root
+int transposeSemitones(int key, int rootKey);
+
+// `file` is `path`, or inside the folder `path`
+bool pathIsUnder(const char *file, const char *path);
+
+#endif
@@ -0,0 +1,338 @@
+#include "PadReader.h"
+#include "AudioMetrics.h"
+#include "AudioTask.h"
+#include "Mp3Source.h"
+#include "PadPaths.h"
+#include "PcmFileSource.h"
+#include "SdScheduler.h"
+
+// --- PadReader ---
+
+static_assert(SD_TRANSFER_BYTES % SD_SECTOR_BYTES == 0,
+              "SD_TRANSFER_BYTES must be whole sectors");
+
+bool PadReader::open(const char *path) {
+  close();
+  pos = filePos = 0;
+  openedUs = micros();
+  timingOpen = true;
+  sdScheduler.lock();
+  file = SD.open(path);
+  sdScheduler.unlock();
+  return (bool)file;
+}
+
+bool PadReader::openPad(PadLocation *pad) {
+  close();
+  pos = filePos = 0;
+  openedUs = micros();
+  timingOpen = true;
+  sdScheduler.lock();
+  file = SD.open(pad->path);
+  bool ok = padIndex.check(file, pad) && file.seek(pad->dataOffset);
+  sdScheduler.unlock();
+  if (!ok) {
+    close();
+    return false;
+  }
+  pos = filePos = pad->dataOffset;
+  return true;
+}
+
+bool PadReader::reads(const char *path) const {
+  return file && pathIsUnder(file.path(), path);
+}
+
+bool PadReader::openPrefetched(PadPrefetch &prefetch) {
+  close();
+  openedUs = micros();
+  timingOpen = true;
+  file = prefetch.file;
+  prefetch.file = File();
+  head = prefetch.buf;
+  headLen = prefetch.len;
+  headPos = 0;
+  pos = prefetch.start;
+  filePos = prefetch.start + prefetch.len;
+  owner = &prefetch;
+  prefetch.state = PadPrefetch::PF_IN_USE;
+  if (headLen == 0)
+    releaseHead();
+  return (bool)file;
+}
+
+void PadReader::releaseHead() {
+  if (owner)
+    owner->release();
+  owner = NULL;
+  head = NULL;
+  headLen = headPos = 0;
+}
+
+size_t PadReader::read(uint8_t *dst, size_t len) {
+  size_t total = 0;
+
+  if (head) {
+    size_t n = headLen - headPos;
+    if (n > len)
+      n = len;
+    memcpy(dst, head + headPos, n);
+    headPos += n;
+    total = n;
+    if (headPos >= headLen)
+      releaseHead(); // Buffer free for the next prefetch
+  }
+
+  while (total < len && file) {
+    if (aheadPos < aheadLen) {
+      size_t n = aheadLen - aheadPos;
+      if (n > len - total)
+        n = len - total;
+      memcpy(dst + total, ahead + aheadPos, n);
+      aheadPos += n;
+      total += n;
+      continue;
+    }
+
+    // A sector-aligned request of a whole transfer or more goes straight
+    // into the caller's buffer; anything else refills the read-ahead,
+    // cut short at the first sector boundary if the file is not on one
+    size_t want = len - total;
+    if (!ahead) {
+      size_t got = readFile(dst + total, want);
+      total += got;
+      if (got == 0)
+        break;
+      continue;
+    }
+    if (filePos % SD_SECTOR_BYTES == 0 && want >= SD_TRANSFER_BYTES) {
+      size_t got = readFile(dst + total, want - want % SD_SECTOR_BYTES);
+      total += got;
+      if (got == 0)
+        break;
+      continue;
+    }
+    aheadPos = 0;
+    aheadLen = readFile(ahead, SD_TRANSFER_BYTES - filePos % SD_SECTOR_BYTES);
+    if (aheadLen == 0)
+      break;
+  }
+  pos += total;
+  if (timingOpen && total > 0) {
+    timingOpen = false;
+    if (audioMetrics.isAudioTask())
+      audioMetrics.openUs.record(micros() - openedUs);
+  }
+  return total;
+}
+
+size_t PadReader::readFile(uint8_t *dst, size_t len) {
+  size_t got = 0;
+  uint32_t t0 = micros();
+  sdScheduler.lock();
+  uint32_t t1 = micros();
+  got = file.read(dst, len);
+  uint32_t t2 = micros();
+  sdScheduler.unlock();
+  if (audioMetrics.isAudioTask()) {
+    audioMetrics.sdWaitUs.record(t1 - t0);
+    audioMetrics.sdReadUs.record(t2 - t1);
+  }
+  filePos += got;
+  return got;
+}
+
+bool PadReader::seek(uint32_t newPos) {
+  if (!file)
+    return false;
+  releaseHead();
+
+  // Still inside the read-ahead (a short loop, a header re-read)
+  uint32_t aheadStart = filePos - aheadLen;
+  if (newPos >= aheadStart && newPos < filePos) {
+    aheadPos = newPos - aheadStart;
+    pos = newPos;
+    return true;
+  }
+
+  sdScheduler.lock();
+  bool ok = file.seek(newPos);
+  sdScheduler.unlock();
+  aheadLen = aheadPos = 0;
+  if (ok)
+    pos = filePos = newPos;
+  return ok;
+}
+
+void PadReader::close() {
+  releaseHead();
+  aheadLen = aheadPos = 0;
+  if (file) {
+    sdScheduler.lock();
+    file.close();
+    sdScheduler.unlock();
+  }
+}
+
+// --- PadPrefetch ---
+
+void PadPrefetch::request(const PadLocation &pad, bool preferPcm) {
+  if ((state == PF_FILLING || state == PF_READY) && strcmp(path, pad.path) == 0)
+    return; // Already on it
+
+  // Opened on the next service() call, so a burst of requests while the
+  // user scrolls only ever opens the last one.
+  deferred = pad;
+  deferredPcm = preferPcm;
+  hasDeferred = true;
+}
+
+bool PadPrefetch::matches(const char *p) const {
+  return (state == PF_FILLING || state == PF_READY) && strcmp(path, p) == 0;
+}
+
+void PadPrefetch::drop(const char *p) {
+  if (hasDeferred && pathIsUnder(deferred.path, p))
+    hasDeferred = false;
+  if (state != PF_IN_USE && file && pathIsUnder(file.path(), p))
+    reset();
+}
+
+void PadPrefetch::reset() {
+  if (file) {
+    sdScheduler.lock();
+    file.close();
+    sdScheduler.unlock();
+  }
+  len = 0;
+  start = 0;
+  pcm = false;
+  loop = false;
+  state = PF_EMPTY;
+}
+
+void PadPrefetch::release() {
+  len = 0;
+  state = PF_EMPTY;
+}
+
+void PadPrefetch::begin(const PadLocation &indexed, bool preferPcm) {
+  reset();
+  PadLocation pad = indexed; // check() may correct it
+  strncpy(path, pad.path, sizeof(path) - 1);
+  path[sizeof(path) - 1] = '\0';
+
+  sdScheduler.lock();
+
+  // A WAV is PCM already: its data chunk stands in for a sidecar
+  if (pad.format == PAD_WAV) {
+    file = SD.open(path);
+    if (padIndex.check(file, &pad) && file.seek(pad.dataOffset)) {
+      PcmFileSource::fillMagic(header);
+      header.sampleRate = pad.sampleRate;
+      header.frames = pad.dataBytes / (2 * sizeof(int16_t));
+      header.sourceSize = 0;
+      pcm = true;
+      start = pad.dataOffset;
+    } else if (file) {
+      file.close();
+    }
+  } else if (preferPcm) {
+    char cachePath[96];
+    if (PadCache::cachePathFor(path, cachePath, sizeof(cachePath))) {
+      File f = SD.open(cachePath);
+      if (f) {
+        // The MP3 may have been replaced since the sidecar was built
+        if (f.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+            PcmFileSource::isValidHeader(header) &&
+            header.sourceSize == PadCache::sourceSize(path)) {
+          file = f;
+          pcm = true;
+          start = sizeof(header);
+        } else {
+          f.close();
+        }
+      }
+    }
+  }
+
+  if (!file && pad.format == PAD_MP3) {
+    file = SD.open(path);
+    if (!padIndex.check(file, &pad)) {
+      if (file)
+        file.close();
+    } else {
+      file.seek(pad.dataOffset); // ID3 tag located by the index
+      start = pad.dataOffset;
+    }
+  }
+
+  if (file && pad.hasLoopFile)
+    loop = readLoopPoints(path, &loopFrom, &loopTo);
+
+  sdScheduler.unlock();
+
+  state = file ? PF_FILLING : PF_EMPTY;
+}
+
+void PadPrefetch::service() {
+  if (state == PF_IN_USE)
+    return;
+
+  if (hasDeferred) {
+    hasDeferred = false;
+    begin(deferred, deferredPcm);
+    return;
+  }
+
+  if (state != PF_FILLING)
+    return;
+
+  // Chunks end on sector boundaries, so the voice that adopts the file
+  // carries on with aligned reads
+  size_t want = sizeof(buf) - len;
+  if (want > AUDIO_PREFETCH_CHUNK)
+    want = AUDIO_PREFETCH_CHUNK - (start + len) % SD_SECTOR_BYTES;
+
+  size_t got = 0;
+  uint32_t t0 = micros();
+  sdScheduler.lock();
+  uint32_t t1 = micros();
+  got = file.read(buf + len, want);
+  uint32_t t2 = micros();
+  sdScheduler.unlock();
+  audioMetrics.sdWaitUs.record(t1 - t0);
+  audioMetrics.sdReadUs.record(t2 - t1);
+  len += got;
+  if (got < want || len >= sizeof(buf))
+    state = PF_READY;
+}
+
+// --- Loop points ---
+
+bool readLoopPoints(const char *mp3Path, uint32_t *start, uint32_t *end) {
+  const char *dot = strrchr(mp3Path, '.');
+  size_t stem = dot ? (size_t)(dot - mp3Path) : strlen(mp3Path);
+  char loopPath[72];
+  if (stem + 6 > sizeof(loopPath))
+    return false;
+  memcpy(loopPath, mp3Path, stem);
+  strcpy(loopPath + stem, ".loop");
+
+  File f = SD.open(loopPath);
+  if (!f)
+    return false;
+  char text[32];
+  size_t n = f.read((uint8_t *)text, sizeof(text) - 1);
+  f.close();
+  text[n] = '\0';
+
+  unsigned long a = 0, b = 0;
+  if (sscanf(text, "%lu %lu", &a, &b) < 1)
+    return false;
+  if (b != 0 && b <= a)
+    return false;
+  *start = a;
+  *end = b;
+  return true;
+}
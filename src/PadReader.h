@@ -0,0 +1,131 @@
+#ifndef PAD_READER_H
+#define PAD_READER_H
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include "Config.h"
+#include "PadCache.h"
+#include "PadIndex.h"
+
+class PadPrefetch;
+
+// Byte stream behind a voice. Serves a prefetched RAM head first (if it
+// was opened from a PadPrefetch), then continues from the already-open
+// file, which the prefetch left positioned right after the buffered bytes.
+// The file is read ahead SD_TRANSFER_BYTES at a time, ending on sector
+// boundaries, so decoder-sized reads never each cost a card command. The
+// read-ahead buffer comes from the owner (setReadAhead()), so voices that
+// are never open together can share one.
+// All SD access goes through sdScheduler.
+class PadReader {
+public:
+  PadReader()
+      : head(NULL), headLen(0), headPos(0), owner(NULL), pos(0), filePos(0),
+        ahead(NULL), aheadLen(0), aheadPos(0), openedUs(0),
+        timingOpen(false) {}
+
+  // SD_TRANSFER_BYTES of read-ahead; set while closed. Without one every
+  // read goes straight to the card.
+  void setReadAhead(uint8_t *buf) {
+    ahead = buf;
+    aheadLen = aheadPos = 0;
+  }
+
+  bool open(const char *path);
+  // Opens an indexed pad at its audio data, checked against the index
+  // (which may correct `pad`, see PadIndex::check)
+  bool openPad(PadLocation *pad);
+  bool openPrefetched(PadPrefetch &prefetch);
+
+  size_t read(uint8_t *dst, size_t len);
+  bool seek(uint32_t pos); // Drops what is left of a prefetched head
+  uint32_t tell() const { return pos; } // File offset of the next read byte
+  bool isOpen() const { return (bool)file; }
+  bool reads(const char *path) const; // See PcmSource::reads()
+  void close();
+
+private:
+  File file;
+  const uint8_t *head;
+  size_t headLen;
+  size_t headPos;
+  PadPrefetch *owner;
+  uint32_t pos;
+
+  uint32_t filePos; // File offset of the next byte read from the card
+  uint8_t *ahead;
+  size_t aheadLen;
+  size_t aheadPos;
+
+  uint32_t openedUs; // micros() at open, for AudioMetrics::openUs
+  bool timingOpen;   // First byte not read yet
+
+  void releaseHead();
+  size_t readFile(uint8_t *dst, size_t len);
+};
+
+// Opens the queued next pad ahead of time: the file is opened (PCM sidecar
+// preferred), headers are skipped and the first AUDIO_PREFETCH_BYTES are
+// read into RAM, a chunk per audio block, so a later Play starts from
+// memory instead of a directory walk and a cold read.
+// Only the audio task touches it.
+class PadPrefetch {
+public:
+  PadPrefetch()
+      : state(PF_EMPTY), hasDeferred(false), pcm(false), start(0), len(0),
+        loop(false), loopFrom(0), loopTo(0) {}
+
+  // Replace whatever is prefetched with `pad`. If a voice is still
+  // draining the buffer the request waits until it is released.
+  void request(const PadLocation &pad, bool preferPcm);
+
+  // Do one chunk of pending work; call once per audio block.
+  void service();
+
+  // True if `path` is prefetched (fully or partly) and can be adopted
+  bool matches(const char *path) const;
+
+  // Close the file and forget a waiting request if they are under `path`
+  // (a file or a folder). A buffer a voice is draining is left to it.
+  void drop(const char *path);
+
+  bool isPcm() const { return pcm; }
+  const PcmCacheHeader &pcmHeader() const { return header; }
+
+  // Loop points from the pad's .loop sidecar, read along with the head
+  bool hasLoop() const { return loop; }
+  uint32_t loopStart() const { return loopFrom; }
+  uint32_t loopEnd() const { return loopTo; }
+
+private:
+  friend class PadReader;
+  enum State { PF_EMPTY, PF_FILLING, PF_READY, PF_IN_USE };
+
+  State state;
+  char path[64];
+  PadLocation deferred;
+  bool deferredPcm;
+  bool hasDeferred;
+
+  File file;
+  bool pcm;
+  PcmCacheHeader header;
+  uint32_t start; // File offset of buf[0]
+  uint8_t buf[AUDIO_PREFETCH_BYTES];
+  size_t len;
+
+  bool loop;
+  uint32_t loopFrom;
+  uint32_t loopTo;
+
+  void begin(const PadLocation &pad, bool preferPcm);
+  void reset();
+  void release(); // Called by the adopting PadReader when it is done
+};
+
+// Reads "<start> <end>" (frames, end 0 = end of file) from the .loop
+// sidecar next to an MP3 pad. Caller holds sdScheduler's lock.
+bool readLoopPoints(const char *mp3Path, uint32_t *start, uint32_t *end);
+
+#endif
@@ -0,0 +1,92 @@
+#include "PcmFileSource.h"
+
+static const char PCM_MAGIC[4] = {'P', 'C', 'M', '1'};
+
+bool PcmFileSource::isValidHeader(const PcmCacheHeader &hdr) {
+  return memcmp(hdr.magic, PCM_MAGIC, sizeof(PCM_MAGIC)) == 0 &&
+         hdr.sampleRate > 0;
+}
+
+void PcmFileSource::fillMagic(PcmCacheHeader &hdr) {
+  memcpy(hdr.magic, PCM_MAGIC, sizeof(PCM_MAGIC));
+}
+
+void PcmFileSource::start(const PcmCacheHeader &hdr) {
+  rate = hdr.sampleRate;
+  framesLeft = hdr.frames;
+  marked = false;
+  opened = true;
+}
+
+bool PcmFileSource::open(const char *path, uint32_t sourceSize) {
+  close();
+  if (!reader.open(path))
+    return false;
+
+  PcmCacheHeader hdr;
+  if (reader.read((uint8_t *)&hdr, sizeof(hdr)) != sizeof(hdr) ||
+      !isValidHeader(hdr) || hdr.sourceSize != sourceSize) {
+    reader.close();
+    return false;
+  }
+  start(hdr);
+  return true;
+}
+
+bool PcmFileSource::open(PadLocation *pad) {
+  close();
+  if (!reader.openPad(pad))
+    return false;
+  // Described after the open, as the check may have corrected it
+  PcmCacheHeader hdr;
+  fillMagic(hdr);
+  hdr.sampleRate = pad->sampleRate;
+  hdr.frames = pad->dataBytes / (2 * sizeof(int16_t));
+  hdr.sourceSize = 0;
+  start(hdr);
+  return true;
+}
+
+bool PcmFileSource::open(PadPrefetch &prefetch) {
+  close();
+  PcmCacheHeader hdr = prefetch.pcmHeader();
+  if (!reader.openPrefetched(prefetch))
+    return false;
+  start(hdr);
+  return true;
+}
+
+void PcmFileSource::close() {
+  reader.close();
+  opened = false;
+}
+
+bool PcmFileSource::mark() {
+  if (!opened)
+    return false;
+  markPos = reader.tell();
+  markFramesLeft = framesLeft;
+  marked = true;
+  return true;
+}
+
+bool PcmFileSource::rewind() {
+  if (!opened || !marked || !reader.seek(markPos))
+    return false;
+  framesLeft = markFramesLeft;
+  return true;
+}
+
+size_t PcmFileSource::read(int16_t *out, size_t frames) {
+  if (!opened)
+    return 0;
+  if (frames > framesLeft)
+    frames = framesLeft;
+  if (frames == 0)
+    return 0;
+
+  size_t got = reader.read((uint8_t *)out, frames * 2 * sizeof(int16_t));
+  got /= 2 * sizeof(int16_t);
+  framesLeft = got < frames ? 0 : framesLeft - got;
+  return got;
+}
@@ -0,0 +1,47 @@
+#ifndef PCM_FILE_SOURCE_H
+#define PCM_FILE_SOURCE_H
+
+#include "PadCache.h"
+#include "PadReader.h"
+#include "PcmSource.h"
+
+// Zero-decode voice: streams a .pcm sidecar, or the data chunk of a WAV pad,
+// straight into the mixer
+class PcmFileSource : public PcmSource {
+public:
+  PcmFileSource()
+      : opened(false), rate(0), framesLeft(0), markPos(0), markFramesLeft(0),
+        marked(false) {}
+
+  // A sidecar, refused unless it was built from an MP3 of `sourceSize`
+  bool open(const char *path, uint32_t sourceSize);
+  bool open(PadPrefetch &prefetch); // Header already read by the prefetch
+  // The data chunk of an indexed WAV pad
+  bool open(PadLocation *pad);
+  void setReadAhead(uint8_t *buf) { reader.setReadAhead(buf); }
+
+  size_t read(int16_t *out, size_t frames) override;
+  uint32_t sampleRate() const override { return rate; }
+  bool isOpen() const override { return opened; }
+  void close() override;
+  bool reads(const char *path) const override { return reader.reads(path); }
+  bool mark() override;
+  bool rewind() override;
+
+  static bool isValidHeader(const PcmCacheHeader &hdr);
+  static void fillMagic(PcmCacheHeader &hdr);
+
+private:
+  PadReader reader;
+  bool opened;
+  uint32_t rate;
+  uint32_t framesLeft;
+
+  uint32_t markPos;
+  uint32_t markFramesLeft;
+  bool marked;
+
+  void start(const PcmCacheHeader &hdr);
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef PCM_SOURCE_H
+#define PCM_SOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A pull-based stream of interleaved 16-bit stereo frames.
+// Kept free of Arduino headers so the mixer can be built on the host.
+class PcmSource {
+public:
+  virtual ~PcmSource() {}
+
+  // Fill up to `frames` stereo frames. Returns frames written, 0 at end.
+  virtual size_t read(int16_t *out, size_t frames) = 0;
+
+  virtual uint32_t sampleRate() const = 0;
+  virtual bool isOpen() const = 0;
+  virtual void close() = 0;
+
+  // Resume point for gapless looping: mark() remembers the current read
+  // position, rewind() jumps back to it without reopening the file or
+  // restarting the decoder. Sources that cannot seek return false.
+  virtual bool mark() { return false; }
+  virtual bool rewind() { return false; }
+
+  // True if the source streams from the file `path`, or from a file in
+  // the folder `path`, so the file manager can wait for it to let go
+  virtual bool reads(const char *path) const { return false; }
+};
+
+#endif
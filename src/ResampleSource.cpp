@@ -0,0 +1,138 @@
+#include "ResampleSource.h"
+#include <math.h>
+#include <string.h>
+
+using polyphase::PHASES;
+using polyphase::TAPS;
+
+// Frames of silence ahead of the first input frame, so the first output
+// frame lands on it (the filter looks TAPS / 2 - 1 frames back)
+static const uint32_t LEAD_FRAMES = TAPS / 2 - 1;
+
+static const uint64_t UNITY_STEP = 1ULL << 32;
+
+static inline int16_t clamp16(int32_t v) {
+  return (int16_t)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+}
+
+uint64_t ResampleSource::stepFor(int semitones) {
+  return (uint64_t)(pow(2.0, semitones / 12.0) * 4294967296.0 + 0.5);
+}
+
+void ResampleSource::begin(PcmSource *source, int semitones) {
+  inner = source;
+  memset(buf, 0, LEAD_FRAMES * 2 * sizeof(int16_t));
+  bufFrames = LEAD_FRAMES;
+  innerDone = false;
+  pos = 0;
+  step = targetStep = stepFor(semitones);
+  stepDelta = 0;
+  glideLeft = 0;
+  targetSemitones = semitones;
+  filter = &polyphase::tableFor(semitones);
+}
+
+void ResampleSource::setPitch(int semitones, uint32_t glideFrames) {
+  int from = targetSemitones;
+  targetStep = stepFor(semitones);
+  targetSemitones = semitones;
+  if (glideFrames == 0) {
+    step = targetStep;
+    glideLeft = 0;
+    filter = &polyphase::tableFor(semitones);
+    return;
+  }
+  stepDelta = ((int64_t)targetStep - (int64_t)step) / (int64_t)glideFrames;
+  glideLeft = glideFrames;
+  filter = &polyphase::tableFor(from > semitones ? from : semitones);
+}
+
+void ResampleSource::close() {
+  if (inner)
+    inner->close();
+  inner = nullptr;
+}
+
+// Drop the frames behind the read position and top up from the inner
+// source. Returns false once the inner source has nothing more.
+bool ResampleSource::refill() {
+  if (innerDone)
+    return false;
+  uint32_t drop = (uint32_t)(pos >> 32);
+  if (drop > bufFrames)
+    drop = bufFrames;
+  memmove(buf, buf + drop * 2, (bufFrames - drop) * 2 * sizeof(int16_t));
+  bufFrames -= drop;
+  pos -= (uint64_t)drop << 32;
+
+  size_t got = inner->read(buf + bufFrames * 2, BUF_FRAMES - bufFrames);
+  if (got == 0) {
+    innerDone = true;
+    return false;
+  }
+  bufFrames += got;
+  return true;
+}
+
+size_t ResampleSource::read(int16_t *out, size_t frames) {
+  if (!inner)
+    return 0;
+
+  size_t n = 0;
+  while (n < frames) {
+    uint32_t idx = (uint32_t)(pos >> 32);
+    if (idx + TAPS > bufFrames) {
+      if (!refill())
+        break;
+      continue;
+    }
+
+    // Root key, on a whole frame: the filter would only delay the input
+    if (step == UNITY_STEP && glideLeft == 0 && (uint32_t)pos == 0) {
+      size_t count = bufFrames - TAPS - idx + 1;
+      if (count > frames - n)
+        count = frames - n;
+      memcpy(out + n * 2, buf + (idx + LEAD_FRAMES) * 2,
+             count * 2 * sizeof(int16_t));
+      n += count;
+      pos += (uint64_t)count << 32;
+      continue;
+    }
+
+    // Phase row and the Q16 weight towards the next row
+    uint32_t phase = (uint32_t)(((pos & 0xffffffffULL) * PHASES) >> 16);
+    const int16_t *c0 = (*filter)[phase >> 16].data();
+    const int16_t *c1 = (*filter)[(phase >> 16) + 1].data();
+    int32_t w = (int32_t)(phase & 0xffff);
+
+    // Taps sum to 1.0 and their magnitudes to < 1.6, so the int32
+    // accumulators cannot overflow on full-scale input
+    const int16_t *x = buf + idx * 2;
+    int32_t l0 = 0, l1 = 0, r0 = 0, r1 = 0;
+    for (int i = 0; i < TAPS; i++) {
+      l0 += x[i * 2] * c0[i];
+      l1 += x[i * 2] * c1[i];
+      r0 += x[i * 2 + 1] * c0[i];
+      r1 += x[i * 2 + 1] * c1[i];
+    }
+    int32_t l = (l0 + (int32_t)((((int64_t)l1 - l0) * w) >> 16)) >> 15;
+    int32_t r = (r0 + (int32_t)((((int64_t)r1 - r0) * w) >> 16)) >> 15;
+    out[n * 2] = clamp16(l);
+    out[n * 2 + 1] = clamp16(r);
+    n++;
+
+    pos += step;
+    if (glideLeft > 0) {
+      if (--glideLeft == 0) {
+        step = targetStep;
+        filter = &polyphase::tableFor(targetSemitones);
+        // Back on the root: round onto a whole frame, so the copy takes
+        // over (half a frame at most, inaudible on a pad)
+        if (step == UNITY_STEP)
+          pos = (pos + (1ULL << 31)) & ~0xffffffffULL;
+      } else
+        step += stepDelta;
+    }
+  }
+  return n;
+}
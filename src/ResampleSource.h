@@ -0,0 +1,156 @@
+#ifndef RESAMPLE_SOURCE_H
+#define RESAMPLE_SOURCE_H
+
+#include "PcmSource.h"
+
+#include <array>
+
+// Polyphase windowed-sinc interpolation, for transposing one root
+// recording into the other keys. The filter banks are generated by the
+// compiler, like the gain curves, so they live in flash with no setup.
+namespace polyphase {
+
+static constexpr int TAPS = 16;   // Input frames per output frame
+static constexpr int PHASES = 32; // Sub-sample positions in the table
+// Transpositions stay within -6..+5 semitones. Going up by k reads the
+// input 2^(k/12) times faster, so everything above 2^(-k/12) of the input
+// Nyquist would alias: each upward step has a table with its passband
+// edge there. Going down nothing aliases, and all of those keys share the
+// widest table. The root key itself skips the filter.
+static constexpr int MAX_UP = 5;
+static constexpr double EDGE = 0.98; // Passband edge, of the alias limit
+static constexpr double SEMITONE_DOWN = 0.94387431268169349664; // 2^(-1/12)
+static constexpr double PI = 3.14159265358979323846;
+
+// sin() for any x: reduced to [-pi/2, pi/2], then a Taylor series
+constexpr double sine(double x) {
+  while (x > PI)
+    x -= 2 * PI;
+  while (x < -PI)
+    x += 2 * PI;
+  if (x > PI / 2)
+    x = PI - x;
+  else if (x < -PI / 2)
+    x = -PI - x;
+  double term = x, sum = x;
+  for (int n = 1; n < 12; n++) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double cosine(double x) { return sine(x + PI / 2); }
+
+// Blackman-windowed sinc at distance `t` (input frames) from the center,
+// passing up to `cutoff` of the input Nyquist
+constexpr double kernel(double t, double cutoff) {
+  double half = TAPS / 2.0;
+  if (t <= -half || t >= half)
+    return 0.0;
+  double w = 0.42 + 0.5 * cosine(PI * t / half) +
+             0.08 * cosine(2 * PI * t / half);
+  double x = PI * cutoff * t;
+  double sinc = (t == 0.0) ? cutoff : sine(x) / (PI * t);
+  return sinc * w;
+}
+
+// Row p holds the taps for an output frame p/PHASES of the way between two
+// input frames. Row PHASES repeats row 0 one frame later, so neighbouring
+// rows can always be interpolated. Each row sums to exactly 1.0 (Q15) so
+// a constant input passes at unity gain whatever the phase.
+using Table = std::array<std::array<int16_t, TAPS>, PHASES + 1>;
+
+constexpr Table makeTable(double cutoff) {
+  Table t{};
+  for (int p = 0; p <= PHASES; p++) {
+    double frac = (double)p / PHASES;
+    double row[TAPS] = {};
+    double sum = 0.0;
+    for (int i = 0; i < TAPS; i++) {
+      row[i] = kernel(i - (TAPS / 2 - 1) - frac, cutoff);
+      sum += row[i];
+    }
+    int total = 0;
+    int peak = 0;
+    for (int i = 0; i < TAPS; i++) {
+      double v = row[i] / sum * 32768.0;
+      t[p][i] = (int16_t)(v < 0 ? v - 0.5 : v + 0.5);
+      total += t[p][i];
+      if (t[p][i] > t[p][peak])
+        peak = i;
+    }
+    t[p][peak] += 32768 - total; // Rounding error onto the center tap
+  }
+  return t;
+}
+
+// tables[k]: for k semitones up; tables[0] also for every key down
+constexpr std::array<Table, MAX_UP + 1> makeTables() {
+  std::array<Table, MAX_UP + 1> t{};
+  double limit = 1.0;
+  for (int k = 0; k <= MAX_UP; k++) {
+    t[k] = makeTable(EDGE * limit);
+    limit *= SEMITONE_DOWN;
+  }
+  return t;
+}
+
+static constexpr std::array<Table, MAX_UP + 1> tables = makeTables();
+
+constexpr const Table &tableFor(int semitones) {
+  return tables[semitones <= 0 ? 0 : (semitones > MAX_UP ? MAX_UP : semitones)];
+}
+
+} // namespace polyphase
+
+// Plays another source transposed by a number of semitones. The pitch can
+// glide to a new value mid-stream (a key change on the same root file), so
+// the voice keeps playing and nothing is reopened. At 0 semitones the
+// frames are copied through untouched.
+//
+// Plain C++, like AudioMixer.
+class ResampleSource : public PcmSource {
+public:
+  ResampleSource() : inner(nullptr) {}
+
+  void begin(PcmSource *source, int semitones);
+
+  // Move to `semitones` over `glideFrames` output frames
+  void setPitch(int semitones, uint32_t glideFrames);
+
+  size_t read(int16_t *out, size_t frames) override;
+  uint32_t sampleRate() const override {
+    return inner ? inner->sampleRate() : 0;
+  }
+  bool isOpen() const override { return inner && inner->isOpen(); }
+  void close() override;
+  bool reads(const char *path) const override {
+    return inner && inner->reads(path);
+  }
+
+private:
+  static const uint32_t CHUNK_FRAMES = 256;
+  static const uint32_t BUF_FRAMES = polyphase::TAPS + CHUNK_FRAMES;
+
+  PcmSource *inner;
+  int16_t buf[BUF_FRAMES * 2];
+  uint32_t bufFrames; // Valid frames in buf
+  bool innerDone;
+
+  // Read position in buf, 32.32 fixed point: the output frame sits
+  // between buf[pos >> 32] and the frame after it (plus the filter span)
+  uint64_t pos;
+  uint64_t step; // Input frames per output frame, 32.32
+  uint64_t targetStep;
+  int64_t stepDelta;
+  uint32_t glideLeft;
+  int targetSemitones;
+  // Filter bank in use; during a glide, the one for the higher end
+  const polyphase::Table *filter;
+
+  static uint64_t stepFor(int semitones);
+  bool refill();
+};
+
+#endif
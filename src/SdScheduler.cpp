@@ -0,0 +1,72 @@
+#include "SdScheduler.h"
+
+SdScheduler sdScheduler;
+
+// How long a background slice waits for something it cannot see coming
+// (the audio task releasing the card or queueing blocks) before looking
+// again, in case the wake-up went to another waiting slice
+static const uint32_t RECHECK_US = 1000;
+
+void SdScheduler::begin() {
+  mutex = xSemaphoreCreateMutex();
+  gate = xSemaphoreCreateBinary();
+}
+
+uint32_t SdScheduler::backgroundWaitUs(uint32_t now) const {
+  if (audioWaiting)
+    return RECHECK_US;
+  int queued = audioQueued;
+  if (queued < 0)
+    return 0; // Nothing playing
+  if (queued < SD_AUDIO_RESERVE_BLOCKS)
+    return RECHECK_US;
+  int32_t early = (int32_t)(nextSliceUs - now);
+  return early > 0 ? (uint32_t)early : 0;
+}
+
+void SdScheduler::lock() {
+  if (isAudio()) {
+    audioWaiting = true; // Holds back slices not yet on the card
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    audioWaiting = false;
+    return;
+  }
+
+  while (true) {
+    uint32_t waitUs = backgroundWaitUs(micros());
+    if (waitUs == 0) {
+      xSemaphoreTake(mutex, portMAX_DELAY);
+      if (!audioWaiting)
+        break;
+      // The audio task asked while this slice waited for the card: it
+      // goes first
+      xSemaphoreGive(mutex);
+      continue;
+    }
+    TickType_t ticks = pdMS_TO_TICKS((waitUs + 999) / 1000);
+    xSemaphoreTake(gate, ticks > 0 ? ticks : 1);
+  }
+  sliceStartUs = micros();
+}
+
+void SdScheduler::unlock() {
+  if (isAudio()) {
+    xSemaphoreGive(mutex);
+    xSemaphoreGive(gate);
+    return;
+  }
+  // The next slice waits long enough to keep this one's share of the time
+  uint32_t now = micros();
+  uint32_t held = now - sliceStartUs;
+  nextSliceUs = now + (uint32_t)((uint64_t)held *
+                                 (100 - SD_BACKGROUND_DUTY_PCT) /
+                                 SD_BACKGROUND_DUTY_PCT);
+  xSemaphoreGive(mutex);
+}
+
+void SdScheduler::setAudioQueued(int blocks) {
+  bool wasShort = audioQueued >= 0 && audioQueued < SD_AUDIO_RESERVE_BLOCKS;
+  audioQueued = blocks;
+  if (wasShort && (blocks < 0 || blocks >= SD_AUDIO_RESERVE_BLOCKS))
+    xSemaphoreGive(gate);
+}
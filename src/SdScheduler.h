@@ -0,0 +1,55 @@
+#ifndef SD_SCHEDULER_H
+#define SD_SCHEDULER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "Config.h"
+
+// Access to the SD card, which the audio task shares with the file
+// manager, the index scan and the PCM cache. Everyone brackets each card
+// operation with lock() and unlock(); the caller's task picks its class:
+//
+//   audio       the audio task. Next in line whenever it asks: it waits
+//               at most for the background slice already on the card.
+//   background  everyone else, in short slices (an entry, a file, one
+//               upload batch). While a pad plays, a slice only starts
+//               with SD_AUDIO_RESERVE_BLOCKS blocks queued to I2S, so the
+//               ring can ride out the slice, and slices are spaced to
+//               hold the card at most SD_BACKGROUND_DUTY_PCT of the time,
+//               so the audio task's reads keep the rest of the bandwidth.
+//
+// With nothing playing, background slices run back to back.
+class SdScheduler {
+public:
+  SdScheduler()
+      : mutex(NULL), gate(NULL), audioTask(NULL), audioWaiting(false),
+        audioQueued(-1), sliceStartUs(0), nextSliceUs(0) {}
+
+  void begin();
+  void setAudioTask(TaskHandle_t task) { audioTask = task; }
+
+  void lock();
+  void unlock();
+
+  // Audio task, after each block: blocks queued to I2S, -1 when idle
+  void setAudioQueued(int blocks);
+
+private:
+  SemaphoreHandle_t mutex; // The card itself
+  SemaphoreHandle_t gate;  // Given when a waiting slice may be able to go
+  TaskHandle_t audioTask;
+  volatile bool audioWaiting;
+  volatile int audioQueued;
+  uint32_t sliceStartUs; // Background slice holding the card
+  volatile uint32_t nextSliceUs; // Pacing: no background slice before this
+
+  bool isAudio() const { return xTaskGetCurrentTaskHandle() == audioTask; }
+  uint32_t backgroundWaitUs(uint32_t now) const; // 0 = may start now
+};
+
+extern SdScheduler sdScheduler;
+
+#endif
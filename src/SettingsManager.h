@@ -11,6 +11,11 @@ struct SystemSettings {
   int currentPresetIndex;
   int screenBrightness;
   bool isDarkMode;
+  bool usePcmCache; // Decode banks once to PCM sidecars and play those
+  bool loopPads;    // Pads loop gaplessly instead of stopping at the end
+  String layerBank; // Second layer's bank folder, "" = off
+  int layerLevel;   // Second layer level, 0-100 %
+  bool layerMute;
 };
 
 class SettingsManager {
@@ -36,6 +41,11 @@ public:
     s.currentPresetIndex = prefs.getInt("preset", 0);
     s.screenBrightness = prefs.getInt("bright", 255);
     s.isDarkMode = prefs.getBool("theme", true);
+    s.usePcmCache = prefs.getBool("pcm", false);
+    s.loopPads = prefs.getBool("loop", true);
+    s.layerBank = prefs.getString("l2bank", "");
+    s.layerLevel = prefs.getInt("l2lvl", 100);
+    s.layerMute = prefs.getBool("l2mute", false);
 
     currentSettings = s;
     return s;
@@ -54,6 +64,16 @@ public:
       prefs.putInt("bright", s.screenBrightness);
     if (s.isDarkMode != currentSettings.isDarkMode)
       prefs.putBool("theme", s.isDarkMode);
+    if (s.usePcmCache != currentSettings.usePcmCache)
+      prefs.putBool("pcm", s.usePcmCache);
+    if (s.loopPads != currentSettings.loopPads)
+      prefs.putBool("loop", s.loopPads);
+    if (s.layerBank != currentSettings.layerBank)
+      prefs.putString("l2bank", s.layerBank);
+    if (s.layerLevel != currentSettings.layerLevel)
+      prefs.putInt("l2lvl", s.layerLevel);
+    if (s.layerMute != currentSettings.layerMute)
+      prefs.putBool("l2mute", s.layerMute);
 
     currentSettings = s;
   }
@@ -1,21 +1,43 @@
 #include "UI_Logic.h"
 #include "Config.h"
-
-UI_Controller::UI_Controller() : tft() { sprite = new TFT_eSprite(&tft); }
+#include "KeyGlyphs.h"
+#include "LevelRing.h"
+#include <math.h>
+
+// Internal RAM, so the SPI DMA can read it
+static uint16_t dmaBuf[2][UI_DMA_BUF_PIXELS];
+
+UI_Controller::UI_Controller()
+    : tft(), requests(NULL), task(NULL), darkTheme(true), frame(),
+      band(), layingOut(false), frameCount(0), shownCount(0), frameScreen(SCREEN_OTHER), shownScreen(SCREEN_OTHER),
+      dmaNext(0), meterLevel(0), meterPeak(0), meterMs(0) {
+  sprite = new TFT_eSprite(&tft);
+  setColors(true); // Default Theme (Dark)
+  for (int i = 0; i < METER_SEGMENTS; i++)
+    meterBoxes[i] = meterSegmentBox(i);
+}
 
 void UI_Controller::init() {
   tft.init();
   tft.setRotation(0);
   tft.fillScreen(TFT_BLACK); // Initial clear
 
-  // Create a 240x240 sprite for full screen update
-  sprite->createSprite(240, 240);
+  // One band of the screen, not all of it: 8 KB instead of 113
+  sprite->createSprite(UI_SCREEN_WIDTH, UI_BAND_ROWS);
 
-  // Default Theme (Dark)
-  applyTheme(true);
+  // The render task keeps the bus for good: nothing else is on it
+  tft.initDMA();
+  tft.startWrite();
+
+  requests = xQueueCreate(1, sizeof(Request));
+  // Core 1 next to the UI loop, at its priority: it time-slices with input
+  // polling instead of holding it up for a whole frame
+  xTaskCreatePinnedToCore(taskEntry, "UIRender", 4096, this, 1, &task, 1);
 }
 
-void UI_Controller::applyTheme(bool isDark) {
+void UI_Controller::applyTheme(bool isDark) { darkTheme = isDark; }
+
+void UI_Controller::setColors(bool isDark) {
   if (isDark) {
     colorBg = TFT_BLACK;
     colorText = TFT_WHITE;
@@ -29,6 +51,131 @@ void UI_Controller::applyTheme(bool isDark) {
     colorHill = 0xC618;             // Light Grey
     colorHighlight = TFT_DARKGREEN; // Darker green for contrast on white
   }
+  colorsDark = isDark;
+  shownScreen = SCREEN_OTHER; // Every pixel changes colour
+}
+
+// RENDER TASK
+void UI_Controller::post(Request &req) {
+  req.dark = darkTheme;
+  if (requests)
+    xQueueOverwrite(requests, &req);
+}
+
+void UI_Controller::drawPerformance(const char *currentKey, const char *nextKey,
+                                    const char *presetName, int volume,
+                                    int fadeTimeMs, bool useCrossfade) {
+  Request req = {};
+  req.screen = SCREEN_PERFORMANCE;
+  snprintf(req.text[0], sizeof(req.text[0]), "%s", currentKey);
+  snprintf(req.text[1], sizeof(req.text[1]), "%s", nextKey);
+  snprintf(req.text[2], sizeof(req.text[2]), "%s", presetName);
+  req.volume = volume;
+  req.fadeTimeMs = fadeTimeMs;
+  req.useCrossfade = useCrossfade;
+  post(req);
+}
+
+void UI_Controller::drawMenu(int selectedIndex, bool isEditing, int fadeTimeMs,
+                             bool useCrossfade, bool isDark, int brightness,
+                             bool usePcmCache, bool loopPads,
+                             const char *layerBank, int layerLevel,
+                             bool layerMute) {
+  Request req = {};
+  req.screen = SCREEN_MENU;
+  req.selectedIndex = selectedIndex;
+  req.isEditing = isEditing;
+  req.fadeTimeMs = fadeTimeMs;
+  req.useCrossfade = useCrossfade;
+  req.isDark = isDark;
+  req.brightness = brightness;
+  req.usePcmCache = usePcmCache;
+  req.loopPads = loopPads;
+  snprintf(req.text[0], sizeof(req.text[0]), "%s", layerBank);
+  req.layerLevel = layerLevel;
+  req.layerMute = layerMute;
+  post(req);
+}
+
+void UI_Controller::drawWifiScreen(const char *ssid, const char *ip) {
+  Request req = {};
+  req.screen = SCREEN_WIFI;
+  snprintf(req.text[0], sizeof(req.text[0]), "%s", ssid);
+  snprintf(req.text[1], sizeof(req.text[1]), "%s", ip);
+  post(req);
+}
+
+void UI_Controller::showSplashScreen() {
+  Request req = {};
+  req.screen = SCREEN_SPLASH;
+  post(req);
+}
+
+void UI_Controller::showErrorScreen(const char *errorMessage) {
+  Request req = {};
+  req.screen = SCREEN_ERROR;
+  snprintf(req.text[0], sizeof(req.text[0]), "%s", errorMessage);
+  post(req);
+}
+
+void UI_Controller::taskEntry(void *param) {
+  UI_Controller *self = static_cast<UI_Controller *>(param);
+  Request req;
+  while (true) {
+    // Wakes once a frame without a request, for the meter
+    if (xQueueReceive(self->requests, &req, pdMS_TO_TICKS(UI_FRAME_MS)) ==
+        pdTRUE)
+      self->render(req);
+    self->updateMeter();
+  }
+}
+
+void UI_Controller::render(const Request &req) {
+  if (req.dark != colorsDark)
+    setColors(req.dark);
+  frame = req;
+  if (req.screen != SCREEN_PERFORMANCE && req.screen != SCREEN_MENU) {
+    pushFull();
+    return;
+  }
+
+  // Lay the frame out for pushFrame(); a viewport off the sprite keeps
+  // the drawing calls from touching it
+  beginFrame(req.screen);
+  layingOut = true;
+  sprite->setViewport(0, 0, 0, 0);
+  drawFrame();
+  sprite->resetViewport();
+  layingOut = false;
+  pushFrame();
+}
+
+void UI_Controller::drawFrame() {
+  switch (frame.screen) {
+  case SCREEN_PERFORMANCE:
+    renderPerformance(frame);
+    break;
+  case SCREEN_MENU:
+    renderMenu(frame);
+    break;
+  case SCREEN_WIFI:
+    renderWifiScreen(frame);
+    break;
+  case SCREEN_SPLASH:
+    renderSplashScreen();
+    break;
+  case SCREEN_ERROR:
+    renderErrorScreen(frame);
+    break;
+  default:
+    break;
+  }
+}
+
+// Whether something in `r` has to be drawn for the band (never while
+// laying out)
+bool UI_Controller::inBand(const Rect &r) const {
+  return !layingOut && overlaps(r, band);
 }
 
 void UI_Controller::drawConvexBackground() {
@@ -46,96 +193,391 @@ void UI_Controller::drawText(const char *text, int x, int y, uint8_t font,
   sprite->drawString(text, x, y);
 }
 
+// DIRTY REGIONS
+UI_Controller::Rect UI_Controller::unite(const Rect &a, const Rect &b) {
+  int16_t x0 = min(a.x, b.x), y0 = min(a.y, b.y);
+  int16_t x1 = max(a.x + a.w, b.x + b.w), y1 = max(a.y + a.h, b.y + b.h);
+  return {x0, y0, (int16_t)(x1 - x0), (int16_t)(y1 - y0)};
+}
+
+bool UI_Controller::overlaps(const Rect &a, const Rect &b) {
+  return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h &&
+         b.y < a.y + a.h;
+}
+
+void UI_Controller::beginFrame(Screen screen) {
+  frameScreen = screen;
+  frameCount = 0;
+}
+
+void UI_Controller::placeText(const char *text, int x, int y, uint8_t font,
+                              uint8_t size, uint16_t color, uint8_t datum) {
+  sprite->setTextSize(size);
+
+  // Datums run TL, TC, TR, ML, MC, MR, BL, BC, BR
+  int w = sprite->textWidth(text, font);
+  int h = sprite->fontHeight(font);
+  int left = x - (datum % 3 == 1 ? w / 2 : datum % 3 == 2 ? w : 0);
+  int top = y - (datum / 3 == 1 ? h / 2 : datum / 3 == 2 ? h : 0);
+  if (layingOut) {
+    track(text, color, left, top, w, h);
+  } else if (inBand({(int16_t)(left - 2), (int16_t)(top - 2),
+                     (int16_t)(w + 4), (int16_t)(h + 4)})) {
+    sprite->setTextColor(color);
+    sprite->setTextDatum(datum);
+    sprite->drawString(text, x, y, font);
+  }
+  sprite->setTextSize(1);
+}
+
+// The big key name from the glyph atlas: a letter, and a sharp beside it.
+// Coverage is blended towards the background, which is plain where the key
+// sits. Anything the atlas lacks falls back to font 4.
+void UI_Controller::placeKey(const char *key, int x, int y, uint16_t color) {
+  const keyglyphs::Glyph *glyphs[2] = {};
+  int count = 0, width = 0;
+  for (const char *c = key; *c; c++) {
+    const keyglyphs::Glyph *g = keyglyphs::find(*c);
+    if (!g || count == 2) {
+      placeText(key, x, y, 4, 3, color, MC_DATUM);
+      return;
+    }
+    // Glyphs overlap by one margin, so a sharp sits close to its letter
+    width += g->width - (count ? (int)keyglyphs::MARGIN : 0);
+    glyphs[count++] = g;
+  }
+
+  int left = x - width / 2;
+  int top = y - keyglyphs::CELL_H / 2;
+  if (layingOut) {
+    track(key, color, left, top, width, keyglyphs::CELL_H);
+    return;
+  }
+  if (!inBand({(int16_t)left, (int16_t)top, (int16_t)width,
+               (int16_t)keyglyphs::CELL_H}))
+    return;
+
+  uint16_t shade[16];
+  for (int a = 0; a < 16; a++)
+    shade[a] = sprite->alphaBlend(a * 17, color, colorBg);
+
+  int gx = left;
+  for (int i = 0; i < count; i++) {
+    const keyglyphs::Glyph &g = *glyphs[i];
+    for (int row = 0; row < keyglyphs::CELL_H; row++) {
+      for (int col = 0; col < g.width; col++) {
+        uint8_t a = keyglyphs::alphaAt(g, col, row);
+        if (a)
+          sprite->drawPixel(gx + col, top + row, shade[a]);
+      }
+    }
+    gx += g.width - (int)keyglyphs::MARGIN;
+  }
+}
+
+// Record a string drawn at (left, top), w x h, for pushFrame()
+void UI_Controller::track(const char *text, uint16_t color, int left,
+                          int top, int w, int h) {
+  if (frameCount >= MAX_TEXT_ITEMS) {
+    frameScreen = SCREEN_OTHER; // Not tracked: push it all
+    return;
+  }
+  // A 2 px margin covers glyphs that reach past their cell
+  int right = min(left + w + 2, UI_SCREEN_WIDTH);
+  int bottom = min(top + h + 2, UI_SCREEN_HEIGHT);
+  left = max(left - 2, 0);
+  top = max(top - 2, 0);
+
+  TextItem &item = frameItems[frameCount++];
+  snprintf(item.text, sizeof(item.text), "%s", text);
+  item.color = color;
+  item.box = {(int16_t)left, (int16_t)top, (int16_t)max(right - left, 0),
+              (int16_t)max(bottom - top, 0)};
+}
+
+void UI_Controller::pushFrame() {
+  bool full = frameScreen == SCREEN_OTHER || frameScreen != shownScreen ||
+              frameCount != shownCount;
+
+  Rect dirty[MAX_TEXT_ITEMS];
+  int dirtyCount = 0;
+  for (int i = 0; i < frameCount && !full; i++) {
+    const TextItem &now = frameItems[i];
+    const TextItem &was = shownItems[i];
+    if (now.color == was.color && !strcmp(now.text, was.text) &&
+        !memcmp(&now.box, &was.box, sizeof(Rect)))
+      continue;
+
+    // One window per patch of screen: fold in every box this one touches
+    Rect r = unite(now.box, was.box);
+    for (int j = 0; j < dirtyCount;) {
+      if (overlaps(r, dirty[j])) {
+        r = unite(r, dirty[j]);
+        dirty[j] = dirty[--dirtyCount];
+        j = 0;
+      } else {
+        j++;
+      }
+    }
+    dirty[dirtyCount++] = r;
+  }
+
+  // Past half the panel, one window costs less than many
+  int32_t area = 0;
+  for (int i = 0; i < dirtyCount; i++)
+    area += (int32_t)dirty[i].w * dirty[i].h;
+  if (area * 2 > (int32_t)UI_SCREEN_WIDTH * UI_SCREEN_HEIGHT)
+    full = true;
+
+  if (full) {
+    pushWindow({0, 0, UI_SCREEN_WIDTH, UI_SCREEN_HEIGHT});
+    // The frame carried the meter: its next step waits for the next frame
+    meterMs = millis();
+  } else {
+    for (int i = 0; i < dirtyCount; i++) {
+      if (dirty[i].w > 0 && dirty[i].h > 0)
+        pushWindow(dirty[i]);
+    }
+  }
+
+  memcpy(shownItems, frameItems, frameCount * sizeof(TextItem));
+  shownCount = frameCount;
+  shownScreen = frameScreen;
+}
+
+void UI_Controller::pushFull() {
+  pushWindow({0, 0, UI_SCREEN_WIDTH, UI_SCREEN_HEIGHT});
+  shownScreen = SCREEN_OTHER;
+}
+
+// Rows of the window go out a buffer at a time. Each band is drawn into
+// the sprite through a viewport that clips to it and moves its corner to
+// the sprite's, then copied to a buffer. pushImageDMA() waits for the
+// transfer before it, so each buffer is filled while the other one is on
+// the wire, and is free again by the time its turn comes back. The last
+// transfer is left running: the next frame is drawn meanwhile.
+void UI_Controller::pushWindow(const Rect &r) {
+  const uint16_t *fb = (const uint16_t *)sprite->getPointer();
+  int stride = sprite->width();
+  int rowsPerBuf = constrain(UI_DMA_BUF_PIXELS / r.w, 1, UI_BAND_ROWS);
+
+  for (int row = 0; row < r.h; row += rowsPerBuf) {
+    int rows = min(rowsPerBuf, r.h - row);
+    band = {r.x, (int16_t)(r.y + row), r.w, (int16_t)rows};
+    sprite->setViewport(-band.x, -band.y, band.x + band.w, band.y + band.h);
+    drawFrame();
+
+    uint16_t *buf = dmaBuf[dmaNext];
+    dmaNext ^= 1;
+    for (int i = 0; i < rows; i++)
+      memcpy(buf + i * r.w, fb + i * stride, r.w * sizeof(uint16_t));
+    tft.pushImageDMA(r.x, band.y, r.w, rows, buf);
+  }
+  sprite->resetViewport();
+}
+
 // PERFORMANCE VIEW
-void UI_Controller::drawPerformance(const char *currentKey, const char *nextKey,
-                                    const char *presetName, int volume,
-                                    int fadeTimeMs, bool useCrossfade) {
+void UI_Controller::renderPerformance(const Request &req) {
   drawConvexBackground();
 
+  // Level meter as it is on the panel; updateMeter() moves it on
+  for (int i = 0; i < METER_SEGMENTS; i++) {
+    if (inBand(meterBoxes[i]))
+      drawMeterSegment(i, meterColor(i, meterLevel, meterPeak));
+  }
+
   // Current Key (Large, center top)
-  sprite->setTextSize(3);
-  sprite->setTextColor(colorText);
-  sprite->setTextDatum(MC_DATUM);
-  sprite->drawString(currentKey, 120, 80, 4);
-  sprite->setTextSize(1); // Reset
+  placeKey(req.text[0], 120, 80, colorText);
 
   // Preset Name (Small, above Key)
-  sprite->setTextColor(colorAccent);
-  sprite->drawString(presetName, 120, 40, 2);
+  placeText(req.text[2], 120, 40, 2, 1, colorAccent, MC_DATUM);
 
   // Next Key (Bottom area)
-  char nextBuffer[32];
-  snprintf(nextBuffer, sizeof(nextBuffer), "NEXT: %s", nextKey);
-  sprite->setTextColor(colorText);
-  sprite->drawString(nextBuffer, 120, 170, 2);
+  char nextBuffer[sizeof("NEXT: ") + sizeof(req.text[1])];
+  snprintf(nextBuffer, sizeof(nextBuffer), "NEXT: %s", req.text[1]);
+  placeText(nextBuffer, 120, 170, 2, 1, colorText, MC_DATUM);
 
   // Params (Volume)
   char volBuffer[16];
-  snprintf(volBuffer, sizeof(volBuffer), "VOL: %d", volume);
-  sprite->setTextColor(colorText);
-  sprite->drawString(volBuffer, 60, 200, 2);
+  snprintf(volBuffer, sizeof(volBuffer), "VOL: %d", req.volume);
+  placeText(volBuffer, 60, 200, 2, 1, colorText, MC_DATUM);
 
   // Fade Time (Small info)
   char fadeBuffer[16];
-  snprintf(fadeBuffer, sizeof(fadeBuffer), "%ds", fadeTimeMs / 1000);
-  sprite->drawString(fadeBuffer, 180, 200, 2);
+  snprintf(fadeBuffer, sizeof(fadeBuffer), "%ds", req.fadeTimeMs / 1000);
+  placeText(fadeBuffer, 180, 200, 2, 1, colorText, MC_DATUM);
 
   // Transition Mode icon/text
-  const char *transText = useCrossfade ? "XFADE" : "CUT";
-  sprite->drawString(transText, 120, 215, 2);
+  const char *transText = req.useCrossfade ? "XFADE" : "CUT";
+  placeText(transText, 120, 215, 2, 1, colorText, MC_DATUM);
+}
 
-  sprite->pushSprite(0, 0);
+// LEVEL METER
+// Segments run clockwise from lower left, over the top, to lower right,
+// clear of the hill. TFT_eSPI arc angles: 0 at 6 o'clock, clockwise.
+static const int METER_X = 120, METER_Y = 120;
+static const int METER_R = 119, METER_IR = 113;
+static const int METER_START = 60; // Degrees
+static const int METER_STEP = 6;   // Per segment: 5 lit, 1 gap
+static const float METER_RANGE_DB = 60.0f;
+
+// Segments lit by a level of 0-32767, over the bottom METER_RANGE_DB
+static int meterSegmentsFor(uint16_t level, int segments) {
+  if (level == 0)
+    return 0;
+  float db = 20.0f * log10f(level / 32767.0f);
+  int n = (int)((db + METER_RANGE_DB) / METER_RANGE_DB * segments + 0.5f);
+  return n < 0 ? 0 : (n > segments ? segments : n);
+}
+
+void UI_Controller::updateMeter() {
+  uint32_t now = millis();
+  if (now - meterMs < UI_FRAME_MS)
+    return;
+  meterMs = now;
+
+  uint16_t rms = 0, peak = 0;
+  LevelReading r;
+  while (levelRing.pop(&r)) {
+    rms = max(rms, r.rms);
+    peak = max(peak, r.peak);
+  }
+  int level = max(meterSegmentsFor(rms, METER_SEGMENTS), meterLevel - 1);
+  int peakAt = max(meterSegmentsFor(peak, METER_SEGMENTS), meterPeak - 1);
+
+  bool changed[METER_SEGMENTS];
+  for (int i = 0; i < METER_SEGMENTS; i++)
+    changed[i] = meterColor(i, level, peakAt) !=
+                 meterColor(i, meterLevel, meterPeak);
+  meterLevel = level;
+  meterPeak = peakAt;
+
+  // Off screen the state still moves, and the next frame draws it
+  if (shownScreen == SCREEN_PERFORMANCE) {
+    for (int i = 0; i < METER_SEGMENTS; i++) {
+      if (changed[i])
+        pushWindow(meterBoxes[i]); // Redrawn from the new state
+    }
+  }
+}
+
+uint16_t UI_Controller::meterColor(int segment, int level, int peak) const {
+  if (segment < level)
+    return colorHighlight;
+  if (segment == peak - 1)
+    return colorAccent;
+  return colorHill;
+}
+
+void UI_Controller::drawMeterSegment(int segment, uint16_t color) {
+  int start = METER_START + segment * METER_STEP;
+  sprite->drawArc(METER_X, METER_Y, METER_R, METER_IR, start,
+                  start + METER_STEP - 1, color, colorBg, true);
+}
+
+// Bounds of a segment: its ends and middle on both edges, plus the
+// anti-aliased fringe
+UI_Controller::Rect UI_Controller::meterSegmentBox(int segment) const {
+  static const float RAD = 3.14159265f / 180;
+  int start = METER_START + segment * METER_STEP;
+  float angles[3] = {(float)start, start + (METER_STEP - 1) / 2.0f,
+                     (float)(start + METER_STEP - 1)};
+  int x0 = METER_X, y0 = METER_Y, x1 = METER_X, y1 = METER_Y;
+  bool first = true;
+  for (float a : angles) {
+    for (int radius : {METER_R, METER_IR}) {
+      int x = (int)floorf(METER_X - radius * sinf(a * RAD));
+      int y = (int)floorf(METER_Y + radius * cosf(a * RAD));
+      x0 = first ? x : min(x0, x);
+      y0 = first ? y : min(y0, y);
+      x1 = first ? x : max(x1, x);
+      y1 = first ? y : max(y1, y);
+      first = false;
+    }
+  }
+  x0 = max(x0 - 1, 0);
+  y0 = max(y0 - 1, 0);
+  x1 = min(x1 + 2, UI_SCREEN_WIDTH);
+  y1 = min(y1 + 2, UI_SCREEN_HEIGHT);
+  return {(int16_t)x0, (int16_t)y0, (int16_t)(x1 - x0), (int16_t)(y1 - y0)};
 }
 
 // Menu Labels (Global or Static)
-const char *MENU_LABELS[MENU_COUNT] = {"Fade Time", "Trans.",    "Theme",
-                                       "Bright",    "Wi-Fi Mgr", "Return"};
+const char *MENU_LABELS[MENU_COUNT] = {
+    "Fade Time", "Trans.",   "Theme",   "Bright",    "PCM Cache", "Loop",
+    "Layer 2",   "L2 Level", "L2 Mute", "Wi-Fi Mgr", "Return"};
+
+// Rows that fit between the header and the bottom of the round panel
+static const int MENU_VISIBLE_ROWS = 8;
 
 // MENU VIEW
-void UI_Controller::drawMenu(int selectedIndex, bool isEditing, int fadeTimeMs,
-                             bool useCrossfade, bool isDark, int brightness) {
+void UI_Controller::renderMenu(const Request &req) {
   sprite->fillSprite(colorBg);
 
   // Header
-  sprite->setTextColor(colorAccent);
-  sprite->setTextSize(1);
-  sprite->setTextDatum(MC_DATUM);
-  sprite->drawString("- SETTINGS -", 120, 25, 2);
+  placeText("- SETTINGS -", 120, 25, 2, 1, colorAccent, MC_DATUM);
 
   // List Items
-  const int startY = 60;
-  const int gapY = 28;
+  const int startY = 45;
+  const int gapY = 22;
 
-  for (int i = 0; i < MENU_COUNT; i++) {
-    int y = startY + (i * gapY);
+  // Scroll so the selection stays on screen
+  int first = req.selectedIndex - MENU_VISIBLE_ROWS / 2;
+  if (first > MENU_COUNT - MENU_VISIBLE_ROWS)
+    first = MENU_COUNT - MENU_VISIBLE_ROWS;
+  if (first < 0)
+    first = 0;
+
+  for (int i = first; i < MENU_COUNT && i < first + MENU_VISIBLE_ROWS; i++) {
+    int y = startY + ((i - first) * gapY);
 
     // Color Logic
     uint16_t itemColor = colorText;
-    if (i == selectedIndex) {
+    if (i == req.selectedIndex) {
       itemColor = colorHighlight;
-      if (isEditing)
+      if (req.isEditing)
         itemColor = TFT_RED;
     }
 
-    sprite->setTextColor(itemColor);
-    sprite->setTextDatum(MR_DATUM);
-    sprite->drawString(MENU_LABELS[i], 110, y, 2);
+    placeText(MENU_LABELS[i], 110, y, 2, 1, itemColor, MR_DATUM);
 
     // Value Draw
     char valBuffer[32] = "";
     switch (i) {
     case MENU_FADE_TIME:
-      snprintf(valBuffer, sizeof(valBuffer), "%ds", fadeTimeMs / 1000);
+      snprintf(valBuffer, sizeof(valBuffer), "%ds", req.fadeTimeMs / 1000);
       break;
     case MENU_TRANSITION:
       snprintf(valBuffer, sizeof(valBuffer), "%s",
-               useCrossfade ? "XFade" : "Cut");
+               req.useCrossfade ? "XFade" : "Cut");
       break;
     case MENU_THEME:
-      snprintf(valBuffer, sizeof(valBuffer), "%s", isDark ? "Dark" : "Light");
+      snprintf(valBuffer, sizeof(valBuffer), "%s",
+               req.isDark ? "Dark" : "Light");
       break;
     case MENU_BRIGHTNESS:
-      snprintf(valBuffer, sizeof(valBuffer), "%d%%", (brightness * 100) / 255);
+      snprintf(valBuffer, sizeof(valBuffer), "%d%%",
+               (req.brightness * 100) / 255);
+      break;
+    case MENU_PCM_CACHE:
+      snprintf(valBuffer, sizeof(valBuffer), "%s",
+               req.usePcmCache ? "On" : "Off");
+      break;
+    case MENU_LOOP:
+      snprintf(valBuffer, sizeof(valBuffer), "%s", req.loopPads ? "On" : "Off");
+      break;
+    case MENU_LAYER_BANK:
+      // Long folder names are cut to the value column
+      snprintf(valBuffer, sizeof(valBuffer), "%.*s",
+               (int)sizeof(valBuffer) - 1,
+               req.text[0][0] ? req.text[0] : "Off");
+      break;
+    case MENU_LAYER_LEVEL:
+      snprintf(valBuffer, sizeof(valBuffer), "%d%%", req.layerLevel);
+      break;
+    case MENU_LAYER_MUTE:
+      snprintf(valBuffer, sizeof(valBuffer), "%s",
+               req.layerMute ? "On" : "Off");
       break;
     // Wi-Fi and Return have dynamic "action" text or can use fixed text
     case MENU_WIFI:
@@ -146,15 +588,12 @@ void UI_Controller::drawMenu(int selectedIndex, bool isEditing, int fadeTimeMs,
       break;
     }
 
-    sprite->setTextDatum(ML_DATUM);
-    sprite->drawString(valBuffer, 130, y, 2);
+    placeText(valBuffer, 130, y, 2, 1, itemColor, ML_DATUM);
   }
-
-  sprite->pushSprite(0, 0);
 }
 
 // WIFI SCREEN
-void UI_Controller::drawWifiScreen(const char *ssid, const char *ip) {
+void UI_Controller::renderWifiScreen(const Request &req) {
   sprite->fillSprite(TFT_BLACK); // Always Dark for tech mode
 
   sprite->setTextDatum(MC_DATUM);
@@ -169,23 +608,21 @@ void UI_Controller::drawWifiScreen(const char *ssid, const char *ip) {
   sprite->setTextColor(TFT_WHITE);
   sprite->setTextSize(1);
 
-  char ssidBuf[64];
-  snprintf(ssidBuf, sizeof(ssidBuf), "SSID: %s", ssid);
+  char ssidBuf[sizeof("SSID: ") + sizeof(req.text[0])];
+  snprintf(ssidBuf, sizeof(ssidBuf), "SSID: %s", req.text[0]);
   sprite->drawString(ssidBuf, 120, 130, 2);
 
-  char ipBuf[64];
-  snprintf(ipBuf, sizeof(ipBuf), "IP: %s", ip);
+  char ipBuf[sizeof("IP: ") + sizeof(req.text[1])];
+  snprintf(ipBuf, sizeof(ipBuf), "IP: %s", req.text[1]);
   sprite->drawString(ipBuf, 120, 155, 2);
 
   // EXIT INSTRUCTION
   sprite->setTextColor(TFT_RED);
   sprite->drawString("PRESS VOL BUTTON", 120, 210, 2);
   sprite->drawString("TO EXIT", 120, 230, 2);
-
-  sprite->pushSprite(0, 0);
 }
 
-void UI_Controller::showSplashScreen() {
+void UI_Controller::renderSplashScreen() {
   sprite->fillSprite(TFT_BLACK); // Always Black splash
 
   sprite->setTextColor(TFT_WHITE);
@@ -204,11 +641,9 @@ void UI_Controller::showSplashScreen() {
   sprite->setTextSize(1);
   sprite->setTextColor(TFT_SILVER);
   sprite->drawString("System Check...", 120, 200, 2);
-
-  sprite->pushSprite(0, 0);
 }
 
-void UI_Controller::showErrorScreen(const char *errorMessage) {
+void UI_Controller::renderErrorScreen(const Request &req) {
   // Hardcoded Alert Colors
   sprite->fillSprite(TFT_RED);
 
@@ -216,7 +651,5 @@ void UI_Controller::showErrorScreen(const char *errorMessage) {
   sprite->setTextDatum(MC_DATUM);
   sprite->setTextSize(2);
 
-  sprite->drawString(errorMessage, 120, 120, 2);
-
-  sprite->pushSprite(0, 0);
+  sprite->drawString(req.text[0], 120, 120, 2);
 }
@@ -3,6 +3,9 @@
 
 #include <SPI.h>
 #include <TFT_eSPI.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 
 enum EditMode { MODE_PRESET, MODE_FADE_TIME, MODE_TRANSITION };
 
@@ -12,17 +15,30 @@ enum MenuOption {
   MENU_TRANSITION,
   MENU_THEME,
   MENU_BRIGHTNESS,
+  MENU_PCM_CACHE,
+  MENU_LOOP,
+  MENU_LAYER_BANK,  // Second layer: Off or a bank
+  MENU_LAYER_LEVEL,
+  MENU_LAYER_MUTE,
   MENU_WIFI, // New Option
   MENU_EXIT,
   MENU_COUNT // Total items
 };
 
+// Renders on a task of its own ("UIRender"), which owns the TFT. The draw
+// and show methods only post the screen to draw; when several are posted
+// before the task gets to them, the latest wins. Frames go out by DMA from
+// two small buffers in turn: while one is on the wire the task fills the
+// other, and it starts on the next frame while the last piece of the
+// previous one is still being sent. The sprite is only one band of the
+// screen, UI_BAND_ROWS high: every window sent is drawn a band at a time,
+// the whole screen redrawn each time clipped to the band.
 class UI_Controller {
 public:
   UI_Controller();
-  void init();
+  void init(); // Starts the render task
 
-  // New Theme Engine
+  // New Theme Engine. Takes effect from the next screen posted.
   void applyTheme(bool isDark);
 
   // Render Methods
@@ -31,7 +47,9 @@ public:
                        bool useCrossfade);
 
   void drawMenu(int selectedIndex, bool isEditing, int fadeTimeMs,
-                bool useCrossfade, bool isDark, int brightness);
+                bool useCrossfade, bool isDark, int brightness,
+                bool usePcmCache, bool loopPads, const char *layerBank,
+                int layerLevel, bool layerMute);
 
   // Wi-Fi Screen
   void drawWifiScreen(const char *ssid, const char *ip);
@@ -40,12 +58,117 @@ public:
   void showErrorScreen(const char *errorMessage);
 
 private:
+  enum Screen : uint8_t {
+    SCREEN_OTHER, // Not tracked: always a full push
+    SCREEN_PERFORMANCE,
+    SCREEN_MENU,
+    SCREEN_WIFI,
+    SCREEN_SPLASH,
+    SCREEN_ERROR
+  };
+
+  // A posted screen and everything needed to draw it
+  struct Request {
+    Screen screen;
+    bool dark; // Theme to draw in
+    char text[3][64]; // Performance: current key, next key, preset name
+                      // Menu: layer bank. Wi-Fi: SSID, IP. Error: message
+    // The rest as the draw method was given it
+    int selectedIndex;
+    bool isEditing;
+    int volume;
+    int fadeTimeMs;
+    bool useCrossfade;
+    bool isDark;
+    int brightness;
+    bool usePcmCache;
+    bool loopPads;
+    int layerLevel;
+    bool layerMute;
+  };
+
   TFT_eSprite *sprite;
   TFT_eSPI tft;
+  QueueHandle_t requests; // One slot, overwritten
+  TaskHandle_t task;
+  bool darkTheme; // As applyTheme() left it, for the next request
+
+  bool colorsDark; // Theme of the colours below (render task)
+
+  Request frame; // The screen on the panel, redrawn for every band
+  struct Rect {
+    int16_t x, y, w, h;
+  };
+  Rect band;       // Screen area the sprite holds while drawing
+  bool layingOut;  // Drawing nothing, only recording the strings
+
+  void post(Request &req);
+  static void taskEntry(void *param);
+  void render(const Request &req);
+  void drawFrame(); // `frame`, clipped to the band
+  bool inBand(const Rect &r) const;
+  void setColors(bool isDark);
+
+  void renderPerformance(const Request &req);
+  void renderMenu(const Request &req);
+  void renderWifiScreen(const Request &req);
+  void renderSplashScreen();
+  void renderErrorScreen(const Request &req);
+
   void drawConvexBackground();
   void drawText(const char *text, int x, int y, uint8_t font, uint16_t color,
                 uint8_t datum);
 
+  // Dirty regions. The performance and menu views are first laid out
+  // without drawing: every string goes through placeText(), which records
+  // it with its bounds. pushFrame() then compares the strings with those
+  // on the panel and sends only the boxes that changed, old and new extent
+  // together, each as one SPI window. A different view, a theme change or
+  // any other screen in between makes the next frame a full push.
+  struct TextItem {
+    char text[64];
+    uint16_t color;
+    Rect box;
+  };
+  static const int MAX_TEXT_ITEMS = 20; // Menu: header + 8 rows of two
+
+  TextItem frameItems[MAX_TEXT_ITEMS]; // Being drawn
+  TextItem shownItems[MAX_TEXT_ITEMS]; // On the panel
+  int frameCount;
+  int shownCount;
+  Screen frameScreen;
+  Screen shownScreen;
+
+  static Rect unite(const Rect &a, const Rect &b);
+  static bool overlaps(const Rect &a, const Rect &b);
+  void beginFrame(Screen screen);
+  void placeText(const char *text, int x, int y, uint8_t font, uint8_t size,
+                 uint16_t color, uint8_t datum);
+  void placeKey(const char *key, int x, int y, uint16_t color); // Centered
+  void track(const char *text, uint16_t color, int left, int top, int w,
+             int h);
+  void pushFrame();
+  void pushFull(); // Any other screen
+  void pushWindow(const Rect &r); // Screen window to the panel by DMA
+  int dmaNext; // Buffer to fill next
+
+  // Level meter: a ring of segments round the edge of the performance
+  // view, fed by the audio task through levelRing. The render task drains
+  // the ring once a frame, whether or not the meter is on screen, and
+  // redraws and pushes only the segments whose colour changed. The RMS
+  // lights the ring, the peak sits on it as a single segment; both fall
+  // back one segment a frame.
+  static const int METER_SEGMENTS = 40;
+  int meterLevel; // Segments lit, as on the panel
+  int meterPeak;  // Segment of the peak marker, 0 = none
+  uint32_t meterMs; // Last update
+
+  void updateMeter();
+  uint16_t meterColor(int segment, int level, int peak) const;
+  void drawMeterSegment(int segment, uint16_t color);
+  Rect meterSegmentBox(int segment) const;
+  Rect meterBoxes[METER_SEGMENTS]; // meterSegmentBox() of each, worked out once
+
   // Dynamic Theme Colors
   uint16_t colorBg;
   uint16_t colorText;
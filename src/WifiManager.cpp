@@ -1,6 +1,17 @@
 #include "WifiManager.h"
+#include "AudioMetrics.h"
+#include "PadCache.h"
+#include "PadIndex.h"
+#include "SdScheduler.h"
+#include <algorithm>
 
-WifiManager::WifiManager() : server(80) { uploadTargetFolder = "/"; }
+static_assert(SD_UPLOAD_BATCH_BYTES % SD_SECTOR_BYTES == 0,
+              "SD_UPLOAD_BATCH_BYTES must be whole sectors");
+
+WifiManager::WifiManager()
+    : server(80), uploadExpected(0), uploadRefused(false), uploadLen(0) {
+  uploadTargetFolder = "/";
+}
 
 void WifiManager::begin() {
   server.on("/", HTTP_GET, std::bind(&WifiManager::handleRoot, this));
@@ -8,23 +19,17 @@ void WifiManager::begin() {
   server.on("/delete", HTTP_GET, std::bind(&WifiManager::handleDelete, this));
   server.on("/upload", HTTP_POST, std::bind(&WifiManager::handleUpload, this),
             std::bind(&WifiManager::handleUploadLoop, this));
+  server.on("/metrics", HTTP_GET,
+            std::bind(&WifiManager::handleMetrics, this));
 }
 
+// Audio keeps playing: sdScheduler fits the file manager's card work in
+// around the audio task's reads
 void WifiManager::startAP() {
-  // 1. Stop Audio
-  AudioCommand cmd;
-  cmd.type = CMD_SET_VOLUME;
-  cmd.value = 0;
-  xQueueSend(audioQueue, &cmd, 0);
-  cmd.type = CMD_STOP;
-  xQueueSend(audioQueue, &cmd, 0);
-
-  // 2. Safety Delay (SPI Race)
-  delay(600);
-
-  // 3. Start AP & Server
   WiFi.softAP("Padium-Manager", "12345678");
   server.begin();
+  Serial.printf("Free heap with Wi-Fi: %u bytes, largest block %u\n",
+                (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMaxAllocHeap());
 }
 
 void WifiManager::stopAP() {
@@ -39,23 +44,92 @@ String WifiManager::getIP() { return WiFi.softAPIP().toString(); }
 
 // --- Logic ---
 
-void WifiManager::deleteRecursive(File dir) {
-  if (!dir)
+// Bank folder a card path is in (or is): "/Warm Pads/C.mp3" -> "Warm Pads".
+// Empty for files in the root.
+static String bankOf(const String &path) {
+  int start = path.startsWith("/") ? 1 : 0;
+  int slash = path.indexOf('/', start);
+  if (slash < 0)
+    return "";
+  return path.substring(start, slash);
+}
+
+// Drop the PCM sidecar(s) derived from `path` (a pad or a whole bank) so a
+// replaced file is never played from a stale cache
+void WifiManager::invalidateCache(const String &path) {
+  char cachePath[96];
+  if (!PadCache::cachePathFor(path.c_str(), cachePath, sizeof(cachePath)))
+    return;
+  sdScheduler.lock();
+  bool removed = SD.exists(cachePath) && SD.remove(cachePath);
+  sdScheduler.unlock();
+  if (removed)
     return;
-  dir.rewindDirectory();
+  // Bank folder: no extension, so the mapped name ends in ".pcm"
+  deletePath(String(PAD_CACHE_DIR) + path);
+}
+
+// A file, or a folder and everything in it, one card slice per entry
+void WifiManager::deletePath(const String &path) {
+  sdScheduler.lock();
+  File f = SD.exists(path) ? SD.open(path) : File();
+  bool isDir = f && f.isDirectory();
+  if (f && !isDir) {
+    f.close();
+    SD.remove(path.c_str());
+  }
+  sdScheduler.unlock();
+  if (!isDir)
+    return;
+
   while (true) {
-    File entry = dir.openNextFile();
-    if (!entry)
+    sdScheduler.lock();
+    File entry = f.openNextFile();
+    String entryPath = entry ? String(entry.path()) : String();
+    bool entryIsDir = entry && entry.isDirectory();
+    entry.close();
+    if (entryPath.length() > 0 && !entryIsDir)
+      SD.remove(entryPath.c_str());
+    sdScheduler.unlock();
+    if (entryPath.length() == 0)
       break;
-    String path = entry.path();
-    if (entry.isDirectory()) {
-      deleteRecursive(entry);
-      SD.rmdir(path.c_str());
-    } else {
-      SD.remove(path.c_str());
+    if (entryIsDir)
+      deletePath(entryPath);
+  }
+  sdScheduler.lock();
+  f.close();
+  SD.rmdir(path.c_str());
+  sdScheduler.unlock();
+}
+
+// Names in a folder, one card slice per entry, so the listing can be sent
+// over the network without holding the card
+std::vector<WifiManager::Entry> WifiManager::listFolder(const char *path) {
+  std::vector<Entry> entries;
+  sdScheduler.lock();
+  File dir = SD.open(path);
+  sdScheduler.unlock();
+  while (dir) {
+    sdScheduler.lock();
+    File f = dir.openNextFile();
+    Entry e;
+    if (f) {
+      e.name = f.name();
+      e.path = f.path();
+      e.isDir = f.isDirectory();
+      e.size = e.isDir ? 0 : f.size();
+      f.close();
     }
-    entry.close();
+    bool more = (bool)f;
+    if (!more)
+      dir.close();
+    sdScheduler.unlock();
+    if (!more)
+      break;
+    if (!e.name.startsWith("."))
+      entries.push_back(e);
   }
+  return entries;
 }
 
 // STREAMING ROOT HANDLER
@@ -68,7 +142,7 @@ void WifiManager::handleRoot() {
         <html><head><title>Padium Pro Manager</title>
         <meta name='viewport' content='width=device-width, initial-scale=1'>
         <style>body{font-family:sans-serif; margin:20px;} table{border-collapse:collapse;} th,td{text-align:left;}</style>
-        <script>function setAction(form) { var folder = document.getElementById('targetFolder').value; form.action = '/upload?folder=' + folder; }</script>
+        <script>function setAction(form) { var folder = document.getElementById('targetFolder').value; var f = form.upload.files[0]; form.action = '/upload?folder=' + folder + (f ? '&size=' + f.size : ''); }</script>
         </head><body>
         <h1>Padium Pro File Manager</h1>
         
@@ -87,24 +161,12 @@ void WifiManager::handleRoot() {
   server.sendContent(head);
 
   // 2. Dynamic Folders
-  if (xSemaphoreTake(sdCardMutex, portMAX_DELAY)) {
-    File root = SD.open("/");
-    if (root) {
-      root.rewindDirectory();
-      while (true) {
-        File entry = root.openNextFile();
-        if (!entry)
-          break;
-        if (entry.isDirectory() && !String(entry.name()).startsWith(".")) {
-          String opt = "<option value='" + String(entry.name()) + "'>" +
-                       String(entry.name()) + "</option>";
-          server.sendContent(opt);
-        }
-        entry.close();
-      }
-      root.close();
+  std::vector<Entry> entries = listFolder("/");
+  for (const Entry &e : entries) {
+    if (e.isDir) {
+      String opt = "<option value='" + e.name + "'>" + e.name + "</option>";
+      server.sendContent(opt);
     }
-    xSemaphoreGive(sdCardMutex);
   }
 
   // 3. Middle HTML
@@ -121,38 +183,17 @@ void WifiManager::handleRoot() {
   server.sendContent(middle);
 
   // 4. File List (Streaming Rows)
-  if (xSemaphoreTake(sdCardMutex, portMAX_DELAY)) {
-    File root = SD.open("/");
-    if (root) {
-      root.rewindDirectory();
-      while (true) {
-        File entry = root.openNextFile();
-        if (!entry)
-          break;
-
-        String eName = entry.name();
-        if (eName.startsWith(".")) {
-          entry.close();
-          continue;
-        }
-
-        String row = "<tr>";
-        row += "<td>" + String(entry.isDirectory() ? "DIR" : "FILE") + "</td>";
-        row += "<td>" + eName + "</td>";
-        row += "<td>" +
-               String(entry.isDirectory() ? "-" : String(entry.size()) + " B") +
-               "</td>";
-        row += "<td><a href='/delete?path=" + String(entry.path()) +
-               "' onclick=\"return confirm('Delete " + eName +
-               "?');\">[DELETE]</a></td>";
-        row += "</tr>";
-
-        server.sendContent(row);
-        entry.close();
-      }
-      root.close();
-    }
-    xSemaphoreGive(sdCardMutex);
+  for (const Entry &e : entries) {
+    String row = "<tr>";
+    row += "<td>" + String(e.isDir ? "DIR" : "FILE") + "</td>";
+    row += "<td>" + e.name + "</td>";
+    row += "<td>" + String(e.isDir ? "-" : String(e.size) + " B") + "</td>";
+    row += "<td><a href='/delete?path=" + e.path +
+           "' onclick=\"return confirm('Delete " + e.name +
+           "?');\">[DELETE]</a></td>";
+    row += "</tr>";
+
+    server.sendContent(row);
   }
 
   // 5. Footer
@@ -169,10 +210,11 @@ void WifiManager::handleCreate() {
   String name = server.arg("folderName");
   if (name.length() > 0) {
     String path = "/" + name;
-    xSemaphoreTake(sdCardMutex, portMAX_DELAY);
+    sdScheduler.lock();
     if (!SD.exists(path))
       SD.mkdir(path);
-    xSemaphoreGive(sdCardMutex);
+    sdScheduler.unlock();
+    padIndex.updateBank(name.c_str());
   }
   server.sendHeader("Location", "/");
   server.send(303);
@@ -183,23 +225,49 @@ void WifiManager::handleDelete() {
     return;
   String path = server.arg("path");
 
-  xSemaphoreTake(sdCardMutex, portMAX_DELAY);
-  if (SD.exists(path)) {
-    File f = SD.open(path);
-    if (f.isDirectory()) {
-      deleteRecursive(f);
-      SD.rmdir(path.c_str());
-    } else {
-      SD.remove(path.c_str());
-    }
-    f.close();
+  // FatFs does not lock files: never remove one the audio task has open
+  if (!audioReleasePath(path.c_str())) {
+    audioReleaseDone();
+    server.send(409, "text/plain", "File in use");
+    return;
   }
-  xSemaphoreGive(sdCardMutex);
+  invalidateCache(path);
+  deletePath(path);
+
+  // A whole bank is dropped by updateBank() finding its folder gone
+  String bank = bankOf(path + (path.endsWith("/") ? "" : "/"));
+  if (bank.length() > 0)
+    padIndex.updateBank(bank.c_str());
+  audioReleaseDone();
   server.sendHeader("Location", "/");
   server.send(303);
 }
 
-void WifiManager::handleUpload() { server.send(200, "text/plain", ""); }
+// Audio pipeline counters; "/metrics?reset=1" clears them after reading
+void WifiManager::handleMetrics() {
+  server.send(200, "text/plain", audioMetrics.report());
+  if (server.hasArg("reset"))
+    audioMetrics.requestReset();
+}
+
+void WifiManager::flushUpload() {
+  if (uploadLen == 0)
+    return;
+  sdScheduler.lock();
+  uploadFile.write(uploadBuf, uploadLen);
+  sdScheduler.unlock();
+  uploadLen = 0;
+}
+
+// Called once the body is in: the upload handler only notes how it went
+void WifiManager::handleUpload() {
+  if (uploadRefused) {
+    server.send(409, "text/plain", "File in use");
+    return;
+  }
+  server.sendHeader("Location", "/");
+  server.send(303);
+}
 
 void WifiManager::handleUploadLoop() {
   HTTPUpload &upload = server.upload();
@@ -215,26 +283,81 @@ void WifiManager::handleUploadLoop() {
     }
 
     String filename = uploadTargetFolder + upload.filename;
+    uploadPath = filename;
+    uploadLen = 0;
+    uploadExpected = 0;
 
-    xSemaphoreTake(sdCardMutex, portMAX_DELAY);
+    // Played from until the upload ends, or the same file: let it go first
+    uploadRefused = !audioReleasePath(filename.c_str());
+    if (uploadRefused)
+      return;
+    invalidateCache(filename);
+    sdScheduler.lock();
     if (SD.exists(filename.c_str()))
       SD.remove(filename.c_str());
+    sdScheduler.unlock();
+    sdScheduler.lock();
     uploadFile = SD.open(filename.c_str(), FILE_WRITE);
-    xSemaphoreGive(sdCardMutex);
+    uint64_t freeBytes = SD.totalBytes() - SD.usedBytes();
+    sdScheduler.unlock();
+    // The size comes from the browser: never more than the card can hold
+    uploadExpected = server.hasArg("size") ? server.arg("size").toInt() : 0;
+    if (uploadExpected < 0)
+      uploadExpected = 0;
+    if ((uint64_t)uploadExpected > freeBytes)
+      uploadExpected = (long)freeBytes;
+    // Grow the file to its final size up front, so its space is reserved
+    // before the data arrives. The clusters come from the FAT's usual
+    // free-cluster search and need not be contiguous. A step at a time,
+    // each its own slice, however large the file.
+    for (long at = 0; uploadFile && at < uploadExpected;) {
+      at = std::min(at + (long)SD_UPLOAD_GROW_BYTES, uploadExpected);
+      sdScheduler.lock();
+      uploadFile.seek(at - 1);
+      uploadFile.write((uint8_t)0);
+      sdScheduler.unlock();
+    }
+    if (uploadFile && uploadExpected > 0) {
+      sdScheduler.lock();
+      uploadFile.seek(0);
+      sdScheduler.unlock();
+    }
 
   } else if (upload.status == UPLOAD_FILE_WRITE) {
-    if (uploadFile) {
-      xSemaphoreTake(sdCardMutex, portMAX_DELAY);
-      uploadFile.write(upload.buf, upload.currentSize);
-      xSemaphoreGive(sdCardMutex);
+    // HTTP hands over ~1.4 KB at a time; collect a batch so the card is
+    // written in sector-aligned runs, one scheduler slice each
+    size_t done = 0;
+    while (uploadFile && done < upload.currentSize) {
+      size_t n = std::min(upload.currentSize - done,
+                          sizeof(uploadBuf) - uploadLen);
+      memcpy(uploadBuf + uploadLen, upload.buf + done, n);
+      uploadLen += n;
+      done += n;
+      if (uploadLen == sizeof(uploadBuf))
+        flushUpload();
     }
   } else if (upload.status == UPLOAD_FILE_END) {
     if (uploadFile) {
-      xSemaphoreTake(sdCardMutex, portMAX_DELAY);
+      flushUpload();
+      sdScheduler.lock();
+      uploadFile.close();
+      // Short of the size it was grown to: the tail would be garbage
+      if (uploadExpected > 0 && upload.totalSize != (size_t)uploadExpected)
+        SD.remove(uploadPath.c_str());
+      sdScheduler.unlock();
+      String bank = bankOf(uploadPath);
+      if (bank.length() > 0)
+        padIndex.updateBank(bank.c_str());
+    }
+    audioReleaseDone();
+  } else if (upload.status == UPLOAD_FILE_ABORTED) {
+    if (uploadFile) {
+      sdScheduler.lock();
       uploadFile.close();
-      xSemaphoreGive(sdCardMutex);
+      SD.remove(uploadPath.c_str());
+      sdScheduler.unlock();
     }
-    server.sendHeader("Location", "/");
-    server.send(303);
+    uploadLen = 0;
+    audioReleaseDone();
   }
 }
@@ -2,10 +2,12 @@
 #define WIFI_MANAGER_H
 
 #include "AudioTask.h"
+#include "Config.h"
 #include <Arduino.h>
 #include <SD.h>
 #include <WebServer.h>
 #include <WiFi.h>
+#include <vector>
 
 // Forward Declaration if needed, but AudioTask.h provides the types.
 
@@ -13,7 +15,7 @@ class WifiManager {
 public:
   WifiManager();
   void begin();
-  void startAP(); // Starts AP, Stops Audio, Begins Server
+  void startAP(); // Starts AP and Server; audio keeps playing
   void stopAP();  // Stops Server, Stops AP, Calls scanPresets callback?
   void handleClient();
 
@@ -26,6 +28,11 @@ private:
   WebServer server;
   File uploadFile;
   String uploadTargetFolder;
+  String uploadPath;
+  long uploadExpected; // Size the browser announced, 0 = unknown
+  bool uploadRefused;  // The audio task did not let go of the file
+  uint8_t uploadBuf[SD_UPLOAD_BATCH_BYTES];
+  size_t uploadLen;
 
   // Handlers
   void handleRoot();
@@ -33,9 +40,19 @@ private:
   void handleDelete();
   void handleUpload();
   void handleUploadLoop();
+  void flushUpload();
+  void handleMetrics();
 
   // Helpers
-  void deleteRecursive(File dir);
+  struct Entry {
+    String name;
+    String path;
+    bool isDir;
+    size_t size;
+  };
+  std::vector<Entry> listFolder(const char *path);
+  void deletePath(const String &path);
+  void invalidateCache(const String &path);
   void sendHeader();
   void sendFooter();
 };
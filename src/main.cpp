@@ -1,6 +1,11 @@
+#include "AudioMetrics.h"
 #include "AudioTask.h"
 #include "Config.h"
 #include "InputManager.h"
+#include "PadCache.h"
+#include "PadIndex.h"
+#include "SdScheduler.h"
+#include "PadPaths.h"
 #include "SettingsManager.h"
 #include "UI_Logic.h"
 #include "WifiManager.h" // NEW
@@ -21,10 +26,14 @@ SPIClass *sdSPI = NULL;
 SettingsManager settingsMgr;
 InputManager inputMgr;
 WifiManager wifiMgr; // NEW
+PadCache padCache;
 SystemSettings settings;
 
 // State Variables
 std::vector<String> presetNames;
+bool banksFound = false;    // presetNames holds a placeholder otherwise
+uint32_t presetRevision = 0; // padIndex revision presetNames reflects
+bool presetScanRunning = false;
 const char *keys[] = {"C",  "C#", "D",  "D#", "E",  "F",
                       "F#", "G",  "G#", "A",  "A#", "B"};
 const int numKeys = 12;
@@ -32,6 +41,11 @@ const int numKeys = 12;
 int currentKeyIndex = 0;
 int nextKeyIndex = 0;
 bool isPlayingState = false;
+bool panicSent = false; // This hold of Play already muted
+
+// Pad the audio task was last asked to prefetch (bank, key)
+int prefetchPresetIndex = -1;
+int prefetchKeyIndex = -1;
 
 // UI State Machine
 enum UIState { VIEW_PERFORMANCE, VIEW_MENU, VIEW_WIFI };
@@ -40,6 +54,11 @@ UIState uiState = VIEW_PERFORMANCE;
 int menuIndex = 0;
 bool isMenuEditing = false;
 
+// Frame scheduling: updateUI() only marks the screen dirty, and loop()
+// renders it at most once per UI_FRAME_MS
+bool uiDirty = false;
+unsigned long lastFrameMs = 0;
+
 // Screensaver
 unsigned long lastInteractionTime = 0;
 bool isDimmed = false;
@@ -62,52 +81,145 @@ void updateBrightness() {
 #endif
 }
 
-void scanPresets() {
-  presetNames.clear();
-
-  // MUTEX LOCK
-  xSemaphoreTake(sdCardMutex, portMAX_DELAY);
-
-  File root = SD.open("/");
-  if (root) {
-    root.rewindDirectory();
-    while (true) {
-      File entry = root.openNextFile();
-      if (!entry)
-        break;
-
-      if (entry.isDirectory()) {
-        String dirName = entry.name();
-        // Filter System Folders
-        if (!dirName.startsWith(".") && !dirName.startsWith("System")) {
-          presetNames.push_back(dirName);
-        }
-      }
-      entry.close();
-    }
-    root.close();
-  }
-
-  // MUTEX UNLOCK
-  xSemaphoreGive(sdCardMutex);
-
-  std::sort(presetNames.begin(), presetNames.end());
+// Bank list from the index: no card access. Keeps the selected bank
+// (by name) when a background rescan adds banks ahead of it.
+void loadPresets() {
+  String current = (size_t)settings.currentPresetIndex < presetNames.size()
+                       ? presetNames[settings.currentPresetIndex]
+                       : String("");
+  presetNames = padIndex.bankNames();
+  banksFound = !presetNames.empty();
+  prefetchPresetIndex = -1; // Indices may have moved
 
   if (presetNames.empty()) {
-    presetNames.push_back("NO BANKS");
+    presetNames.push_back(padIndex.isScanning() ? "SCANNING..." : "NO BANKS");
+  }
+
+  for (size_t b = 0; b < presetNames.size(); b++) {
+    if (presetNames[b] == current)
+      settings.currentPresetIndex = b;
   }
 
   // Validate Index
-  if (settings.currentPresetIndex >= presetNames.size()) {
+  if ((size_t)settings.currentPresetIndex >= presetNames.size()) {
     settings.currentPresetIndex = 0;
   }
+  presetRevision = padIndex.revision();
+}
+
+bool hasBanks() { return banksFound; }
+
+void sendPcmCacheSetting() {
+  AudioCommand cmd;
+  cmd.type = CMD_SET_PCM_CACHE;
+  cmd.value = settings.usePcmCache ? 1 : 0;
+  audioBus.send(cmd);
+}
+
+void sendLoopSetting() {
+  AudioCommand cmd;
+  cmd.type = CMD_SET_LOOP;
+  cmd.value = settings.loopPads ? 1 : 0;
+  audioBus.send(cmd);
+}
+
+// Index of the second layer's bank in presetNames, -1 if off or gone
+int layerBankIndex() {
+  if (settings.layerBank.isEmpty() || !hasBanks())
+    return -1;
+  for (size_t b = 0; b < presetNames.size(); b++) {
+    if (presetNames[b] == settings.layerBank)
+      return (int)b;
+  }
+  return -1;
+}
+
+// Layer 1 (0 in the engine) is the current bank; only layer 2 is set up
+void sendLayerBank() {
+  AudioCommand cmd;
+  cmd.type = CMD_SET_LAYER_BANK;
+  cmd.layer = 1;
+  int b = layerBankIndex();
+  cmd.bank = b >= 0 ? padIndex.handle(presetNames[b].c_str()) : PAD_NO_BANK;
+  audioBus.send(cmd);
+}
+
+void sendLayerLevel() {
+  AudioCommand cmd;
+  cmd.layer = 1;
+  cmd.type = CMD_SET_LAYER_GAIN;
+  cmd.value = settings.layerLevel;
+  audioBus.send(cmd);
+  cmd.type = CMD_SET_LAYER_MUTE;
+  cmd.value = settings.layerMute ? 1 : 0;
+  audioBus.send(cmd);
+}
+
+// Decode every bank to PCM sidecars in the background (when enabled)
+void startPadCache() {
+  if (!settings.usePcmCache || !hasBanks()) {
+    padCache.cancel();
+    return;
+  }
+  // MP3 pads only (WAV pads are PCM already), a root recording once
+  std::vector<String> paths;
+  PadLocation pad;
+  for (size_t b = 0; b < presetNames.size(); b++) {
+    const char *bank = presetNames[b].c_str();
+    int keys = padIndex.rootKey(bank) >= 0 ? 1 : numKeys;
+    for (int k = 0; k < keys; k++) {
+      if (padIndex.locate(bank, k, &pad) && pad.format == PAD_MP3)
+        paths.push_back(pad.path);
+    }
+  }
+  padCache.start(paths);
+}
+
+// Ask the audio task to open and buffer the pad that Play would start
+// next, whenever the bank or the queued key changes.
+void updatePrefetch() {
+  if (!hasBanks())
+    return;
+  // Pressing Play now would stop, not start a pad
+  if (isPlayingState && nextKeyIndex == currentKeyIndex)
+    return;
+  if (prefetchPresetIndex == settings.currentPresetIndex &&
+      prefetchKeyIndex == nextKeyIndex)
+    return;
+
+  AudioCommand cmd;
+  cmd.type = CMD_PREFETCH;
+  cmd.bank = padIndex.handle(presetNames[settings.currentPresetIndex].c_str());
+  cmd.key = nextKeyIndex;
+  audioBus.send(cmd);
+  prefetchPresetIndex = settings.currentPresetIndex;
+  prefetchKeyIndex = nextKeyIndex;
+}
+
+// Send a Play/Crossfade for the current key of the current bank
+void sendPadCommand(AudioCommand &cmd) {
+  cmd.bank = padIndex.handle(presetNames[settings.currentPresetIndex].c_str());
+  cmd.key = currentKeyIndex;
+  cmd.issuedUs = micros();
+  audioBus.send(cmd);
+  prefetchKeyIndex = -1; // Consumed by this transition
 }
 
-void updateUI() {
+void renderUI() {
+  uiDirty = false;
+  lastFrameMs = millis();
   if (uiState == VIEW_PERFORMANCE) {
     const char *pName = (presetNames.size() > 0)
                             ? presetNames[settings.currentPresetIndex].c_str()
                             : "ERROR";
+    // "Warm Pads + Shimmer" while a second layer is on
+    char layered[64];
+    int layer = layerBankIndex();
+    if (layer >= 0 && !settings.layerMute && settings.layerLevel > 0) {
+      snprintf(layered, sizeof(layered), "%s + %s", pName,
+               presetNames[layer].c_str());
+      pName = layered;
+    }
 
     ui.drawPerformance(keys[currentKeyIndex], keys[nextKeyIndex], pName,
                        settings.volume, settings.fadeTimeMs,
@@ -117,11 +229,31 @@ void updateUI() {
   } else {
     ui.drawMenu(menuIndex, isMenuEditing, settings.fadeTimeMs,
                 settings.useCrossfade, settings.isDarkMode,
-                settings.screenBrightness);
+                settings.screenBrightness, settings.usePcmCache,
+                settings.loopPads, settings.layerBank.c_str(),
+                settings.layerLevel, settings.layerMute);
   }
 }
 
+void updateUI() { uiDirty = true; }
+
+// Past the frame cap, for feedback that must not wait (panic)
+void updateUINow() { renderUI(); }
+
+void loopRender() {
+  if (uiDirty && millis() - lastFrameMs >= UI_FRAME_MS)
+    renderUI();
+}
+
+void startRescan() {
+  padCache.cancel(); // Restarted on the rescanned banks
+  padIndex.startRescan();
+  presetScanRunning = true;
+}
+
 void startWifiMode() {
+  padCache.cancel(); // Files may change under it
+  padIndex.cancelRescan(); // The file manager updates the index itself
   wifiMgr.startAP(); // encapsulated stop logic and AP start
   uiState = VIEW_WIFI;
   updateUI();
@@ -129,18 +261,21 @@ void startWifiMode() {
 
 void stopWifiMode() {
   wifiMgr.stopAP();
-  scanPresets();
+  loadPresets(); // The file manager updated the index as it went
+  sendLayerBank(); // Its folder may be gone
+  if (padIndex.isStale())
+    startRescan(); // Cut short by Wi-Fi mode
+  else
+    startPadCache(); // Pick up new uploads
   uiState = VIEW_PERFORMANCE;
   updateUI();
 }
 
 void handleMenuScroll(int direction) {
   if (!isMenuEditing) {
-    menuIndex += direction;
-    if (menuIndex < 0)
-      menuIndex = MENU_COUNT - 1;
-    if (menuIndex >= MENU_COUNT)
-      menuIndex = 0;
+    // A fast spin can move several rows at once
+    menuIndex = ((menuIndex + direction) % MENU_COUNT + MENU_COUNT) %
+                MENU_COUNT;
   } else {
     MenuOption opt = (MenuOption)menuIndex;
     switch (opt) {
@@ -169,6 +304,42 @@ void handleMenuScroll(int direction) {
         settings.screenBrightness = 255;
       updateBrightness();
       break;
+    case MENU_PCM_CACHE:
+      if (direction != 0) {
+        settings.usePcmCache = !settings.usePcmCache;
+        sendPcmCacheSetting();
+        startPadCache();
+      }
+      break;
+    case MENU_LOOP:
+      if (direction != 0) {
+        settings.loopPads = !settings.loopPads;
+        sendLoopSetting();
+      }
+      break;
+    case MENU_LAYER_BANK:
+      if (direction != 0 && hasBanks()) {
+        // Off, then every bank in turn
+        int n = presetNames.size() + 1;
+        int pos = (layerBankIndex() + 1 + direction % n + n) % n;
+        settings.layerBank = pos == 0 ? String("") : presetNames[pos - 1];
+        sendLayerBank();
+      }
+      break;
+    case MENU_LAYER_LEVEL:
+      settings.layerLevel += (direction * 10);
+      if (settings.layerLevel < 0)
+        settings.layerLevel = 0;
+      if (settings.layerLevel > 100)
+        settings.layerLevel = 100;
+      sendLayerLevel();
+      break;
+    case MENU_LAYER_MUTE:
+      if (direction != 0) {
+        settings.layerMute = !settings.layerMute;
+        sendLayerLevel();
+      }
+      break;
     default:
       break;
     }
@@ -196,7 +367,7 @@ void handleMenuClick() {
 }
 
 void loopInput() {
-  inputMgr.update();
+  inputMgr.update(INPUT_IDLE_MS); // The loop's only wait
 
   if (uiState == VIEW_WIFI) {
     wifiMgr.handleClient(); // Using manager
@@ -206,11 +377,8 @@ void loopInput() {
     return;
   }
 
-  // Screensaver Wake
-  if (inputMgr.getVolumeDelta() != 0 || inputMgr.getNavDelta() != 0 ||
-      inputMgr.wasNavBtnPressed() || inputMgr.wasVolBtnPressed() ||
-      inputMgr.wasNextPressed() || inputMgr.wasPrevPressed() ||
-      inputMgr.wasPlayPressed()) {
+  // Screensaver Wake (peek: the handlers below consume the events)
+  if (inputMgr.hasPendingInput()) {
     resetScreensaver();
   }
 
@@ -227,7 +395,7 @@ void loopInput() {
       AudioCommand cmd;
       cmd.type = CMD_SET_VOLUME;
       cmd.value = settings.volume;
-      xQueueSend(audioQueue, &cmd, 0);
+      audioBus.send(cmd);
       if (uiState == VIEW_PERFORMANCE)
         updateUI();
     }
@@ -248,12 +416,10 @@ void loopInput() {
   if (nDelta != 0) {
     if (uiState == VIEW_PERFORMANCE) {
       if (presetNames.size() > 0) {
-        settings.currentPresetIndex += nDelta;
         int maxIdx = presetNames.size();
-        if (settings.currentPresetIndex < 0)
-          settings.currentPresetIndex = maxIdx - 1;
-        if (settings.currentPresetIndex >= maxIdx)
-          settings.currentPresetIndex = 0;
+        settings.currentPresetIndex =
+            ((settings.currentPresetIndex + nDelta) % maxIdx + maxIdx) %
+            maxIdx;
         updateUI();
       }
     } else {
@@ -275,54 +441,42 @@ void loopInput() {
 
   if (uiState == VIEW_PERFORMANCE) {
     // 5. Next/Prev
-    if (inputMgr.wasNextPressed() || inputMgr.isNextHeld()) {
+    // Held, each repeat is a whole-tone jump
+    if (inputMgr.wasNextPressed()) {
       int jump = inputMgr.isNextHeld() ? 2 : 1;
       nextKeyIndex = (nextKeyIndex + jump) % numKeys;
       updateUI();
     }
 
-    if (inputMgr.wasPrevPressed() || inputMgr.isPrevHeld()) {
+    if (inputMgr.wasPrevPressed()) {
       int jump = inputMgr.isPrevHeld() ? 2 : 1;
       nextKeyIndex = (nextKeyIndex - jump + numKeys) % numKeys;
       updateUI();
     }
 
     // 6. Play / Panic
-    if (inputMgr.isPlayHeld()) {
-      if (!isDimmed) {
-        AudioCommand cmd;
-        cmd.type = CMD_SET_VOLUME;
-        cmd.value = 0;
-        xQueueSend(audioQueue, &cmd, 0);
-        cmd.type = CMD_STOP;
-        xQueueSend(audioQueue, &cmd, 0);
-        isPlayingState = false;
-        updateUI();
-        return;
+    if (!inputMgr.isPlayHeld()) {
+      panicSent = false;
+    } else if (!isDimmed) {
+      if (!panicSent) {
+        audioPanic(); // Once per hold, not every pass it lasts
+        panicSent = true;
       }
+      if (isPlayingState)
+        updateUINow();
+      isPlayingState = false;
+      return;
     }
 
     if (inputMgr.wasPlayPressed()) {
-      if (presetNames.size() == 0 || presetNames[0] == "NO BANKS") {
+      if (!hasBanks()) {
         // No Action
       } else if (!isPlayingState) {
         // Start Play
         currentKeyIndex = nextKeyIndex;
         AudioCommand cmd;
         cmd.type = CMD_PLAY;
-        char safeKey[8];
-        strncpy(safeKey, keys[currentKeyIndex], 7);
-        if (safeKey[1] == '#') {
-          safeKey[1] = 's';
-          safeKey[2] = '\0';
-        }
-
-        char filename[64];
-        snprintf(filename, sizeof(filename), "/%s/%s.mp3",
-                 presetNames[settings.currentPresetIndex].c_str(), safeKey);
-
-        strncpy(cmd.filename, filename, sizeof(cmd.filename) - 1);
-        xQueueSend(audioQueue, &cmd, 0);
+        sendPadCommand(cmd);
         isPlayingState = true;
       } else {
         // Transition or Stop
@@ -336,29 +490,20 @@ void loopInput() {
             cmd.type = CMD_PLAY;
           }
 
-          char safeKey[8];
-          strncpy(safeKey, keys[currentKeyIndex], 7);
-          if (safeKey[1] == '#') {
-            safeKey[1] = 's';
-            safeKey[2] = '\0';
-          }
-
-          char filename[64];
-          snprintf(filename, sizeof(filename), "/%s/%s.mp3",
-                   presetNames[settings.currentPresetIndex].c_str(), safeKey);
-
-          strncpy(cmd.filename, filename, sizeof(cmd.filename) - 1);
-          xQueueSend(audioQueue, &cmd, 0);
+          sendPadCommand(cmd);
         } else {
           // Stop
           AudioCommand cmd;
           cmd.type = CMD_STOP;
-          xQueueSend(audioQueue, &cmd, 0);
+          audioBus.send(cmd);
           isPlayingState = false;
         }
       }
       updateUI();
     }
+
+    // 7. Read ahead whatever Play would start next
+    updatePrefetch();
   }
 }
 
@@ -392,33 +537,97 @@ void setup() {
   delay(1000);
 
   // RTOS
-  sdCardMutex = xSemaphoreCreateMutex();
-  audioQueue = xQueueCreate(10, sizeof(AudioCommand));
+  sdScheduler.begin();
+  padIndex.begin();
+  audioBus.begin();
+  audioWakeSet = xQueueCreateSet(AUDIO_WAKE_SET_LEN);
+  xQueueAddToSet(audioBus.doorbell(), audioWakeSet); // Must still be empty
 
   // Global SD Init
   sdSPI = new SPIClass(VSPI);
   sdSPI->begin(SD_SCLK, SD_MISO, SD_MOSI, SD_CS);
-  if (!SD.begin(SD_CS, *sdSPI)) {
+  if (!SD.begin(SD_CS, *sdSPI, SD_SPI_HZ)) {
     ui.showErrorScreen("NO SD CARD");
     while (true)
       delay(100);
   }
 
-  scanPresets();
+  // Last known banks right away; a stale index is caught up in the
+  // background and the list fills in as banks are found
+  bool indexFresh = padIndex.load();
+  if (!indexFresh)
+    startRescan();
+  loadPresets();
 
-  if (presetNames.size() == 0 || presetNames[0] == "NO BANKS") {
+  if (!hasBanks() && !padIndex.isScanning()) {
     ui.showErrorScreen("NO BANKS FOUND");
     delay(2000);
   }
 
+  sendPcmCacheSetting();
+  sendLoopSetting();
+  sendLayerBank();
+  sendLayerLevel();
+  if (indexFresh)
+    startPadCache(); // Else once the rescan is done
+
+  if (!audioAllocate()) {
+    ui.showErrorScreen("OUT OF MEMORY");
+    while (true)
+      delay(100);
+  }
+  Serial.printf("Free heap: %u bytes, largest block %u\n",
+                (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMaxAllocHeap());
+
   // Task
   xTaskCreatePinnedToCore(audioTask, "AudioTask", 4096 * 4, NULL, 2, NULL, 0);
 
   updateUI();
 }
 
+// Take in banks the background rescan has published since the last look
+void loopPresetScan() {
+  // A pad that no longer matched its entry when it opened
+  String changed;
+  if (padIndex.takeChanged(&changed) && uiState != VIEW_WIFI) {
+    if (changed.length() && !padIndex.isScanning())
+      padIndex.updateBank(changed.c_str());
+    else
+      startRescan(); // Whole card; stopWifiMode() does it in Wi-Fi mode
+  }
+
+  if (padIndex.revision() == presetRevision &&
+      padIndex.isScanning() == presetScanRunning)
+    return;
+  bool finished = presetScanRunning && !padIndex.isScanning();
+  presetScanRunning = padIndex.isScanning();
+
+  bool hadBanks = hasBanks();
+  loadPresets();
+  if (finished || hasBanks() != hadBanks)
+    sendLayerBank(); // Its folder may have turned up
+  if (finished)
+    startPadCache();
+  if (uiState == VIEW_PERFORMANCE)
+    updateUI();
+}
+
+// Serial console: 'm' prints the audio metrics, 'r' resets them
+void loopSerial() {
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    if (c == 'm')
+      Serial.print(audioMetrics.report());
+    else if (c == 'r')
+      audioMetrics.requestReset();
+  }
+}
+
 void loop() {
   loopInput();
+  loopSerial();
+  loopPresetScan();
+  loopRender(); // Once for everything above
 
   if (uiState != VIEW_WIFI && !isDimmed &&
       (millis() - lastInteractionTime > 30000)) {
@@ -427,6 +636,4 @@ void loop() {
     ledcWrite(0, 25);
 #endif
   }
-
-  vTaskDelay(10);
 }
@@ -0,0 +1,146 @@
+// AudioMixer and GainRamp on the host: pio test -e test
+//
+// Sources are constant DC, so every output sample is a gain times a known
+// level. The outgoing voice plays on the left channel only and the incoming
+// one on the right, which lets a crossfade be read back voice by voice.
+
+#include "AudioMixer.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <unity.h>
+#include <vector>
+
+static const int16_t LEVEL = 16384;
+static const uint32_t FADE = 4410; // 100 ms at 44.1 kHz
+
+// Endless DC on one or both channels
+class DcSource : public PcmSource {
+public:
+  DcSource(int16_t left, int16_t right) : l(left), r(right), open(true) {}
+
+  size_t read(int16_t *out, size_t frames) override {
+    for (size_t i = 0; i < frames; i++) {
+      out[i * 2] = l;
+      out[i * 2 + 1] = r;
+    }
+    return frames;
+  }
+  uint32_t sampleRate() const override { return 44100; }
+  bool isOpen() const override { return open; }
+  void close() override { open = false; }
+
+private:
+  int16_t l, r;
+  bool open;
+};
+
+// `frames` frames rendered in blocks of `block`
+static std::vector<int16_t> render(AudioMixer &mixer, size_t frames,
+                                   size_t block) {
+  std::vector<int16_t> out(frames * 2);
+  for (size_t at = 0; at < frames; at += block) {
+    size_t n = frames - at < block ? frames - at : block;
+    mixer.render(out.data() + at * 2, n);
+  }
+  return out;
+}
+
+// Left voice playing steadily, then a crossfade to the right voice
+static std::vector<int16_t> crossfade(size_t block, DcSource *from,
+                                      DcSource *to) {
+  AudioMixer mixer;
+  PcmSource *first[AudioMixer::MAX_LAYERS] = {from, NULL};
+  mixer.play(first, 0);
+  std::vector<int16_t> out = render(mixer, 1000, block);
+
+  PcmSource *second[AudioMixer::MAX_LAYERS] = {to, NULL};
+  mixer.makeRoom(AudioMixer::MAX_LAYERS);
+  mixer.play(second, FADE);
+  std::vector<int16_t> fade = render(mixer, FADE + 1000, block);
+  out.insert(out.end(), fade.begin(), fade.end());
+  return out;
+}
+
+void test_ramp_lands_on_the_frame(void) {
+  GainRamp ramp;
+  ramp.rampToIn(1.0f, FADE, CURVE_EQUAL_POWER);
+  for (uint32_t i = 0; i < FADE - 1; i++)
+    ramp.next();
+  TEST_ASSERT_TRUE(ramp.isRamping());
+  TEST_ASSERT_TRUE(ramp.gain() < 1.0f);
+  ramp.next();
+  TEST_ASSERT_FALSE(ramp.isRamping());
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, ramp.position());
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, ramp.next());
+}
+
+void test_partial_ramp_keeps_the_slope(void) {
+  GainRamp ramp;
+  ramp.set(0.5f);
+  ramp.rampTo(0.0f, FADE, CURVE_LINEAR);
+  uint32_t frames = 0;
+  while (ramp.isRamping()) {
+    ramp.next();
+    frames++;
+  }
+  TEST_ASSERT_EQUAL_UINT32((FADE + 1) / 2, frames);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, ramp.position());
+}
+
+// Output is the same sample for sample however the blocks fall
+void test_ramps_ignore_block_size(void) {
+  DcSource a1(LEVEL, 0), b1(0, LEVEL);
+  std::vector<int16_t> whole = crossfade(AudioMixer::MAX_BLOCK_FRAMES, &a1,
+                                         &b1);
+  const size_t blocks[] = {1, 7, 100, 1024};
+  for (size_t block : blocks) {
+    DcSource a(LEVEL, 0), b(0, LEVEL);
+    std::vector<int16_t> split = crossfade(block, &a, &b);
+    TEST_ASSERT_EQUAL_size_t(whole.size(), split.size());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(whole.data(), split.data(), whole.size());
+  }
+}
+
+// cos^2 + sin^2: the two voices' gains square-sum to one on every frame
+void test_crossfade_is_equal_power(void) {
+  DcSource a(LEVEL, 0), b(0, LEVEL);
+  std::vector<int16_t> out = crossfade(256, &a, &b);
+  for (size_t i = 1000; i < 1000 + FADE; i++) {
+    float gOut = out[i * 2] / (float)LEVEL;
+    float gIn = out[i * 2 + 1] / (float)LEVEL;
+    TEST_ASSERT_FLOAT_WITHIN(0.002f, 1.0f, gOut * gOut + gIn * gIn);
+  }
+  // Then only the incoming voice, at full level, the outgoing one closed
+  size_t end = out.size() / 2 - 1;
+  TEST_ASSERT_EQUAL_INT16(0, out[end * 2]);
+  TEST_ASSERT_INT16_WITHIN(1, LEVEL, out[end * 2 + 1]);
+  TEST_ASSERT_FALSE(a.isOpen());
+  TEST_ASSERT_TRUE(b.isOpen());
+}
+
+// No step anywhere, the handover included: a quarter sine over FADE frames
+// moves each of the two voices by at most LEVEL * pi/2 / FADE per frame
+void test_crossfade_is_click_free(void) {
+  DcSource a(LEVEL, LEVEL), b(LEVEL, LEVEL);
+  std::vector<int16_t> out = crossfade(256, &a, &b);
+  int maxStep = (int)ceilf(2 * LEVEL * 1.5708f / FADE) + 2;
+  for (size_t i = 1; i < out.size() / 2; i++) {
+    for (int ch = 0; ch < 2; ch++) {
+      int step = out[i * 2 + ch] - out[(i - 1) * 2 + ch];
+      TEST_ASSERT_TRUE_MESSAGE(abs(step) <= maxStep, "step in the output");
+    }
+  }
+  // The handover itself: the first crossfade frame continues the old level
+  TEST_ASSERT_INT16_WITHIN(maxStep, out[999 * 2], out[1000 * 2]);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_ramp_lands_on_the_frame);
+  RUN_TEST(test_partial_ramp_keeps_the_slope);
+  RUN_TEST(test_ramps_ignore_block_size);
+  RUN_TEST(test_crossfade_is_equal_power);
+  RUN_TEST(test_crossfade_is_click_free);
+  return UNITY_END();
+}